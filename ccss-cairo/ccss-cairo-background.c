@@ -187,11 +187,17 @@ ccss_cairo_background_fill (ccss_background_attachment_t const  *bg_attachment,
 		ccss_cairo_image_t const	*image;
 		double				 tile_width;
 		double				 tile_height;
+		double				 device_width;
+		double				 device_height;
 		double				 xoff;
 		double				 yoff;
 
 		image = ccss_cairo_image_cache_fetch_image (bg_image->uri);
-		g_return_if_fail (image);
+		if (NULL == image) {
+			/* Not decoded (yet), the color stands in. */
+			cairo_restore (cr);
+			return;
+		}
 
 		tile_width = bg_size ? 
 				ccss_position_get_hsize (&bg_size->width, 
@@ -217,6 +223,29 @@ ccss_cairo_background_fill (ccss_background_attachment_t const  *bg_attachment,
 					       height, tile_height) :
 			0;
 
+		/* Rasterize vector images at the size they end up on the
+		 * device rather than scaling the intrinsic bitmap. */
+		device_width = tile_width;
+		device_height = tile_height;
+		cairo_user_to_device_distance (cr, &device_width, &device_height);
+		device_width = fabs (device_width);
+		device_height = fabs (device_height);
+		if (image->is_vector &&
+		    (lround (device_width) != lround (image->width) ||
+		     lround (device_height) != lround (image->height))) {
+
+			ccss_cairo_image_t const *raster;
+
+			raster = ccss_cairo_image_cache_fetch_image_at_size (
+						bg_image->uri,
+						device_width, device_height);
+			/* May not be decoded yet. */
+			if (raster) {
+				ccss_cairo_image_cache_release_image (image);
+				image = raster;
+			}
+		}
+
 		dx = tile_width / image->width;
 		dy = tile_height / image->height;
 
@@ -276,6 +305,8 @@ ccss_cairo_background_fill (ccss_background_attachment_t const  *bg_attachment,
 		if (status != CAIRO_STATUS_SUCCESS) {
 			g_warning ("%s", cairo_status_to_string (status));
 		}
+
+		ccss_cairo_image_cache_release_image (image), image = NULL;
 	}
 
 	cairo_restore (cr);
@@ -22,16 +22,240 @@
 /* Direct access to struct members for fun and profit. */
 #include <ccss/ccss-macros.h>
 
+#include <string.h>
 #include "ccss/ccss-border-image-priv.h"
 #include "ccss-cairo-border-image.h"
+#include "ccss-cairo-cache.h"
 #include "ccss-cairo-image-cache.h"
 #include "config.h"
 
+/* Budget for the sliced and stretched tiles, in bytes. */
+#define TILE_CACHE_SIZE_DEFAULT (4 * 1024 * 1024)
+
 typedef enum {
 	ORIENTATION_HORIZONTAL,
 	ORIENTATION_VERTICAL
 } orientation_t;
 
+typedef enum {
+	TILE_TOP_LEFT = 0,
+	TILE_TOP,
+	TILE_TOP_RIGHT,
+	TILE_RIGHT,
+	TILE_BOTTOM_RIGHT,
+	TILE_BOTTOM,
+	TILE_BOTTOM_LEFT,
+	TILE_LEFT,
+	TILE_MIDDLE,
+	N_TILES
+} tile_t;
+
+/*
+ * Everything the nine tiles of a border-image depend on: the image, the
+ * resolved slice offsets, the tiling modes and the size of the target box.
+ */
+typedef struct {
+	char const			*uri;
+	double				 top;
+	double				 right;
+	double				 bottom;
+	double				 left;
+	ccss_border_image_tiling_t	 horizontal_tiling;
+	ccss_border_image_tiling_t	 vertical_tiling;
+	double				 width;
+	double				 height;
+} tiles_key_t;
+
+typedef struct {
+	tiles_key_t	 key;
+	cairo_pattern_t	*tiles[N_TILES];
+	size_t		 size;
+	GList		 link;
+} tiles_t;
+
+static GHashTable	*_tiles_hash = NULL;
+static GQueue		 _tiles_lru = G_QUEUE_INIT;
+static size_t		 _tiles_size = 0;
+static size_t		 _tiles_max_size = TILE_CACHE_SIZE_DEFAULT;
+G_LOCK_DEFINE_STATIC (_tiles_hash);
+
+static guint
+tiles_key_hash (tiles_key_t const *key)
+{
+	guint hash;
+
+	hash = g_str_hash (key->uri);
+	hash = hash * 31 + (guint) key->top;
+	hash = hash * 31 + (guint) key->right;
+	hash = hash * 31 + (guint) key->bottom;
+	hash = hash * 31 + (guint) key->left;
+	hash = hash * 31 + (guint) key->width;
+	hash = hash * 31 + (guint) key->height;
+
+	return hash;
+}
+
+static gboolean
+tiles_key_equal (tiles_key_t const *a,
+		 tiles_key_t const *b)
+{
+	return a->top == b->top &&
+	       a->right == b->right &&
+	       a->bottom == b->bottom &&
+	       a->left == b->left &&
+	       a->horizontal_tiling == b->horizontal_tiling &&
+	       a->vertical_tiling == b->vertical_tiling &&
+	       a->width == b->width &&
+	       a->height == b->height &&
+	       0 == strcmp (a->uri, b->uri);
+}
+
+static void
+tiles_destroy (tiles_t *self)
+{
+	for (unsigned int i = 0; i < N_TILES; i++) {
+		if (self->tiles[i])
+			cairo_pattern_destroy (self->tiles[i]);
+	}
+	g_free ((char *) self->key.uri);
+	g_free (self);
+}
+
+/* Drop least recently used tiles until the cache fits `max_size'.
+ * Call with the lock held. */
+static void
+tiles_trim (size_t max_size)
+{
+	tiles_t	*tiles;
+	GList	*link;
+
+	while (_tiles_size > max_size &&
+	       (link = g_queue_pop_tail_link (&_tiles_lru))) {
+		tiles = (tiles_t *) link->data;
+		_tiles_size -= tiles->size;
+		/* Destroys the tiles. */
+		g_hash_table_remove (_tiles_hash, &tiles->key);
+	}
+}
+
+/*
+ * Look up cached tiles and reference them into `tiles'.
+ */
+static bool
+tiles_fetch (tiles_key_t const	*key,
+	     cairo_pattern_t	*tiles[N_TILES])
+{
+	tiles_t *cached;
+
+	G_LOCK (_tiles_hash);
+
+	cached = _tiles_hash ? g_hash_table_lookup (_tiles_hash, key) : NULL;
+	if (cached) {
+		g_queue_unlink (&_tiles_lru, &cached->link);
+		g_queue_push_head_link (&_tiles_lru, &cached->link);
+		for (unsigned int i = 0; i < N_TILES; i++) {
+			tiles[i] = cached->tiles[i] ?
+				   cairo_pattern_reference (cached->tiles[i]) :
+				   NULL;
+		}
+	}
+
+	G_UNLOCK (_tiles_hash);
+
+	return cached != NULL;
+}
+
+/*
+ * Add a reference to freshly created tiles to the cache, unless they
+ * exceed the budget on their own.
+ */
+static void
+tiles_store (tiles_key_t const	*key,
+	     cairo_pattern_t	*tiles[N_TILES],
+	     size_t		 size)
+{
+	tiles_t *cached;
+
+	G_LOCK (_tiles_hash);
+
+	if (size > _tiles_max_size) {
+		G_UNLOCK (_tiles_hash);
+		return;
+	}
+
+	if (NULL == _tiles_hash) {
+		_tiles_hash = g_hash_table_new_full (
+					(GHashFunc) tiles_key_hash,
+					(GEqualFunc) tiles_key_equal,
+					NULL,
+					(GDestroyNotify) tiles_destroy);
+	} else if (g_hash_table_lookup (_tiles_hash, key)) {
+		/* Another thread has been faster. */
+		G_UNLOCK (_tiles_hash);
+		return;
+	}
+
+	tiles_trim (_tiles_max_size - size);
+
+	cached = g_new0 (tiles_t, 1);
+	cached->key = *key;
+	cached->key.uri = g_strdup (key->uri);
+	for (unsigned int i = 0; i < N_TILES; i++) {
+		cached->tiles[i] = tiles[i] ?
+				   cairo_pattern_reference (tiles[i]) :
+				   NULL;
+	}
+	cached->size = size;
+	cached->link.data = cached;
+
+	g_hash_table_insert (_tiles_hash, &cached->key, cached);
+	g_queue_push_head_link (&_tiles_lru, &cached->link);
+	_tiles_size += size;
+
+	G_UNLOCK (_tiles_hash);
+}
+
+/**
+ * ccss_cairo_border_image_cache_set_size:
+ * @max_size:	budget for cached border-image tiles in bytes, 0 disables
+ *		the cache.
+ *
+ * Border images are sliced and stretched into nine tiles per image and box
+ * size, this limits how much memory is used to keep them around between
+ * draws.
+ **/
+void
+ccss_cairo_border_image_cache_set_size (size_t max_size)
+{
+	G_LOCK (_tiles_hash);
+
+	_tiles_max_size = max_size;
+	if (_tiles_hash)
+		tiles_trim (max_size);
+
+	G_UNLOCK (_tiles_hash);
+}
+
+/**
+ * ccss_cairo_border_image_cache_clear:
+ *
+ * Drop all cached border-image tiles.
+ **/
+void
+ccss_cairo_border_image_cache_clear (void)
+{
+	G_LOCK (_tiles_hash);
+
+	if (_tiles_hash) {
+		tiles_trim (0);
+		g_hash_table_destroy (_tiles_hash);
+		_tiles_hash = NULL;
+	}
+
+	G_UNLOCK (_tiles_hash);
+}
+
+
 static cairo_pattern_t *
 create_tile (ccss_cairo_image_t const	*image,
 	     double			 x,
@@ -40,6 +264,7 @@ create_tile (ccss_cairo_image_t const	*image,
 	     double			 height)
 {
 	cairo_t		*cr;
+	cairo_surface_t	*image_surface;
 	cairo_surface_t	*surface;
 	cairo_pattern_t *pattern;
 	cairo_status_t	 status;
@@ -47,22 +272,20 @@ create_tile (ccss_cairo_image_t const	*image,
 	g_return_val_if_fail (image->pattern, NULL);
 
 	/* Setup. */
-	surface = NULL;
-	status = cairo_pattern_get_surface (image->pattern, &surface);
+	image_surface = NULL;
+	status = cairo_pattern_get_surface (image->pattern, &image_surface);
 	if (status != CAIRO_STATUS_SUCCESS) {
 		g_warning ("%s", cairo_status_to_string (status));
 		return NULL;
 	}
 
-	surface = cairo_surface_create_similar (surface,
+	surface = cairo_surface_create_similar (image_surface,
 						CAIRO_CONTENT_COLOR_ALPHA,
 						width, height);
 	cr = cairo_create (surface);
 
-	/* Drawing. */
-	cairo_pattern_set_extend (image->pattern, CAIRO_EXTEND_NONE);
-	cairo_translate (cr, -1 * x, -1 * y);
-	cairo_set_source (cr, image->pattern);
+	/* Drawing. Use a private pattern, the image's one is shared. */
+	cairo_set_source_surface (cr, image_surface, -1 * x, -1 * y);
 	cairo_paint (cr);
 		
 	/* Cleanup. */
@@ -198,14 +421,104 @@ paint (cairo_pattern_t		*tile,
 	cairo_save (cr);
 	cairo_translate (cr, x, y);
 
-	cairo_pattern_set_extend (tile, CAIRO_EXTEND_NONE);
+	/* Tiles are created with CAIRO_EXTEND_NONE and may be shared
+	 * between threads through the cache, so they are not touched here. */
 	cairo_set_source (cr, tile);
 	cairo_paint (cr);
 
 	cairo_restore (cr);
 }
 
-void
+/*
+ * Slice and stretch the image into the tiles for a box of the given size.
+ * Returns the approximate memory used by the tiles.
+ */
+static size_t
+create_tiles (ccss_border_image_t const	*self,
+	      ccss_cairo_image_t const	*image,
+	      double			 width,
+	      double			 height,
+	      double			 top_width,
+	      double			 top_height,
+	      double			 right_width,
+	      double			 right_height,
+	      double			 bottom_width,
+	      double			 bottom_height,
+	      double			 left_width,
+	      double			 left_height,
+	      double			 middle_width,
+	      double			 middle_height,
+	      cairo_pattern_t		*tiles[N_TILES])
+{
+	double center_width;
+	double center_height;
+
+	center_width = MAX (0, width - left_width - right_width);
+	center_height = MAX (0, height - top_height - bottom_height);
+
+	tiles[TILE_TOP_LEFT] = create_tile (image, 
+				0, 0,
+				left_width, top_height);
+
+	tiles[TILE_TOP] = create_border (image, ORIENTATION_HORIZONTAL,
+				self->top_middle_bottom_horizontal_tiling,
+				center_width, top_height,
+				left_width, 0, top_width, top_height);
+
+	tiles[TILE_TOP_RIGHT] = create_tile (image,
+				left_width + top_width, 0,
+				right_width, top_height);
+
+	tiles[TILE_RIGHT] = create_border (image, ORIENTATION_VERTICAL,
+				self->left_middle_right_vertical_tiling,
+				right_width, center_height,
+				left_width + middle_width, top_height,
+				right_width, right_height);
+
+	tiles[TILE_BOTTOM_RIGHT] = create_tile (image,
+				left_width + bottom_width,
+				top_height + right_height,
+				right_width, bottom_height);
+
+	tiles[TILE_BOTTOM] = create_border (image, ORIENTATION_HORIZONTAL,
+				self->top_middle_bottom_horizontal_tiling,
+				center_width, bottom_height,
+				left_width, top_height + middle_height,
+				bottom_width, bottom_height);
+
+	tiles[TILE_BOTTOM_LEFT] = create_tile (image,
+				0, top_height + left_height,
+				left_width, bottom_height);
+
+	tiles[TILE_LEFT] = create_border (image, ORIENTATION_VERTICAL,
+				self->left_middle_right_vertical_tiling,
+				left_width, center_height,
+				0, top_height, left_width, left_height);
+
+	tiles[TILE_MIDDLE] = create_middle (image, 
+				self->top_middle_bottom_horizontal_tiling,
+				self->left_middle_right_vertical_tiling,
+				center_width, center_height,
+				left_width, top_height,
+				middle_width, middle_height);
+
+	/* 4 bytes per ARGB32 pixel. */
+	return 4 * (size_t) (left_width * top_height +
+			     center_width * top_height +
+			     right_width * top_height +
+			     right_width * center_height +
+			     right_width * bottom_height +
+			     center_width * bottom_height +
+			     left_width * bottom_height +
+			     left_width * center_height +
+			     center_width * center_height);
+}
+
+/*
+ * Returns false if the image is not available, so the caller can fall back
+ * to drawing a regular border.
+ */
+bool
 ccss_cairo_border_image_draw (ccss_border_image_t const	*self,
 			      cairo_t			*cr, 
 			      double			 x,
@@ -214,17 +527,21 @@ ccss_cairo_border_image_draw (ccss_border_image_t const	*self,
 			      double			 height)
 {
 	ccss_cairo_image_t const	*image;
-	cairo_pattern_t			*tile;
+	cairo_pattern_t			*tiles[N_TILES];
+	double				 offsets[N_TILES][2];
+	tiles_key_t			 key;
+	size_t				 size;
 	double				 top_width, top_height;
 	double				 right_width, right_height;
 	double				 bottom_width, bottom_height;
 	double				 left_width, left_height;
 	double				 middle_width, middle_height;
-	double				 xoff, yoff;
 
-	g_return_if_fail (self && cr);
+	g_return_val_if_fail (self && cr, false);
+
 	image = ccss_cairo_image_cache_fetch_image (self->uri);
-	g_return_if_fail (image);
+	if (NULL == image)
+		return false;
 
 	/* Tile extents, see http://www.w3.org/TR/css3-background/#the-border-image . */
 
@@ -247,111 +564,63 @@ ccss_cairo_border_image_draw (ccss_border_image_t const	*self,
 	middle_width = top_width;
 	middle_height = right_height;
 
-	/* top-left */
-	tile = create_tile (image, 
-			    0, 0,
-			    left_width, top_height);
-	if (tile) {
-		xoff = x;
-		yoff = y;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
+	key.uri = self->uri;
+	key.top = top_height;
+	key.right = right_width;
+	key.bottom = bottom_height;
+	key.left = left_width;
+	key.horizontal_tiling = self->top_middle_bottom_horizontal_tiling;
+	key.vertical_tiling = self->left_middle_right_vertical_tiling;
+	key.width = width;
+	key.height = height;
+
+	if (!tiles_fetch (&key, tiles)) {
+		size = create_tiles (self, image, width, height,
+				     top_width, top_height,
+				     right_width, right_height,
+				     bottom_width, bottom_height,
+				     left_width, left_height,
+				     middle_width, middle_height,
+				     tiles);
+		tiles_store (&key, tiles, size);
 	}
 
-	/* top */
-	tile = create_border (image, ORIENTATION_HORIZONTAL,
-			      self->top_middle_bottom_horizontal_tiling,
-			      width - left_width - right_width, top_height,
-			      left_width, 0, top_width, top_height);
-	if (tile) {
-		xoff = x + left_width;
-		yoff = y;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_TOP_LEFT][0] = x;
+	offsets[TILE_TOP_LEFT][1] = y;
 
-	/* top-right */
-	tile = create_tile (image,
-			    left_width + top_width, 0,
-			    right_width, top_height);
-	if (tile) {
-		xoff = x + width - left_width;
-		yoff = y;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_TOP][0] = x + left_width;
+	offsets[TILE_TOP][1] = y;
 
-	/* right */
-	tile = create_border (image, ORIENTATION_VERTICAL,
-			      self->left_middle_right_vertical_tiling,
-			      right_width, height - top_height - bottom_height,
-			      left_width + middle_width, top_height, right_width, right_height);
-	if (tile) {
-		xoff = x + width - left_width;
-		yoff = y + top_height;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_TOP_RIGHT][0] = x + width - left_width;
+	offsets[TILE_TOP_RIGHT][1] = y;
 
-	/* bottom-right */
-	tile = create_tile (image,
-			    left_width + bottom_width, top_height + right_height,
-			    right_width, bottom_height);
-	if (tile) {
-		xoff = x + width - left_width;
-		yoff = y + height - bottom_height;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_RIGHT][0] = x + width - left_width;
+	offsets[TILE_RIGHT][1] = y + top_height;
 
-	/* bottom */
-	tile = create_border (image, ORIENTATION_HORIZONTAL,
-			      self->top_middle_bottom_horizontal_tiling,
-			      width - left_width - right_width, bottom_height,
-			      left_width, top_height + middle_height, bottom_width, bottom_height);
-	if (tile) {
-		xoff = x + left_width;
-		yoff = y + height - bottom_height;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_BOTTOM_RIGHT][0] = x + width - left_width;
+	offsets[TILE_BOTTOM_RIGHT][1] = y + height - bottom_height;
 
-	/* bottom-left */
-	tile = create_tile (image,
-			    0, top_height + left_height,
-			    left_width, bottom_height);
-	if (tile) {
-		xoff = x;
-		yoff = y + height - bottom_height;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_BOTTOM][0] = x + left_width;
+	offsets[TILE_BOTTOM][1] = y + height - bottom_height;
 
-	/* left */
-	tile = create_border (image, ORIENTATION_VERTICAL,
-			      self->left_middle_right_vertical_tiling,
-			      left_width, height - top_height - bottom_height,
-			      0, top_height, left_width, left_height);
-	if (tile) {
-		xoff = x;
-		yoff = y + top_height;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
-	}
+	offsets[TILE_BOTTOM_LEFT][0] = x;
+	offsets[TILE_BOTTOM_LEFT][1] = y + height - bottom_height;
+
+	offsets[TILE_LEFT][0] = x;
+	offsets[TILE_LEFT][1] = y + top_height;
+
+	offsets[TILE_MIDDLE][0] = x + left_width;
+	offsets[TILE_MIDDLE][1] = y + top_height;
 
-	/* middle */
-	tile = create_middle (image, 
-			      self->top_middle_bottom_horizontal_tiling,
-			      self->left_middle_right_vertical_tiling,
-			      width - left_width - right_width,
-			      height - top_height - bottom_height,
-			      left_width, top_height,
-			      middle_width, middle_height);
-	if (tile) {
-		xoff = x + left_width;
-		yoff = y + top_height;
-		paint (tile, cr, xoff, yoff);
-		cairo_pattern_destroy (tile), tile = NULL;
+	for (unsigned int i = 0; i < N_TILES; i++) {
+		if (tiles[i]) {
+			paint (tiles[i], cr, offsets[i][0], offsets[i][1]);
+			cairo_pattern_destroy (tiles[i]), tiles[i] = NULL;
+		}
 	}
+
+	ccss_cairo_image_cache_release_image (image), image = NULL;
+
+	return true;
 }
 
@@ -33,7 +33,7 @@
 
 CCSS_BEGIN_DECLS
 
-void
+bool
 ccss_cairo_border_image_draw (ccss_border_image_t const	*self,
 			      cairo_t			*cr, 
 			      double			 x,
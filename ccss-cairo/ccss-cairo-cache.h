@@ -0,0 +1,114 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The Cairo CSS Drawing Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CCSS_CAIRO_CACHE_H
+#define CCSS_CAIRO_CACHE_H
+
+#ifndef CCSS_CAIRO_H
+  #ifndef CCSS_CAIRO_BUILD
+    #error "Only <ccss-cairo/ccss-cairo.h> can be included directly."
+  #endif
+#endif
+
+#include <stddef.h>
+#include <ccss/ccss.h>
+
+CCSS_BEGIN_DECLS
+
+/**
+ * ccss_cairo_image_cache_stats_t:
+ * @hits:	number of lookups that found the image in the cache.
+ * @misses:	number of lookups that had to load the image.
+ * @evictions:	number of images dropped to stay within the budget or
+ *		through ccss_cairo_image_cache_trim().
+ * @n_images:	number of images currently in the cache.
+ * @n_in_use:	number of cached images currently being drawn.
+ * @n_pending:	number of images queued for asynchronous decoding.
+ * @size:	memory used by the cached images in bytes.
+ * @max_size:	memory budget in bytes.
+ *
+ * Image cache statistics, see ccss_cairo_image_cache_get_stats().
+ **/
+typedef struct {
+	unsigned long	hits;
+	unsigned long	misses;
+	unsigned long	evictions;
+	unsigned int	n_images;
+	unsigned int	n_in_use;
+	unsigned int	n_pending;
+	size_t		size;
+	size_t		max_size;
+} ccss_cairo_image_cache_stats_t;
+
+/**
+ * ccss_cairo_image_loaded_f:
+ * @uri:	the image that has been decoded.
+ * @user_data:	data passed to ccss_cairo_image_cache_set_async().
+ *
+ * Notification that an image is ready for drawing, called from a worker
+ * thread.
+ **/
+typedef void (*ccss_cairo_image_loaded_f) (char const	*uri,
+					   void		*user_data);
+
+bool
+ccss_cairo_image_cache_set_async (unsigned int			n_threads,
+				  ccss_cairo_image_loaded_f	loaded,
+				  void				*user_data);
+
+void
+ccss_cairo_image_cache_set_max_size (size_t max_size);
+
+size_t
+ccss_cairo_image_cache_get_max_size (void);
+
+void
+ccss_cairo_image_cache_get_stats (ccss_cairo_image_cache_stats_t *stats);
+
+void
+ccss_cairo_image_cache_trim (size_t size);
+
+void
+ccss_cairo_image_cache_purge (void);
+
+char **
+ccss_cairo_stylesheet_get_image_uris (ccss_stylesheet_t const *stylesheet);
+
+unsigned int
+ccss_cairo_stylesheet_preload_images (ccss_stylesheet_t const	*stylesheet,
+				      unsigned int		 n_threads);
+
+void
+ccss_cairo_border_image_cache_set_size (size_t max_size);
+
+void
+ccss_cairo_border_image_cache_clear (void);
+
+void
+ccss_cairo_render_cache_set_size (size_t max_size);
+
+void
+ccss_cairo_render_cache_clear (void);
+
+CCSS_END_DECLS
+
+#endif /* CCSS_CAIRO_CACHE_H */
+
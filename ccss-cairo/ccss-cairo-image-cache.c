@@ -19,42 +19,719 @@
  * MA 02110-1301, USA.
  */
 
+/* Direct access to struct members for fun and profit. */
+#include <ccss/ccss-macros.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <glib.h>
+#include "ccss/ccss-background-priv.h"
+#include "ccss/ccss-block-priv.h"
+#include "ccss/ccss-border-image-priv.h"
+#include "ccss/ccss-stylesheet-priv.h"
+#include "ccss-cairo-border-image.h"
+#include "ccss-cairo-cache.h"
 #include "ccss-cairo-image-cache.h"
+#include "ccss-cairo-property.h"
 #include "config.h"
 
-static GHashTable *_image_hash = NULL;
+/* Budget for decoded images, in bytes. */
+#define IMAGE_CACHE_SIZE_DEFAULT (16 * 1024 * 1024)
 
-ccss_cairo_image_t const *
-ccss_cairo_image_cache_fetch_image (char const *uri)
+/*
+ * Cache entry, the image comes first so the pointers handed out by
+ * ccss_cairo_image_cache_fetch_image() can be mapped back to their entry.
+ */
+typedef struct {
+	ccss_cairo_image_t	 image;
+	char			*uri;
+	size_t			 size;
+	unsigned int		 reference_count;
+	GList			 link;
+} entry_t;
+
+/* State of images decoded asynchronously. */
+typedef enum {
+	IMAGE_LOADING = 1,
+	IMAGE_FAILED
+} image_state_t;
+
+static GHashTable			*_image_hash = NULL;
+static GQueue				 _image_lru = G_QUEUE_INIT;
+static ccss_cairo_image_cache_stats_t	 _image_stats = {
+	.max_size = IMAGE_CACHE_SIZE_DEFAULT
+};
+static unsigned int			 _image_generation = 0;
+static GThreadPool			*_image_pool = NULL;
+static GHashTable			*_image_pending = NULL;
+static ccss_cairo_image_loaded_f	 _image_loaded = NULL;
+static void				*_image_loaded_data = NULL;
+G_LOCK_DEFINE_STATIC (_image_hash);
+
+static entry_t *
+entry_create (char const		*uri,
+	      ccss_cairo_image_t	*image)
 {
-	ccss_cairo_image_t *image;
+	entry_t		*self;
+	cairo_surface_t	*surface;
+
+	self = g_new0 (entry_t, 1);
+	self->image = *image;
+	self->uri = g_strdup (uri);
+	self->link.data = self;
+
+	surface = NULL;
+	if (CAIRO_STATUS_SUCCESS == cairo_pattern_get_surface (image->pattern,
+							       &surface) &&
+	    CAIRO_SURFACE_TYPE_IMAGE == cairo_surface_get_type (surface)) {
+		self->size = cairo_image_surface_get_stride (surface) *
+			     cairo_image_surface_get_height (surface);
+	} else {
+		/* 4 bytes per ARGB32 pixel. */
+		self->size = 4 * (size_t) (image->width * image->height);
+	}
+
+	/* The pattern has been moved into the entry. */
+	image->pattern = NULL;
+	ccss_cairo_image_destroy (image);
+
+	return self;
+}
+
+static void
+entry_destroy (entry_t *self)
+{
+	if (self->image.pattern) {
+		cairo_pattern_destroy (self->image.pattern);
+		self->image.pattern = NULL;
+	}
+	g_free (self->uri);
+	g_free (self);
+}
+
+/* Drop least recently used images that are not being drawn until the
+ * cache fits `size'. Call with the lock held. */
+static void
+trim (size_t size)
+{
+	entry_t	*entry;
+	GList	*iter;
+	GList	*prev;
+
+	iter = _image_lru.tail;
+	while (iter && _image_stats.size > size) {
+		entry = (entry_t *) iter->data;
+		prev = iter->prev;
+		if (0 == entry->reference_count) {
+			g_queue_unlink (&_image_lru, iter);
+			_image_stats.size -= entry->size;
+			_image_stats.n_images--;
+			_image_stats.evictions++;
+			_image_generation++;
+			/* Destroys the entry. */
+			g_hash_table_remove (_image_hash, entry->uri);
+		}
+		iter = prev;
+	}
+}
+
+/* Add a freshly loaded image to the cache, unless another thread has been
+ * faster. Call with the lock held. */
+static entry_t *
+insert (char const		*uri,
+	ccss_cairo_image_t	*image)
+{
+	entry_t *entry;
 
 	if (_image_hash == NULL) {
 		_image_hash = g_hash_table_new_full (
 				g_str_hash,
 				g_str_equal,
-				g_free,
-				(GDestroyNotify) ccss_cairo_image_destroy);
+				NULL,
+				(GDestroyNotify) entry_destroy);
 	}
-	
-	image = g_hash_table_lookup (_image_hash, uri);
-	
-	if (!image) {
-		image = ccss_cairo_image_create (uri);
-		if (image)
-			g_hash_table_insert (_image_hash,
-					     g_strdup (uri),
-					     image);
+
+	entry = g_hash_table_lookup (_image_hash, uri);
+	if (entry) {
+		ccss_cairo_image_destroy (image);
+	} else {
+		entry = entry_create (uri, image);
+		g_hash_table_insert (_image_hash, entry->uri, entry);
+		g_queue_push_head_link (&_image_lru, &entry->link);
+		_image_stats.size += entry->size;
+		_image_stats.n_images++;
+		_image_generation++;
+	}
+
+	return entry;
+}
+
+/* Largest edge of rasterized vector images, in pixels. */
+#define RASTER_SIZE_MAX 4096
+
+/*
+ * Round up to one of four steps per power of two, so a vector image that is
+ * drawn at many slightly different sizes is rasterized only a few times,
+ * at most 25% larger than needed.
+ */
+static unsigned int
+quantize (double size)
+{
+	unsigned int n;
+	unsigned int step;
+
+	n = CLAMP (ceil (size), 1, RASTER_SIZE_MAX);
+	step = 1 << MAX (0, (int) g_bit_storage (n) - 3);
+
+	return MIN ((n + step - 1) / step * step, RASTER_SIZE_MAX);
+}
+
+/*
+ * Cache keys are plain URIs, or "<uri>\n<width>x<height>" for vector images
+ * rasterized at a specific size.
+ */
+static ccss_cairo_image_t *
+create_image (char const *key)
+{
+	ccss_cairo_image_t	*image;
+	char const		*size;
+	char			*uri;
+	unsigned int		 width;
+	unsigned int		 height;
+
+	size = strchr (key, '\n');
+	if (NULL == size)
+		return ccss_cairo_image_create (key);
+
+	if (2 != sscanf (size + 1, "%ux%u", &width, &height)) {
+		g_warning ("Invalid image key `%s'", key);
+		return NULL;
 	}
+
+	uri = g_strndup (key, size - key);
+	image = ccss_cairo_image_create_at_size (uri, width, height);
+	g_free (uri);
+
+	return image;
+}
+
+/* Worker pool function, decodes an image off the drawing thread. */
+static void
+load_thread (char	*uri,
+	     void	*user_data)
+{
+	ccss_cairo_image_t		*image;
+	ccss_cairo_image_loaded_f	 loaded;
+	void				*loaded_data;
+
+	image = create_image (uri);
+
+	G_LOCK (_image_hash);
+
+	if (image) {
+		insert (uri, image);
+		trim (_image_stats.max_size);
+		g_hash_table_remove (_image_pending, uri);
+		_image_stats.n_pending--;
+	} else {
+		/* Do not retry on every draw. */
+		g_hash_table_insert (_image_pending, g_strdup (uri),
+				     GINT_TO_POINTER (IMAGE_FAILED));
+		_image_stats.n_pending--;
+	}
+	loaded = _image_loaded;
+	loaded_data = _image_loaded_data;
+
+	G_UNLOCK (_image_hash);
+
+	if (image && loaded)
+		loaded (uri, loaded_data);
+
+	g_free (uri);
+}
+
+/* Queue `uri' for decoding, unless it is being decoded already or has
+ * failed before. Call with the lock held. */
+static void
+load_async (char const *uri)
+{
+	if (NULL == _image_pending) {
+		_image_pending = g_hash_table_new_full (g_str_hash,
+							g_str_equal,
+							g_free,
+							NULL);
+	}
+
+	if (g_hash_table_lookup (_image_pending, uri))
+		return;
+
+	g_hash_table_insert (_image_pending, g_strdup (uri),
+			     GINT_TO_POINTER (IMAGE_LOADING));
+	_image_stats.n_pending++;
+	g_thread_pool_push (_image_pool, g_strdup (uri), NULL);
+}
+
+static ccss_cairo_image_t const *
+fetch (char const *uri)
+{
+	ccss_cairo_image_t	*image;
+	entry_t			*entry;
+	GThreadPool		*pool;
+
+	G_LOCK (_image_hash);
+
+	entry = _image_hash ? g_hash_table_lookup (_image_hash, uri) : NULL;
+	if (entry) {
+		if (0 == entry->reference_count++)
+			_image_stats.n_in_use++;
+		g_queue_unlink (&_image_lru, &entry->link);
+		g_queue_push_head_link (&_image_lru, &entry->link);
+		_image_stats.hits++;
+	} else {
+		_image_stats.misses++;
+		if (_image_pool)
+			load_async (uri);
+	}
+	pool = _image_pool;
+
+	G_UNLOCK (_image_hash);
+
+	if (entry)
+		return &entry->image;
+	if (pool)
+		return NULL;
+
+	/* Load without holding the lock. */
+	image = create_image (uri);
+	if (!image)
+		return NULL;
+
+	G_LOCK (_image_hash);
+
+	entry = insert (uri, image);
+	if (0 == entry->reference_count++)
+		_image_stats.n_in_use++;
+
+	/* Make room now that the image is pinned, this may leave the cache
+	 * over budget while images are in use. */
+	trim (_image_stats.max_size);
+
+	G_UNLOCK (_image_hash);
 	
+	return &entry->image;
+}
+
+/*
+ * Returns the image for `uri' with a reference held, which has to be
+ * dropped using ccss_cairo_image_cache_release_image() when done drawing.
+ * The image is not evicted while referenced.
+ *
+ * In asynchronous mode NULL is returned until the image has been decoded,
+ * see ccss_cairo_image_cache_set_async().
+ */
+ccss_cairo_image_t const *
+ccss_cairo_image_cache_fetch_image (char const *uri)
+{
+	g_return_val_if_fail (uri, NULL);
+
+	return fetch (uri);
+}
+
+/*
+ * Like ccss_cairo_image_cache_fetch_image(), but vector images are
+ * rasterized for drawing at `width' x `height' device pixels. The size is
+ * rounded up to limit the number of variants.
+ */
+ccss_cairo_image_t const *
+ccss_cairo_image_cache_fetch_image_at_size (char const	*uri,
+					    double	 width,
+					    double	 height)
+{
+	ccss_cairo_image_t const	*image;
+	char				*key;
+
+	g_return_val_if_fail (uri, NULL);
+
+	key = g_strdup_printf ("%s\n%ux%u", uri,
+			       quantize (width), quantize (height));
+	image = fetch (key);
+	g_free (key);
+
 	return image;
 }
 
 void
-ccss_cairo_image_cache_destroy (void)
+ccss_cairo_image_cache_release_image (ccss_cairo_image_t const *image)
 {
-	g_hash_table_destroy (_image_hash);
-	_image_hash = NULL;
+	entry_t *entry;
+
+	g_return_if_fail (image);
+
+	entry = (entry_t *) image;
+
+	G_LOCK (_image_hash);
+
+	g_assert (entry->reference_count > 0);
+	if (0 == --entry->reference_count) {
+		_image_stats.n_in_use--;
+		trim (_image_stats.max_size);
+	}
+
+	G_UNLOCK (_image_hash);
 }
 
+/*
+ * Changes whenever an image is added to or dropped from the cache, so
+ * drawings that depend on which images are available can be invalidated.
+ */
+unsigned int
+ccss_cairo_image_cache_get_generation (void)
+{
+	unsigned int generation;
+
+	G_LOCK (_image_hash);
+	generation = _image_generation;
+	G_UNLOCK (_image_hash);
+
+	return generation;
+}
+
+/**
+ * ccss_cairo_image_cache_set_async:
+ * @n_threads:	number of decoding threads, 0 to decode synchronously when
+ *		drawing.
+ * @loaded:	function called when an image has been decoded, or %NULL.
+ * @user_data:	data to pass to @loaded.
+ *
+ * Decode images on a pool of worker threads instead of in the drawing
+ * code. Until an image is ready, elements are drawn without it, showing
+ * just their `background-color', or their regular border instead of a
+ * `border-image'. Use @loaded to schedule a redraw; it is invoked from a
+ * worker thread, so it will usually hand over to the main loop, e.g.
+ * through g_idle_add(). Images that fail to decode are not retried until
+ * ccss_cairo_image_cache_purge().
+ *
+ * Requires the GLib thread system to be initialized. Switching modes waits
+ * for queued images to be decoded.
+ *
+ * Returns: %TRUE on success.
+ **/
+bool
+ccss_cairo_image_cache_set_async (unsigned int			n_threads,
+				  ccss_cairo_image_loaded_f	loaded,
+				  void				*user_data)
+{
+	GThreadPool	*pool;
+	GError		*error;
+
+	G_LOCK (_image_hash);
+	pool = _image_pool;
+	_image_pool = NULL;
+	G_UNLOCK (_image_hash);
+
+	/* Wait for queued images, the workers take the lock. */
+	if (pool)
+		g_thread_pool_free (pool, false, true);
+
+	pool = NULL;
+	if (n_threads > 0) {
+		error = NULL;
+		pool = g_thread_pool_new ((GFunc) load_thread, NULL,
+					  n_threads, false, &error);
+		if (error) {
+			g_warning ("%s", error->message);
+			g_error_free (error);
+			return false;
+		}
+	}
+
+	G_LOCK (_image_hash);
+	_image_pool = pool;
+	_image_loaded = loaded;
+	_image_loaded_data = user_data;
+	G_UNLOCK (_image_hash);
+
+	return true;
+}
+
+static void
+collect_uri (GHashTable			*uris,
+	     ccss_property_t const	*property,
+	     char const			*uri)
+{
+	if (property &&
+	    CCSS_PROPERTY_STATE_SET == property->state &&
+	    uri) {
+		g_hash_table_insert (uris, (gpointer) uri, NULL);
+	}
+}
+
+/**
+ * ccss_cairo_stylesheet_get_image_uris:
+ * @stylesheet:	a #ccss_stylesheet_t.
+ *
+ * Find the images referenced through `background-image' and `border-image'
+ * by all CSS loaded into @stylesheet.
+ *
+ * Returns: %NULL-terminated array of unique URIs, free using g_strfreev().
+ **/
+char **
+ccss_cairo_stylesheet_get_image_uris (ccss_stylesheet_t const *stylesheet)
+{
+	GHashTable			*uris;
+	GHashTableIter			 iter;
+	GHashTableIter			 uri_iter;
+	ccss_block_t const		*block;
+	ccss_background_image_t const	*bg_image;
+	ccss_border_image_t const	*border_image;
+	char const			*uri;
+	char				**ret;
+	unsigned int			 i;
+
+	g_return_val_if_fail (stylesheet, NULL);
+
+	uris = g_hash_table_new (g_str_hash, g_str_equal);
+
+	g_hash_table_iter_init (&iter, stylesheet->blocks);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &block, NULL)) {
+
+		bg_image = (ccss_background_image_t const *)
+				ccss_block_lookup_property (block,
+					CCSS_PROPERTY_BACKGROUND_IMAGE);
+		if (bg_image)
+			collect_uri (uris, &bg_image->base, bg_image->uri);
+
+		border_image = (ccss_border_image_t const *)
+				ccss_block_lookup_property (block,
+					CCSS_PROPERTY_BORDER_IMAGE);
+		if (border_image)
+			collect_uri (uris, &border_image->base,
+				     border_image->uri);
+	}
+
+	ret = g_new0 (char *, g_hash_table_size (uris) + 1);
+	i = 0;
+	g_hash_table_iter_init (&uri_iter, uris);
+	while (g_hash_table_iter_next (&uri_iter, (gpointer *) &uri, NULL)) {
+		ret[i++] = g_strdup (uri);
+	}
+	g_hash_table_destroy (uris);
+
+	return ret;
+}
+
+/* Worker pool function for preloading. */
+static void
+preload_thread (char		*uri,
+		unsigned int	*n_loaded)
+{
+	ccss_cairo_image_t *image;
+
+	image = ccss_cairo_image_create (uri);
+	if (image) {
+		G_LOCK (_image_hash);
+		insert (uri, image);
+		trim (_image_stats.max_size);
+		G_UNLOCK (_image_hash);
+
+		g_atomic_int_inc ((int volatile *) n_loaded);
+	}
+}
+
+/**
+ * ccss_cairo_stylesheet_preload_images:
+ * @stylesheet:	a #ccss_stylesheet_t.
+ * @n_threads:	number of threads to decode images on, 0 to decode them in
+ *		the calling thread.
+ *
+ * Decode all images referenced by @stylesheet ahead of drawing, see
+ * ccss_cairo_stylesheet_get_image_uris(). Returns once all images have been
+ * decoded. Images beyond the cache budget will be evicted again, see
+ * ccss_cairo_image_cache_set_max_size().
+ *
+ * Images are decoded at their intrinsic size. SVG backgrounds drawn at a
+ * different size are still rasterized for that size when first drawn,
+ * since the size is not known before.
+ *
+ * Returns: number of images that are cached or could be decoded.
+ **/
+unsigned int
+ccss_cairo_stylesheet_preload_images (ccss_stylesheet_t const	*stylesheet,
+				      unsigned int		 n_threads)
+{
+	char		**uris;
+	GThreadPool	 *pool;
+	unsigned int	  n_loaded;
+	bool		  is_cached;
+
+	g_return_val_if_fail (stylesheet, 0);
+
+	uris = ccss_cairo_stylesheet_get_image_uris (stylesheet);
+	n_loaded = 0;
+
+	pool = NULL;
+	if (n_threads > 0 && g_thread_supported ()) {
+		pool = g_thread_pool_new ((GFunc) preload_thread, &n_loaded,
+					  n_threads, true, NULL);
+	}
+
+	for (unsigned int i = 0; uris[i]; i++) {
+
+		G_LOCK (_image_hash);
+		is_cached = _image_hash &&
+			    g_hash_table_lookup (_image_hash, uris[i]);
+		G_UNLOCK (_image_hash);
+
+		if (is_cached) {
+			/* Workers may be counting meanwhile. */
+			g_atomic_int_inc ((int volatile *) &n_loaded);
+		} else if (pool) {
+			g_thread_pool_push (pool, uris[i], NULL);
+		} else {
+			preload_thread (uris[i], &n_loaded);
+		}
+	}
+
+	/* Wait for all images to be decoded. */
+	if (pool)
+		g_thread_pool_free (pool, false, true);
+
+	g_strfreev (uris);
+
+	return g_atomic_int_get ((int volatile *) &n_loaded);
+}
+
+/**
+ * ccss_cairo_image_cache_set_max_size:
+ * @max_size:	budget for decoded images in bytes.
+ *
+ * Set how much memory the images used for `background-image' and
+ * `border-image' may take up. Least recently used images are dropped
+ * when the budget is exceeded, images currently being drawn are kept.
+ * The default is 16 MiB.
+ **/
+void
+ccss_cairo_image_cache_set_max_size (size_t max_size)
+{
+	G_LOCK (_image_hash);
+
+	_image_stats.max_size = max_size;
+	if (_image_hash)
+		trim (max_size);
+
+	G_UNLOCK (_image_hash);
+}
+
+/**
+ * ccss_cairo_image_cache_get_max_size:
+ *
+ * Returns: the image cache budget in bytes.
+ **/
+size_t
+ccss_cairo_image_cache_get_max_size (void)
+{
+	size_t max_size;
+
+	G_LOCK (_image_hash);
+	max_size = _image_stats.max_size;
+	G_UNLOCK (_image_hash);
+
+	return max_size;
+}
+
+/**
+ * ccss_cairo_image_cache_get_stats:
+ * @stats:	statistics structure to fill.
+ *
+ * Query image cache statistics. Counters are accumulated over the lifetime
+ * of the process.
+ **/
+void
+ccss_cairo_image_cache_get_stats (ccss_cairo_image_cache_stats_t *stats)
+{
+	g_return_if_fail (stats);
+
+	G_LOCK (_image_hash);
+	*stats = _image_stats;
+	G_UNLOCK (_image_hash);
+}
+
+/**
+ * ccss_cairo_image_cache_trim:
+ * @size:	target size in bytes.
+ *
+ * Drop least recently used images until the cache takes up no more than
+ * @size bytes. Images currently being drawn are kept.
+ **/
+void
+ccss_cairo_image_cache_trim (size_t size)
+{
+	G_LOCK (_image_hash);
+
+	if (_image_hash)
+		trim (size);
+
+	G_UNLOCK (_image_hash);
+}
+
+static gboolean
+is_failed (char const	*uri,
+	   void		*state,
+	   void		*user_data)
+{
+	return IMAGE_FAILED == GPOINTER_TO_INT (state);
+}
+
+/**
+ * ccss_cairo_image_cache_purge:
+ *
+ * Drop all images that are not currently being drawn, and all cached
+ * border-image tiles and renderings. Images that failed to decode asynchronously will be
+ * tried again. Useful after switching themes.
+ **/
+void
+ccss_cairo_image_cache_purge (void)
+{
+	/* Tiles and renderings are made from cached images. */
+	ccss_cairo_border_image_cache_clear ();
+	ccss_cairo_render_cache_clear ();
+
+	G_LOCK (_image_hash);
+
+	if (_image_pending)
+		g_hash_table_foreach_remove (_image_pending,
+					     (GHRFunc) is_failed, NULL);
+	if (_image_hash)
+		trim (0);
+
+	G_UNLOCK (_image_hash);
+}
+
+void
+ccss_cairo_image_cache_destroy (void)
+{
+	ccss_cairo_image_cache_set_async (0, NULL, NULL);
+
+	/* Tiles are sliced from cached images. */
+	ccss_cairo_border_image_cache_clear ();
+
+	G_LOCK (_image_hash);
+
+	if (_image_hash) {
+		g_warn_if_fail (0 == _image_stats.n_in_use);
+		g_queue_init (&_image_lru);
+		g_hash_table_destroy (_image_hash);
+		_image_hash = NULL;
+		_image_stats.size = 0;
+		_image_stats.n_images = 0;
+		_image_stats.n_in_use = 0;
+		_image_generation++;
+	}
+	if (_image_pending) {
+		g_hash_table_destroy (_image_pending);
+		_image_pending = NULL;
+	}
+
+	G_UNLOCK (_image_hash);
+}
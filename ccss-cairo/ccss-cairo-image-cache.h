@@ -36,6 +36,17 @@
 ccss_cairo_image_t const *
 ccss_cairo_image_cache_fetch_image (char const *uri);
 
+ccss_cairo_image_t const *
+ccss_cairo_image_cache_fetch_image_at_size (char const	*uri,
+					    double	 width,
+					    double	 height);
+
+void
+ccss_cairo_image_cache_release_image (ccss_cairo_image_t const *image);
+
+unsigned int
+ccss_cairo_image_cache_get_generation (void);
+
 void
 ccss_cairo_image_cache_destroy (void);
 
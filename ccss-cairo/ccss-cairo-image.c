@@ -47,10 +47,16 @@ ccss_cairo_image_destroy (ccss_cairo_image_t *self)
 
 #if CCSS_WITH_RSVG
 
+/*
+ * Rasterize at `width' x `height' pixels, or at the intrinsic size if those
+ * are 0.
+ */
 static bool
 load_svg (ccss_cairo_image_t	*self,
 	  char const		*uri,
-	  char const		*id)
+	  char const		*id,
+	  unsigned int		 width,
+	  unsigned int		 height)
 {
 	RsvgHandle		*handle;
 	GError			*error;
@@ -78,11 +84,13 @@ load_svg (ccss_cairo_image_t	*self,
 
 		rsvg_handle_get_dimensions_sub (handle, &dimensions, fragment);
 		rsvg_handle_get_position_sub (handle, &position, fragment);
-		self->width = dimensions.width;
-		self->height = dimensions.height;
+		self->width = width ? width : dimensions.width;
+		self->height = height ? height : dimensions.height;
 		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 
 						      self->width, self->height);
 		cr = cairo_create (surface);
+		cairo_scale (cr, self->width / dimensions.width,
+			     self->height / dimensions.height);
 		cairo_translate (cr, -1 * position.x, -1 * position.y);
 		ret = rsvg_handle_render_cairo (handle, cr);
 		/* ret = rsvg_handle_render_cairo_sub (handle, cr, fragment); */
@@ -95,11 +103,13 @@ load_svg (ccss_cairo_image_t	*self,
 	} else {
 #endif
 		rsvg_handle_get_dimensions (handle, &dimensions);
-		self->width = dimensions.width;
-		self->height = dimensions.height;
+		self->width = width ? width : dimensions.width;
+		self->height = height ? height : dimensions.height;
 		surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 
 						      self->width, self->height);
 		cr = cairo_create (surface);
+		cairo_scale (cr, self->width / dimensions.width,
+			     self->height / dimensions.height);
 		ret = rsvg_handle_render_cairo (handle, cr);
 		status = cairo_status (cr);
 		if (status != CAIRO_STATUS_SUCCESS) {
@@ -115,6 +125,8 @@ load_svg (ccss_cairo_image_t	*self,
 
 	g_object_unref (G_OBJECT (handle)), handle = NULL;
 
+	self->is_vector = true;
+
 	return true;
 }
 
@@ -145,8 +157,14 @@ load_png (ccss_cairo_image_t	*self,
 	return true;
 }
 
+/*
+ * Vector images are rasterized at `width' x `height' pixels, unless those
+ * are 0. Bitmaps are always loaded at their own size.
+ */
 ccss_cairo_image_t *
-ccss_cairo_image_create (char const *url)
+ccss_cairo_image_create_at_size (char const	*url,
+				 unsigned int	 width,
+				 unsigned int	 height)
 {
 	bool			 matched;
 	char			*path;
@@ -171,7 +189,7 @@ ccss_cairo_image_create (char const *url)
 #if CCSS_WITH_RSVG
 	if (!matched &&
 	    g_str_has_suffix (path, ".svg")) {
-		matched = load_svg (self, path, fragment);
+		matched = load_svg (self, path, fragment, width, height);
 	}
 #endif
 
@@ -203,3 +221,9 @@ ccss_cairo_image_create (char const *url)
 	return self;
 }
 
+ccss_cairo_image_t *
+ccss_cairo_image_create (char const *url)
+{
+	return ccss_cairo_image_create_at_size (url, 0, 0);
+}
+
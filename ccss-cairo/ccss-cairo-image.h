@@ -38,11 +38,17 @@ typedef struct {
 	cairo_pattern_t *pattern;
 	double		 width;
 	double		 height;
+	bool		 is_vector;
 } ccss_cairo_image_t;
 
 ccss_cairo_image_t *
 ccss_cairo_image_create (char const *uri);
 
+ccss_cairo_image_t *
+ccss_cairo_image_create_at_size (char const	*uri,
+				 unsigned int	 width,
+				 unsigned int	 height);
+
 void
 ccss_cairo_image_destroy (ccss_cairo_image_t *self);
 
@@ -0,0 +1,308 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The Cairo CSS Drawing Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Direct access to struct members for fun and profit. */
+#include <ccss/ccss-macros.h>
+
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include "ccss/ccss-background-priv.h"
+#include "ccss/ccss-style-priv.h"
+#include "ccss/ccss-stylesheet-priv.h"
+#include "ccss-cairo-cache.h"
+#include "ccss-cairo-image-cache.h"
+#include "ccss-cairo-property.h"
+#include "ccss-cairo-render-cache.h"
+#include "config.h"
+
+typedef struct {
+	ccss_cairo_render_key_t	 key;
+	cairo_surface_t		*surface;
+	double			 margin;
+	size_t			 size;
+	GList			 link;
+} entry_t;
+
+static GHashTable	*_render_hash = NULL;
+static GQueue		 _render_lru = G_QUEUE_INIT;
+static size_t		 _render_size = 0;
+static size_t		 _render_max_size = 0;
+G_LOCK_DEFINE_STATIC (_render_hash);
+
+static guint
+key_hash (ccss_cairo_render_key_t const *key)
+{
+	guint hash;
+
+	hash = GPOINTER_TO_UINT (key->stylesheet);
+	hash = hash * 31 + key->generation;
+	hash = hash * 31 + key->image_generation;
+	for (unsigned int i = 0; i < key->n_properties; i++) {
+		hash = hash * 31 + GPOINTER_TO_UINT (key->properties[i]);
+	}
+	hash = hash * 31 + (guint) key->width;
+	hash = hash * 31 + (guint) key->height;
+
+	return hash;
+}
+
+static gboolean
+key_equal (ccss_cairo_render_key_t const *a,
+	   ccss_cairo_render_key_t const *b)
+{
+	return a->stylesheet == b->stylesheet &&
+	       a->generation == b->generation &&
+	       a->image_generation == b->image_generation &&
+	       a->n_properties == b->n_properties &&
+	       a->width == b->width &&
+	       a->height == b->height &&
+	       a->scale_x == b->scale_x &&
+	       a->scale_y == b->scale_y &&
+	       0 == memcmp (a->properties, b->properties,
+			    a->n_properties * sizeof (void *));
+}
+
+static void
+entry_destroy (entry_t *self)
+{
+	cairo_surface_destroy (self->surface);
+	ccss_cairo_render_cache_key_clear (&self->key);
+	g_free (self);
+}
+
+/* Drop least recently used renderings until the cache fits `max_size'.
+ * Call with the lock held. */
+static void
+trim (size_t max_size)
+{
+	entry_t	*entry;
+	GList	*link;
+
+	while (_render_size > max_size &&
+	       (link = g_queue_pop_tail_link (&_render_lru))) {
+		entry = (entry_t *) link->data;
+		_render_size -= entry->size;
+		/* Destroys the entry. */
+		g_hash_table_remove (_render_hash, &entry->key);
+	}
+}
+
+/*
+ * Set up a key for drawing `style' onto `cr'. Returns false if the cache is
+ * disabled or the drawing can not be reused, i.e. it depends on inline CSS
+ * or the viewport, or is not aligned to device pixels.
+ */
+bool
+ccss_cairo_render_cache_key_init (ccss_cairo_render_key_t	*key,
+				  ccss_style_t const		*style,
+				  cairo_t			*cr,
+				  double			 x,
+				  double			 y,
+				  double			 width,
+				  double			 height)
+{
+	ccss_background_attachment_t const	*bg_attachment;
+	cairo_matrix_t				 matrix;
+	ccss_property_t const			*property;
+	size_t					 max_size;
+	double					 device_x;
+	double					 device_y;
+	unsigned int				 i;
+
+	G_LOCK (_render_hash);
+	max_size = _render_max_size;
+	G_UNLOCK (_render_hash);
+
+	if (0 == max_size)
+		return false;
+
+	/* Inline CSS is owned by the style, its properties are not unique
+	 * once the style is gone. */
+	if (NULL == style->stylesheet || style->blocks)
+		return false;
+
+	bg_attachment = (ccss_background_attachment_t const *)
+		ccss_style_lookup_property (style,
+			CCSS_PROPERTY_BACKGROUND_ATTACHMENT);
+	if (bg_attachment &&
+	    CCSS_BACKGROUND_FIXED == bg_attachment->attachment)
+		return false;
+
+	/* Only scaling, and the box starts on a device pixel. */
+	cairo_get_matrix (cr, &matrix);
+	if (matrix.xy != 0 || matrix.yx != 0 ||
+	    matrix.xx <= 0 || matrix.yy <= 0)
+		return false;
+
+	device_x = x;
+	device_y = y;
+	cairo_user_to_device (cr, &device_x, &device_y);
+	if (device_x != floor (device_x) || device_y != floor (device_y))
+		return false;
+
+	key->stylesheet = style->stylesheet;
+	key->generation = style->stylesheet->generation;
+	key->image_generation = ccss_cairo_image_cache_get_generation ();
+	key->n_properties = style->n_properties;
+	key->properties = g_new (void const *, key->n_properties);
+	key->width = width;
+	key->height = height;
+	key->scale_x = matrix.xx;
+	key->scale_y = matrix.yy;
+
+	/* Slot order doesn't depend on the order properties were applied
+	 * in. */
+	i = 0;
+	for (unsigned int slot = 1; slot < style->n_slots; slot++) {
+		property = style->properties[slot].property;
+		if (property)
+			key->properties[i++] = property;
+	}
+
+	return true;
+}
+
+void
+ccss_cairo_render_cache_key_clear (ccss_cairo_render_key_t *key)
+{
+	g_free (key->properties), key->properties = NULL;
+	key->n_properties = 0;
+}
+
+/*
+ * Returns a reference to the cached rendering, which includes `margin'
+ * device pixels around the box for strokes reaching outside of it.
+ */
+cairo_surface_t *
+ccss_cairo_render_cache_lookup (ccss_cairo_render_key_t const	*key,
+				double				*margin)
+{
+	entry_t		*entry;
+	cairo_surface_t	*surface;
+
+	surface = NULL;
+
+	G_LOCK (_render_hash);
+
+	entry = _render_hash ? g_hash_table_lookup (_render_hash, key) : NULL;
+	if (entry) {
+		g_queue_unlink (&_render_lru, &entry->link);
+		g_queue_push_head_link (&_render_lru, &entry->link);
+		surface = cairo_surface_reference (entry->surface);
+		*margin = entry->margin;
+	}
+
+	G_UNLOCK (_render_hash);
+
+	return surface;
+}
+
+void
+ccss_cairo_render_cache_store (ccss_cairo_render_key_t const	*key,
+			       cairo_surface_t			*surface,
+			       double				 margin)
+{
+	entry_t		*entry;
+	size_t		 size;
+
+	/* 4 bytes per ARGB32 pixel. */
+	size = 4 * (size_t) (ceil (key->width * key->scale_x + 2 * margin) *
+			     ceil (key->height * key->scale_y + 2 * margin));
+
+	G_LOCK (_render_hash);
+
+	if (size > _render_max_size) {
+		G_UNLOCK (_render_hash);
+		return;
+	}
+
+	if (NULL == _render_hash) {
+		_render_hash = g_hash_table_new_full (
+					(GHashFunc) key_hash,
+					(GEqualFunc) key_equal,
+					NULL,
+					(GDestroyNotify) entry_destroy);
+	} else if (g_hash_table_lookup (_render_hash, key)) {
+		/* Another thread has been faster. */
+		G_UNLOCK (_render_hash);
+		return;
+	}
+
+	trim (_render_max_size - size);
+
+	entry = g_new0 (entry_t, 1);
+	entry->key = *key;
+	entry->key.properties = g_memdup (key->properties,
+					  key->n_properties * sizeof (void *));
+	entry->surface = cairo_surface_reference (surface);
+	entry->margin = margin;
+	entry->size = size;
+	entry->link.data = entry;
+
+	g_hash_table_insert (_render_hash, &entry->key, entry);
+	g_queue_push_head_link (&_render_lru, &entry->link);
+	_render_size += size;
+
+	G_UNLOCK (_render_hash);
+}
+
+/**
+ * ccss_cairo_render_cache_set_size:
+ * @max_size:	budget for cached renderings in bytes, 0 disables the cache.
+ *
+ * Keep the result of ccss_cairo_style_draw_rectangle() around and copy it
+ * onto the target on subsequent draws of the same style at the same size
+ * and scale. Renderings are dropped when the stylesheet changes, and when
+ * images are added to or evicted from the image cache. The cache is
+ * disabled by default.
+ **/
+void
+ccss_cairo_render_cache_set_size (size_t max_size)
+{
+	G_LOCK (_render_hash);
+
+	_render_max_size = max_size;
+	if (_render_hash)
+		trim (max_size);
+
+	G_UNLOCK (_render_hash);
+}
+
+/**
+ * ccss_cairo_render_cache_clear:
+ *
+ * Drop all cached renderings.
+ **/
+void
+ccss_cairo_render_cache_clear (void)
+{
+	G_LOCK (_render_hash);
+
+	if (_render_hash) {
+		trim (0);
+		g_hash_table_destroy (_render_hash);
+		_render_hash = NULL;
+	}
+
+	G_UNLOCK (_render_hash);
+}
+
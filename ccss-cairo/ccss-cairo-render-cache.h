@@ -0,0 +1,75 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The Cairo CSS Drawing Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CCSS_CAIRO_RENDER_CACHE_H
+#define CCSS_CAIRO_RENDER_CACHE_H
+
+#ifndef CCSS_CAIRO_H
+  #ifndef CCSS_CAIRO_BUILD
+    #error "Only <ccss-cairo/ccss-cairo.h> can be included directly."
+  #endif
+#endif
+
+#include <cairo.h>
+#include <ccss/ccss.h>
+
+CCSS_BEGIN_DECLS
+
+/*
+ * Identifies the rendering of a style at a given size and device scale.
+ */
+typedef struct {
+	ccss_stylesheet_t const	 *stylesheet;
+	unsigned int		  generation;
+	unsigned int		  image_generation;
+	unsigned int		  n_properties;
+	void const		**properties;
+	double			  width;
+	double			  height;
+	double			  scale_x;
+	double			  scale_y;
+} ccss_cairo_render_key_t;
+
+bool
+ccss_cairo_render_cache_key_init (ccss_cairo_render_key_t	*key,
+				  ccss_style_t const		*style,
+				  cairo_t			*cr,
+				  double			 x,
+				  double			 y,
+				  double			 width,
+				  double			 height);
+
+void
+ccss_cairo_render_cache_key_clear (ccss_cairo_render_key_t *key);
+
+cairo_surface_t *
+ccss_cairo_render_cache_lookup (ccss_cairo_render_key_t const	*key,
+				double				*margin);
+
+void
+ccss_cairo_render_cache_store (ccss_cairo_render_key_t const	*key,
+			       cairo_surface_t			*surface,
+			       double				 margin);
+
+CCSS_END_DECLS
+
+#endif /* CCSS_CAIRO_RENDER_CACHE_H */
+
@@ -19,6 +19,7 @@
  * MA 02110-1301, USA.
  */
 
+#include <math.h>
 #include <string.h>
 #include <glib.h>
 #include "ccss/ccss-background-priv.h"
@@ -31,6 +32,7 @@
 #include "ccss-cairo-border-image.h"
 #include "ccss-cairo-style.h"
 #include "ccss-cairo-property.h"
+#include "ccss-cairo-render-cache.h"
 #include "config.h"
 
 typedef struct {
@@ -92,9 +94,7 @@ lookup_property_r (ccss_style_t const	*self,
 
 	property_id = g_quark_try_string (property_name);
 	if (property_id) {
-		property = (ccss_property_t const *)
-				g_hash_table_lookup (self->properties,
-						     (gpointer) property_id);
+		property = ccss_style_lookup_property (self, property_id);
 	}
 	if (property) {
 		return property;
@@ -205,112 +205,161 @@ gather_background (ccss_style_t const			 *self,
 		   ccss_background_size_t const		**bg_size)
 {
 	*bg_attachment = (ccss_background_attachment_t const *) 
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BACKGROUND_ATTACHMENT);
+		ccss_style_lookup_property (self,
+			CCSS_PROPERTY_BACKGROUND_ATTACHMENT);
 	if (!*bg_attachment)
 		*bg_attachment = NULL;
 
 	*bg_color = (ccss_color_t const *)
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BACKGROUND_COLOR);
+		ccss_style_lookup_property (self,
+			CCSS_PROPERTY_BACKGROUND_COLOR);
 	if (!*bg_color)
 		*bg_color = NULL;
 
 	*bg_image = (ccss_background_image_t const *)
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BACKGROUND_IMAGE);
+		ccss_style_lookup_property (self,
+			CCSS_PROPERTY_BACKGROUND_IMAGE);
 	if (!*bg_image)
 		*bg_image = NULL;
 
 	*bg_position = (ccss_background_position_t const *)
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BACKGROUND_POSITION);
+		ccss_style_lookup_property (self,
+			CCSS_PROPERTY_BACKGROUND_POSITION);
 	if (!*bg_position)
 		*bg_position = NULL;
 
 	*bg_repeat = (ccss_background_repeat_t const *)
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BACKGROUND_REPEAT);
+		ccss_style_lookup_property (self,
+			CCSS_PROPERTY_BACKGROUND_REPEAT);
 	if (!*bg_repeat)
 		*bg_repeat = NULL;
 
 	*bg_size = (ccss_background_size_t const *)
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BACKGROUND_SIZE);
+		ccss_style_lookup_property (self,
+			CCSS_PROPERTY_BACKGROUND_SIZE);
 	if (!*bg_size)
 		*bg_size = NULL;
 }
 
-/**
- * ccss_cairo_style_draw_rectangle:
- * @self:	a #ccss_style_t.
- * @cr:		the target to draw onto.
- * @x:		the starting x coordinate.
- * @y:		the starting y coordinate.
- * @width:	width of the outline to draw.
- * @height:	height of the outline to draw.
- *
- * Draw a rectangle using this style instance.
- **/
-void
-ccss_cairo_style_draw_rectangle (ccss_style_t const	*self,
-				 cairo_t		*cr, 
-				 double			 x,
-				 double			 y,
-				 double			 width,
-				 double			 height)
-{
-	ccss_border_stroke_t		 bottom, left, right, top;
-	ccss_border_join_t const	*bottom_left;
-	ccss_border_join_t const	*bottom_right;
-	ccss_border_join_t const	*top_left;
-	ccss_border_join_t const	*top_right;
-	ccss_border_image_t const	*border_image;
-
+/* Everything drawing needs from a style, with fallbacks resolved. */
+typedef struct {
+	uint64_t				 properties_hash;
+	ccss_cairo_appearance_t const		*appearance;
+	ccss_border_stroke_t			 bottom;
+	ccss_border_stroke_t			 left;
+	ccss_border_stroke_t			 right;
+	ccss_border_stroke_t			 top;
+	ccss_border_join_t const		*bottom_left;
+	ccss_border_join_t const		*bottom_right;
+	ccss_border_join_t const		*top_left;
+	ccss_border_join_t const		*top_right;
 	ccss_background_attachment_t const	*bg_attachment;
 	ccss_color_t const			*bg_color;
 	ccss_background_image_t const		*bg_image;
 	ccss_background_position_t const	*bg_position;
 	ccss_background_repeat_t const		*bg_repeat;
 	ccss_background_size_t const		*bg_size;
+	ccss_border_image_t const		*border_image;
+} draw_record_t;
+
+static void
+resolve_draw_record (ccss_style_t const	*self,
+		     draw_record_t	*record)
+{
+	record->properties_hash = self->properties_hash;
+
+	record->appearance = NULL;
+	ccss_style_get_property (self, "ccss-appearance",
+				 (ccss_property_t const **) &record->appearance);
+
+	gather_outline (self, &record->bottom, &record->left,
+			&record->right, &record->top,
+			&record->bottom_left, &record->bottom_right,
+			&record->top_left, &record->top_right);
+
+	gather_background (self, &record->bg_attachment, &record->bg_color,
+			   &record->bg_image, &record->bg_position,
+			   &record->bg_repeat, &record->bg_size);
+
+	record->border_image = (ccss_border_image_t const *)
+		ccss_style_lookup_property (self, CCSS_PROPERTY_BORDER_IMAGE);
+}
+
+/*
+ * The draw record is resolved on first use and kept with the style. Styles
+ * may be shared between threads, so the record is published atomically and
+ * never replaced. Should the style have changed since, it is resolved into
+ * `scratch' instead.
+ */
+static draw_record_t const *
+get_draw_record (ccss_style_t const	*self,
+		 draw_record_t		*scratch)
+{
+	ccss_style_t	*style = (ccss_style_t *) self;
+	draw_record_t	*record;
+
+	record = (draw_record_t *) g_atomic_pointer_get (&style->draw_record);
+	if (record && record->properties_hash == self->properties_hash)
+		return record;
+
+	if (record) {
+		resolve_draw_record (self, scratch);
+		return scratch;
+	}
+
+	record = g_new (draw_record_t, 1);
+	resolve_draw_record (self, record);
+	if (!g_atomic_pointer_compare_and_exchange (&style->draw_record,
+						    NULL, record)) {
+		/* Another thread was faster. */
+		g_free (record);
+		return get_draw_record (self, scratch);
+	}
+
+	return record;
+}
+
+static bool
+has_appearance (draw_record_t const *record)
+{
+	return record->appearance &&
+	       CCSS_PROPERTY_STATE_SET == record->appearance->base.state &&
+	       record->appearance->draw_function;
+}
+
+static void
+draw_rectangle (ccss_style_t const	*self,
+		cairo_t			*cr, 
+		double			 x,
+		double			 y,
+		double			 width,
+		double			 height)
+{
+	draw_record_t const	*record;
+	draw_record_t		 scratch;
 
 	double l, t, w, h;
 
-	ccss_cairo_appearance_t *appearance = NULL;
-	if (ccss_style_get_property (self,
-				     "ccss-appearance",
-				     (ccss_property_t const **) &appearance) &&
-	    appearance->base.state == CCSS_PROPERTY_STATE_SET &&
-	    appearance->draw_function) {
+	record = get_draw_record (self, &scratch);
 
-		bool ret = appearance->draw_function (self, cr,
-						      x, y, width, height);
+	if (has_appearance (record)) {
+
+		bool ret = record->appearance->draw_function (self, cr,
+						x, y, width, height);
 		if (ret)
 			return;
 	}
 
-	gather_outline (self, &bottom, &left, &right, &top,
-			&bottom_left, &bottom_right, &top_left, &top_right);
-
-	gather_background (self, &bg_attachment, &bg_color, &bg_image, 
-			   &bg_position, &bg_repeat, &bg_size);
-
-	ccss_cairo_border_path (&left, top_left, 
-				&top, top_right,
-				&right, bottom_right,
-				&bottom, bottom_left,
+	ccss_cairo_border_path (&record->left, record->top_left, 
+				&record->top, record->top_right,
+				&record->right, record->bottom_right,
+				&record->bottom, record->bottom_left,
 				cr, x, y, width, height);
 
 	/* FIXME: background size is calculated against allocation
 	 * when using `fixed'. */
-	if (bg_attachment &&
-	    CCSS_BACKGROUND_FIXED == bg_attachment->attachment) {
+	if (record->bg_attachment &&
+	    CCSS_BACKGROUND_FIXED == record->bg_attachment->attachment) {
 		l = self->viewport_x;
 		t = self->viewport_y;
 		w = self->viewport_width;
@@ -322,32 +371,154 @@ ccss_cairo_style_draw_rectangle (ccss_style_t const	*self,
 		h = height;
 	}
 
-	ccss_cairo_background_fill (bg_attachment, bg_color, bg_image, bg_position, 
-				    bg_repeat, bg_size, cr, l, t, w, h);
+	ccss_cairo_background_fill (record->bg_attachment, record->bg_color,
+				    record->bg_image, record->bg_position,
+				    record->bg_repeat, record->bg_size,
+				    cr, l, t, w, h);
 
 	cairo_new_path (cr);
 
 	/* PONDERING: should border-image vs. border be resolved at style application time, 
 	 * i.e. should a higher-priority border override border-image? */
-	border_image = 	(ccss_border_image_t const *) 
-		g_hash_table_lookup (
-			self->properties,
-			(gpointer) CCSS_PROPERTY_BORDER_IMAGE);
-
-	if (border_image) {
-		ccss_cairo_border_image_draw (border_image, cr,
-					      x, y, width, height);
-
-	} else {
-		ccss_cairo_border_draw (&left, top_left, 
-					&top, top_right,
-					&right, bottom_right,
-					&bottom, bottom_left,
+	if (NULL == record->border_image ||
+	    !ccss_cairo_border_image_draw (record->border_image, cr,
+					   x, y, width, height)) {
+		/* Also when the border-image has not been decoded yet. */
+		ccss_cairo_border_draw (&record->left, record->top_left, 
+					&record->top, record->top_right,
+					&record->right, record->bottom_right,
+					&record->bottom, record->bottom_left,
 					CCSS_BORDER_VISIBILITY_SHOW_ALL,
 					cr, x, y, width, height);
 	}
 }
 
+/* Device pixels around the box reached by border strokes. */
+static double
+outline_margin (ccss_style_t const	*self,
+		cairo_t			*cr)
+{
+	draw_record_t const		*record;
+	draw_record_t			 scratch;
+	ccss_border_stroke_t const	*strokes[4];
+	double				 margin;
+	double				 dx, dy;
+
+	record = get_draw_record (self, &scratch);
+
+	strokes[0] = &record->bottom;
+	strokes[1] = &record->left;
+	strokes[2] = &record->right;
+	strokes[3] = &record->top;
+
+	margin = 0;
+	for (unsigned int i = 0; i < G_N_ELEMENTS (strokes); i++) {
+		if (strokes[i]->width &&
+		    strokes[i]->width->width / 2 > margin)
+			margin = strokes[i]->width->width / 2;
+	}
+
+	dx = margin;
+	dy = margin;
+	cairo_user_to_device_distance (cr, &dx, &dy);
+
+	/* One extra pixel for antialiasing. */
+	return ceil (MAX (dx, dy)) + 1;
+}
+
+/**
+ * ccss_cairo_style_draw_rectangle:
+ * @self:	a #ccss_style_t.
+ * @cr:		the target to draw onto.
+ * @x:		the starting x coordinate.
+ * @y:		the starting y coordinate.
+ * @width:	width of the outline to draw.
+ * @height:	height of the outline to draw.
+ *
+ * Draw a rectangle using this style instance.
+ **/
+void
+ccss_cairo_style_draw_rectangle (ccss_style_t const	*self,
+				 cairo_t		*cr,
+				 double			 x,
+				 double			 y,
+				 double			 width,
+				 double			 height)
+{
+	ccss_cairo_render_key_t	 key;
+	cairo_surface_t		*surface;
+	cairo_t			*surface_cr;
+	double			 margin;
+	double			 device_x;
+	double			 device_y;
+
+	g_return_if_fail (self && cr);
+
+	if (!ccss_cairo_render_cache_key_init (&key, self, cr,
+					       x, y, width, height)) {
+		draw_rectangle (self, cr, x, y, width, height);
+		return;
+	}
+
+	surface = ccss_cairo_render_cache_lookup (&key, &margin);
+	if (NULL == surface) {
+		/* Render in device pixels, with room for the strokes. */
+		margin = outline_margin (self, cr);
+		surface = cairo_surface_create_similar (
+				cairo_get_target (cr),
+				CAIRO_CONTENT_COLOR_ALPHA,
+				ceil (width * key.scale_x + 2 * margin),
+				ceil (height * key.scale_y + 2 * margin));
+		surface_cr = cairo_create (surface);
+		cairo_translate (surface_cr, margin, margin);
+		cairo_scale (surface_cr, key.scale_x, key.scale_y);
+		draw_rectangle (self, surface_cr, 0, 0, width, height);
+		cairo_destroy (surface_cr), surface_cr = NULL;
+
+		ccss_cairo_render_cache_store (&key, surface, margin);
+	}
+
+	device_x = x;
+	device_y = y;
+	cairo_user_to_device (cr, &device_x, &device_y);
+
+	cairo_save (cr);
+	cairo_identity_matrix (cr);
+	cairo_set_source_surface (cr, surface,
+				  device_x - margin, device_y - margin);
+	cairo_paint (cr);
+	cairo_restore (cr);
+
+	cairo_surface_destroy (surface), surface = NULL;
+	ccss_cairo_render_cache_key_clear (&key);
+}
+
+/*
+ * Temporary copy of `style' for the appearance function, with room for the
+ * gap properties. It has its own property array and draw record, and no
+ * stylesheet, so the gap properties on the stack never end up in the
+ * render cache.
+ */
+static void
+gap_style_init (ccss_style_t		*gap_style,
+		ccss_style_t const	*style)
+{
+	*gap_style = *style;
+	gap_style->reference_count = 1;
+	gap_style->stylesheet = NULL;
+	gap_style->draw_record = NULL;
+	gap_style->properties = g_memdup (style->properties,
+					  style->n_slots *
+					  sizeof (ccss_style_slot_t));
+}
+
+static void
+gap_style_clear (ccss_style_t *gap_style)
+{
+	g_free (gap_style->properties);
+	g_free (gap_style->draw_record);
+}
+
 /**
  * ccss_cairo_style_draw_rectangle_with_gap:
  * @self:	a ccss_style_t.
@@ -373,18 +544,9 @@ ccss_cairo_style_draw_rectangle_with_gap (ccss_style_t const		*self,
 					  double			 gap_start,
 					  double			 gap_width)
 {
+	draw_record_t const		*record;
+	draw_record_t			 scratch;
 	ccss_border_stroke_t		 bottom, left, right, top;
-	ccss_border_join_t const	*bl;
-	ccss_border_join_t const	*br;
-	ccss_border_join_t const	*tl;
-	ccss_border_join_t const	*tr;
-
-	ccss_background_attachment_t const	*bg_attachment;
-	ccss_color_t const			*bg_color;
-	ccss_background_image_t const		*bg_image;
-	ccss_background_position_t const	*bg_position;
-	ccss_background_repeat_t const		*bg_repeat;
-	ccss_background_size_t const		*bg_size;
 
 	ccss_border_join_t bottom_left = { .base.state = CCSS_PROPERTY_STATE_SET, .radius = 0 };
 	ccss_border_join_t bottom_right = { .base.state = CCSS_PROPERTY_STATE_SET, .radius = 0 };
@@ -393,77 +555,61 @@ ccss_cairo_style_draw_rectangle_with_gap (ccss_style_t const		*self,
 
 	double l, t, w, h;
 
-	ccss_cairo_appearance_t *appearance = NULL;
-	if (ccss_style_get_property (self,
-				     "ccss-appearance",
-				     (ccss_property_t const **) &appearance) &&
-	    appearance->base.state == CCSS_PROPERTY_STATE_SET &&
-	    appearance->draw_function) {
+	record = get_draw_record (self, &scratch);
 
-		static GQuark gap_side_id = 0;
-		static GQuark gap_start_id = 0;
-		static GQuark gap_width_id = 0;
+	if (has_appearance (record)) {
 
+		ccss_style_t gap_style;
 		gap_side_t gap_side_property;
 		gap_start_t gap_start_property;
 		gap_width_t gap_width_property;
 
 		bool ret;
 
-		if (gap_side_id == 0)
-			gap_side_id = g_quark_from_static_string ("ccss-gap-side");
+		/* The style may be shared, the gap goes into a copy. */
+		gap_style_init (&gap_style, self);
+
 		ccss_property_init (&gap_side_property.base,
 				    peek_property_class ("ccss-gap-side"));
 		gap_side_property.side = gap_side;
 		gap_side_property.base.state = CCSS_PROPERTY_STATE_SET;
-		g_hash_table_insert (self->properties,
-				     (gpointer) gap_side_id,
-				     &gap_side_property);
+		ccss_style_set_property (&gap_style, "ccss-gap-side",
+					 &gap_side_property.base);
 
-		if (gap_start_id == 0)
-			gap_start_id = g_quark_from_static_string ("ccss-gap-start");
 		ccss_property_init (&gap_start_property.base,
 				    peek_property_class ("ccss-gap-start"));
 		gap_start_property.start = gap_start;
 		gap_start_property.base.state = CCSS_PROPERTY_STATE_SET;
-		g_hash_table_insert (self->properties,
-				     (gpointer) gap_start_id,
-				     &gap_start_property);
+		ccss_style_set_property (&gap_style, "ccss-gap-start",
+					 &gap_start_property.base);
 
-		if (gap_width_id == 0)
-			gap_width_id = g_quark_from_static_string ("ccss-gap-width");
 		ccss_property_init (&gap_width_property.base,
 				    peek_property_class ("ccss-gap-width"));
 		gap_width_property.width = gap_width;
 		gap_width_property.base.state = CCSS_PROPERTY_STATE_SET;
-		g_hash_table_insert (self->properties,
-				     (gpointer) gap_width_id,
-				     &gap_width_property);
+		ccss_style_set_property (&gap_style, "ccss-gap-width",
+					 &gap_width_property.base);
 
-		ret = appearance->draw_function (self, cr,
-						 x, y, width, height);
+		ret = record->appearance->draw_function (&gap_style, cr,
+						x, y, width, height);
 
-		g_hash_table_remove (self->properties, (gpointer) gap_side_id);
-		g_hash_table_remove (self->properties, (gpointer) gap_start_id);
-		g_hash_table_remove (self->properties, (gpointer) gap_width_id);
+		gap_style_clear (&gap_style);
 
 		if (ret)
 			return;
 	}
 
-	gather_outline (self, &bottom, &left, &right, &top,
-			&bl, &br, &tl, &tr);
-
-	gather_background (self, &bg_attachment, &bg_color, &bg_image, 
-			   &bg_position, &bg_repeat, &bg_size);
-
+	bottom = record->bottom;
+	left = record->left;
+	right = record->right;
+	top = record->top;
 
 	/* The rounding radii will have to be adjusted for certain gap
 	 * positions, so we work on a copied set of them. */
-	if (bl) bottom_left = *bl;
-	if (br) bottom_right = *br;
-	if (tl) top_left = *tl;
-	if (tr) top_right = *tr;
+	if (record->bottom_left) bottom_left = *record->bottom_left;
+	if (record->bottom_right) bottom_right = *record->bottom_right;
+	if (record->top_left) top_left = *record->top_left;
+	if (record->top_right) top_right = *record->top_right;
 
 	switch (gap_side) {
 	case CCSS_CAIRO_GAP_SIDE_LEFT:
@@ -512,8 +658,8 @@ ccss_cairo_style_draw_rectangle_with_gap (ccss_style_t const		*self,
 
 	/* FIXME: background size is calculated against allocation
 	 * when using `fixed'. */
-	if (bg_attachment && 
-	    CCSS_BACKGROUND_FIXED == bg_attachment->attachment) {
+	if (record->bg_attachment && 
+	    CCSS_BACKGROUND_FIXED == record->bg_attachment->attachment) {
 		l = self->viewport_x;
 		t = self->viewport_y;
 		w = self->viewport_width;
@@ -525,8 +671,10 @@ ccss_cairo_style_draw_rectangle_with_gap (ccss_style_t const		*self,
 		h = height;
 	}
 
-	ccss_cairo_background_fill (bg_attachment, bg_color, bg_image, bg_position, 
-				    bg_repeat, bg_size, cr, l, t, w, h);
+	ccss_cairo_background_fill (record->bg_attachment, record->bg_color,
+				    record->bg_image, record->bg_position,
+				    record->bg_repeat, record->bg_size,
+				    cr, l, t, w, h);
 
 	cairo_new_path (cr);
 
@@ -31,7 +31,6 @@
 typedef struct {
 	char const	*type_name;
 	char const	*id;
-	char const	*pseudo_classes[2];
 } Widget;
 
 static char const *
@@ -50,14 +49,6 @@ get_id (ccss_node_t const *self)
 	return w->id;
 }
 
-static char const **
-get_pseudo_classes (ccss_node_t const *self)
-{
-	Widget *w = ccss_node_get_user_data (self);
-
-	return (char const **) w->pseudo_classes;
-}
-
 static ccss_node_class_t _node_class = {
 	.is_a			= NULL,
 	.get_container		= NULL,
@@ -65,7 +56,7 @@ static ccss_node_class_t _node_class = {
 	.get_id			= get_id,
 	.get_type		= get_type,
 	.get_classes		= NULL,
-	.get_pseudo_classes	= get_pseudo_classes,
+	.get_pseudo_classes	= NULL,
 	.get_attribute		= NULL,
 	.get_viewport		= NULL,
 	.release		= NULL
@@ -242,27 +233,14 @@ get_rc_selector (char const *type_name)
 }
 
 static gboolean
-accumulate_state (ccss_stylesheet_t 	 *stylesheet,
+accumulate_state (ccss_style_t const	 *style,
 		  char const		 *type_name,
-		  char const		 *state_name,
 		  struct RcState	 *state,
 		  GSList		**style_properties)
 {
-	ccss_style_t	*style;
-	ccss_node_t	*node;
-	Widget		 widget;
 	char		*color;
 	gboolean	 ret;
 
-	widget.type_name = type_name;
-	widget.id = NULL;
-	widget.pseudo_classes[0] = state_name;
-	widget.pseudo_classes[1] = NULL;
-	node = ccss_node_create (&_node_class,
-				 CCSS_NODE_CLASS_N_METHODS (_node_class),
-				 &widget);
-	style = ccss_stylesheet_query (stylesheet, node);
-	ccss_node_destroy (node);
 	if (!style) {
 		return false;
 	}
@@ -308,8 +286,6 @@ accumulate_state (ccss_stylesheet_t 	 *stylesheet,
 				    style_properties);
 	}
 
-	ccss_style_destroy (style), style = NULL;
-
 	/* Having colors or style properties means there's something to serialise. */
 	return true;
 }
@@ -318,46 +294,52 @@ static bool
 accumulate (ccss_stylesheet_t	*stylesheet,
 	    struct RcBlock	*block)
 {
-	bool ret;
-
-	/* Querying for `normal' state without any- and with the `normal' pseudo class. */
-	ret = accumulate_state (stylesheet, block->type_name, NULL,
-				&block->colors[NORMAL], &block->style_properties);
-	if (ret) {
-		block->flags |= STYLE_SET;
-		if (block->colors[NORMAL].flags) {
-			block->flags |= NORMAL_SET;
-		}
-	}
-
-	ret = accumulate_state (stylesheet, block->type_name, "normal",
-				&block->colors[NORMAL], NULL);
-	if (ret && block->colors[NORMAL].flags) {
-		block->flags |= NORMAL_SET;
-	}
+	/* Querying for `normal' state without any- and with the `normal'
+	 * pseudo class. */
+	static char const *_states[] = { NULL, "normal", "active", "prelight",
+					 "selected", "insensitive" };
+	static const struct {
+		unsigned int	state;
+		unsigned int	flag;
+	} _colors[] = {
+		{ NORMAL,	NORMAL_SET },
+		{ NORMAL,	NORMAL_SET },
+		{ ACTIVE,	ACTIVE_SET },
+		{ PRELIGHT,	PRELIGHT_SET },
+		{ SELECTED,	SELECTED_SET },
+		{ INSENSITIVE,	INSENSITIVE_SET }
+	};
+	ccss_style_t	*styles[G_N_ELEMENTS (_states)];
+	ccss_node_t	*node;
+	Widget		 widget;
+	bool		 ret;
 
-	ret = accumulate_state (stylesheet, block->type_name, "active",
-				&block->colors[ACTIVE], NULL);
-	if (ret && block->colors[ACTIVE].flags) {
-		block->flags |= ACTIVE_SET;
-	}
+	/* All states in one go, state independent rules are matched once. */
+	widget.type_name = block->type_name;
+	widget.id = NULL;
+	node = ccss_node_create (&_node_class,
+				 CCSS_NODE_CLASS_N_METHODS (_node_class),
+				 &widget);
+	ccss_stylesheet_query_states (stylesheet, node, _states,
+				      G_N_ELEMENTS (_states), styles);
+	ccss_node_destroy (node);
 
-	ret = accumulate_state (stylesheet, block->type_name, "prelight",
-				&block->colors[PRELIGHT], NULL);
-	if (ret && block->colors[PRELIGHT].flags) {
-		block->flags |= PRELIGHT_SET;
-	}
+	for (unsigned int i = 0; i < G_N_ELEMENTS (_states); i++) {
 
-	ret = accumulate_state (stylesheet, block->type_name, "selected",
-				&block->colors[SELECTED], NULL);
-	if (ret && block->colors[SELECTED].flags) {
-		block->flags |= SELECTED_SET;
-	}
+		/* Extract style properties, only for default state. */
+		ret = accumulate_state (styles[i], block->type_name,
+					&block->colors[_colors[i].state],
+					0 == i ? &block->style_properties : NULL);
+		if (ret && 0 == i) {
+			block->flags |= STYLE_SET;
+		}
+		if (ret && block->colors[_colors[i].state].flags) {
+			block->flags |= _colors[i].flag;
+		}
 
-	ret = accumulate_state (stylesheet, block->type_name, "insensitive",
-				&block->colors[INSENSITIVE], NULL);
-	if (ret && block->colors[INSENSITIVE].flags) {
-		block->flags |= INSENSITIVE_SET;
+		if (styles[i]) {
+			ccss_style_destroy (styles[i]), styles[i] = NULL;
+		}
 	}
 
 	return (bool) block->flags;
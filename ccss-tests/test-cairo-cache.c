@@ -0,0 +1,486 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/*
+ * Behaviour of the ccss-cairo image, border-image tile and render caches.
+ * The caches are process-wide, so every test starts by purging them and
+ * compares statistics before and after drawing.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ccss/ccss-function-impl.h>
+#include <ccss-cairo/ccss-cairo.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "config.h"
+
+/* Fixtures are 8x8 pixels, decoded into 4 bytes per pixel. */
+#define FIXTURE_BYTES	(8 * 8 * 4)
+
+#define RED		0xffff0000
+#define GREEN		0xff00ff00
+
+static char const *_srcdir = ".";
+
+/* Resolve relative URLs against the fixtures in $srcdir. */
+static char *
+url (GSList const	*args,
+     void		*user_data)
+{
+	char const	*arg;
+	char		*path;
+	char		*uri;
+
+	g_return_val_if_fail (args && args->data, NULL);
+
+	arg = (char const *) args->data;
+	path = g_path_is_absolute (arg) ?
+			g_strdup (arg) :
+			g_build_filename (_srcdir, arg, NULL);
+	uri = g_filename_to_uri (path, NULL, NULL);
+	g_free (path);
+
+	return uri;
+}
+
+static ccss_function_t _functions[] =
+{
+  { "url",	url,	1 },
+  { NULL }
+};
+
+static ccss_stylesheet_t *
+create_stylesheet (char const *css)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+
+	grammar = ccss_cairo_grammar_create ();
+	ccss_grammar_add_functions (grammar, _functions);
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							css, strlen (css),
+							NULL);
+	g_assert (stylesheet);
+	ccss_grammar_destroy (grammar);
+
+	return stylesheet;
+}
+
+/* Draw `style' at the origin of a fresh surface. */
+static cairo_surface_t *
+draw_style (ccss_style_t const	*style,
+	    double		 width,
+	    double		 height)
+{
+	cairo_surface_t	*surface;
+	cairo_t		*cr;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 128, 128);
+	cr = cairo_create (surface);
+	ccss_cairo_style_draw_rectangle (style, cr, 0, 0, width, height);
+	cairo_destroy (cr);
+	cairo_surface_flush (surface);
+
+	return surface;
+}
+
+/* Draw a box of type `type_name' and return the color of its top left
+ * pixel. */
+static uint32_t
+draw (ccss_stylesheet_t	*stylesheet,
+      char const	*type_name,
+      double		 width,
+      double		 height)
+{
+	ccss_style_t	*style;
+	cairo_surface_t	*surface;
+	uint32_t	 pixel;
+
+	style = ccss_stylesheet_query_type (stylesheet, type_name);
+	g_assert (style);
+	surface = draw_style (style, width, height);
+	pixel = *(uint32_t *) cairo_image_surface_get_data (surface);
+	cairo_surface_destroy (surface);
+	ccss_style_destroy (style);
+
+	return pixel;
+}
+
+/* Create a temporary image file, so tests can swap its contents. */
+static char *
+create_temporary_image (void)
+{
+	char	*path;
+	int	 fd;
+
+	fd = g_file_open_tmp ("ccss-cairo-cache-XXXXXX.png", &path, NULL);
+	g_assert (fd >= 0);
+	close (fd);
+
+	return path;
+}
+
+static void
+copy_fixture (char const	*fixture,
+	      char const	*path)
+{
+	char	*fixture_path;
+	char	*contents;
+	gsize	 length;
+	bool	 ret;
+
+	fixture_path = g_build_filename (_srcdir, fixture, NULL);
+	ret = g_file_get_contents (fixture_path, &contents, &length, NULL);
+	g_assert (ret);
+	ret = g_file_set_contents (path, contents, length, NULL);
+	g_assert (ret);
+	g_free (contents);
+	g_free (fixture_path);
+}
+
+static void
+test_image_lru (void)
+{
+	static char const _css[] =
+		"red { background-image: url(cache-red.png); }\n"
+		"green { background-image: url(cache-green.png); }\n"
+		"blue { background-image: url(cache-blue.png); }\n";
+	ccss_stylesheet_t		*stylesheet;
+	ccss_cairo_image_cache_stats_t	 before;
+	ccss_cairo_image_cache_stats_t	 stats;
+	size_t				 max_size;
+
+	stylesheet = create_stylesheet (_css);
+	max_size = ccss_cairo_image_cache_get_max_size ();
+	ccss_cairo_image_cache_purge ();
+
+	/* Room for two images. */
+	ccss_cairo_image_cache_set_max_size (2 * FIXTURE_BYTES);
+	g_assert_cmpuint (ccss_cairo_image_cache_get_max_size (), ==,
+			  2 * FIXTURE_BYTES);
+	ccss_cairo_image_cache_get_stats (&before);
+	g_assert_cmpuint (before.n_images, ==, 0);
+	g_assert_cmpuint (before.size, ==, 0);
+
+	g_assert_cmphex (draw (stylesheet, "red", 16, 16), ==, RED);
+	g_assert_cmphex (draw (stylesheet, "green", 16, 16), ==, GREEN);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.misses - before.misses, ==, 2);
+	g_assert_cmpuint (stats.hits - before.hits, ==, 0);
+	g_assert_cmpuint (stats.n_images, ==, 2);
+	g_assert_cmpuint (stats.size, ==, 2 * FIXTURE_BYTES);
+	g_assert_cmpuint (stats.max_size, ==, 2 * FIXTURE_BYTES);
+
+	/* Red becomes the most recently used image, so loading blue
+	 * evicts green. */
+	draw (stylesheet, "red", 16, 16);
+	draw (stylesheet, "blue", 16, 16);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.hits - before.hits, ==, 1);
+	g_assert_cmpuint (stats.misses - before.misses, ==, 3);
+	g_assert_cmpuint (stats.evictions - before.evictions, ==, 1);
+	g_assert_cmpuint (stats.n_images, ==, 2);
+	g_assert_cmpuint (stats.size, ==, 2 * FIXTURE_BYTES);
+
+	draw (stylesheet, "red", 16, 16);
+	draw (stylesheet, "green", 16, 16);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.hits - before.hits, ==, 2);
+	g_assert_cmpuint (stats.misses - before.misses, ==, 4);
+	g_assert_cmpuint (stats.evictions - before.evictions, ==, 2);
+	g_assert_cmpuint (stats.n_in_use, ==, 0);
+
+	ccss_cairo_image_cache_trim (FIXTURE_BYTES);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.n_images, ==, 1);
+	g_assert_cmpuint (stats.size, ==, FIXTURE_BYTES);
+
+	ccss_cairo_image_cache_set_max_size (max_size);
+	ccss_cairo_image_cache_purge ();
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.n_images, ==, 0);
+	g_assert_cmpuint (stats.size, ==, 0);
+	ccss_stylesheet_destroy (stylesheet);
+}
+
+static void
+test_image_pinned (void)
+{
+	static char const _css[] =
+		"red { background-image: url(cache-red.png); }\n";
+	ccss_stylesheet_t		*stylesheet;
+	ccss_cairo_image_cache_stats_t	 before;
+	ccss_cairo_image_cache_stats_t	 stats;
+	size_t				 max_size;
+
+	stylesheet = create_stylesheet (_css);
+	max_size = ccss_cairo_image_cache_get_max_size ();
+	ccss_cairo_image_cache_purge ();
+
+	/* Without a budget the image is trimmed right after loading, but
+	 * survives until it has been drawn. */
+	ccss_cairo_image_cache_set_max_size (0);
+	ccss_cairo_image_cache_get_stats (&before);
+	g_assert_cmphex (draw (stylesheet, "red", 16, 16), ==, RED);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.misses - before.misses, ==, 1);
+	g_assert_cmpuint (stats.evictions - before.evictions, ==, 1);
+	g_assert_cmpuint (stats.n_images, ==, 0);
+	g_assert_cmpuint (stats.n_in_use, ==, 0);
+	g_assert_cmpuint (stats.size, ==, 0);
+
+	ccss_cairo_image_cache_set_max_size (max_size);
+	ccss_stylesheet_destroy (stylesheet);
+}
+
+static void
+loaded (char const	*uri,
+	void		*user_data)
+{
+	g_atomic_int_inc ((int volatile *) user_data);
+}
+
+static void
+test_image_purge_failed (void)
+{
+	ccss_stylesheet_t		*stylesheet;
+	ccss_cairo_image_cache_stats_t	 stats;
+	GLogLevelFlags			 fatal_mask;
+	char				*path;
+	char				*css;
+	int volatile			 n_loaded;
+
+	path = create_temporary_image ();
+	g_unlink (path);
+	css = g_strdup_printf ("late { background-image: url(%s); }", path);
+	stylesheet = create_stylesheet (css);
+	ccss_cairo_image_cache_purge ();
+	n_loaded = 0;
+
+	/* Decoding the missing image warns on the worker thread. */
+	fatal_mask = g_log_set_always_fatal (G_LOG_FATAL_MASK);
+
+	ccss_cairo_image_cache_set_async (1, loaded, (void *) &n_loaded);
+	draw (stylesheet, "late", 16, 16);
+	/* Waits for the queued image. */
+	ccss_cairo_image_cache_set_async (0, NULL, NULL);
+
+	/* Failed images are not tried again... */
+	copy_fixture ("cache-green.png", path);
+	ccss_cairo_image_cache_set_async (1, loaded, (void *) &n_loaded);
+	draw (stylesheet, "late", 16, 16);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.n_pending, ==, 0);
+	ccss_cairo_image_cache_set_async (0, NULL, NULL);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpint (n_loaded, ==, 0);
+	g_assert_cmpuint (stats.n_images, ==, 0);
+
+	/* ... until purged. */
+	ccss_cairo_image_cache_purge ();
+	ccss_cairo_image_cache_set_async (1, loaded, (void *) &n_loaded);
+	draw (stylesheet, "late", 16, 16);
+	ccss_cairo_image_cache_set_async (0, NULL, NULL);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpint (n_loaded, ==, 1);
+	g_assert_cmpuint (stats.n_images, ==, 1);
+	g_assert_cmpuint (stats.n_pending, ==, 0);
+	g_assert_cmphex (draw (stylesheet, "late", 16, 16), ==, GREEN);
+
+	g_log_set_always_fatal (fatal_mask);
+
+	ccss_cairo_image_cache_purge ();
+	ccss_stylesheet_destroy (stylesheet);
+	g_free (css);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+test_border_image_tiles (void)
+{
+	ccss_stylesheet_t	*stylesheet;
+	char			*path;
+	char			*css;
+
+	path = create_temporary_image ();
+	copy_fixture ("cache-red.png", path);
+	css = g_strdup_printf ("tiles { border-image: url(%s) 2; }", path);
+	stylesheet = create_stylesheet (css);
+	ccss_cairo_image_cache_purge ();
+	ccss_cairo_border_image_cache_set_size (1024 * 1024);
+
+	/* Tiles are kept when the image goes away, and are only found
+	 * again for the same box size. */
+	g_assert_cmphex (draw (stylesheet, "tiles", 32, 32), ==, RED);
+	ccss_cairo_image_cache_trim (0);
+	copy_fixture ("cache-green.png", path);
+	g_assert_cmphex (draw (stylesheet, "tiles", 32, 32), ==, RED);
+	g_assert_cmphex (draw (stylesheet, "tiles", 40, 40), ==, GREEN);
+
+	ccss_cairo_border_image_cache_clear ();
+	g_assert_cmphex (draw (stylesheet, "tiles", 32, 32), ==, GREEN);
+
+	/* Tiles exceeding the budget are not cached. */
+	ccss_cairo_border_image_cache_set_size (0);
+	ccss_cairo_image_cache_trim (0);
+	copy_fixture ("cache-red.png", path);
+	g_assert_cmphex (draw (stylesheet, "tiles", 32, 32), ==, RED);
+	ccss_cairo_image_cache_trim (0);
+	copy_fixture ("cache-green.png", path);
+	g_assert_cmphex (draw (stylesheet, "tiles", 32, 32), ==, GREEN);
+
+	ccss_cairo_border_image_cache_set_size (4 * 1024 * 1024);
+	ccss_cairo_image_cache_purge ();
+	ccss_stylesheet_destroy (stylesheet);
+	g_free (css);
+	g_unlink (path);
+	g_free (path);
+}
+
+/* Number of image lookups, drawings served from the render cache don't
+ * look up their images. */
+static unsigned long
+n_fetches (void)
+{
+	ccss_cairo_image_cache_stats_t stats;
+
+	ccss_cairo_image_cache_get_stats (&stats);
+
+	return stats.hits + stats.misses;
+}
+
+static void
+test_render_cache (void)
+{
+	static char const _css[] =
+		"rendered { background-image: url(cache-red.png); }\n";
+	static char const _more_css[] =
+		"other { background-color: green; }\n";
+	ccss_stylesheet_t	*stylesheet;
+	ccss_style_t		*style;
+	cairo_surface_t		*surface;
+	unsigned long		 n;
+
+	stylesheet = create_stylesheet (_css);
+	ccss_cairo_image_cache_purge ();
+	ccss_cairo_render_cache_set_size (1024 * 1024);
+
+	/* Adding images changes the image generation, load it up front. */
+	g_assert_cmpuint (ccss_cairo_stylesheet_preload_images (stylesheet,
+								0), ==, 1);
+
+	style = ccss_stylesheet_query_type (stylesheet, "rendered");
+	g_assert (style);
+
+	n = n_fetches ();
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 1);
+	surface = draw_style (style, 16, 16);
+	g_assert_cmphex (*(uint32_t *) cairo_image_surface_get_data (surface),
+			 ==, RED);
+	cairo_surface_destroy (surface);
+	g_assert_cmpuint (n_fetches (), ==, n + 1);
+
+	/* Other sizes are rendered separately. */
+	cairo_surface_destroy (draw_style (style, 24, 24));
+	g_assert_cmpuint (n_fetches (), ==, n + 2);
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 2);
+
+	/* Loading CSS invalidates renderings of the stylesheet. */
+	ccss_stylesheet_add_from_buffer (stylesheet, _more_css,
+					 sizeof (_more_css) - 1,
+					 CCSS_STYLESHEET_AUTHOR, NULL);
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 3);
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 3);
+
+	/* So does evicting images. */
+	ccss_cairo_image_cache_trim (0);
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 4);
+
+	ccss_cairo_render_cache_clear ();
+	n = n_fetches ();
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 1);
+
+	/* Disabled, every draw looks up the image. */
+	ccss_cairo_render_cache_set_size (0);
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	cairo_surface_destroy (draw_style (style, 16, 16));
+	g_assert_cmpuint (n_fetches (), ==, n + 3);
+
+	ccss_style_destroy (style);
+	ccss_cairo_image_cache_purge ();
+	ccss_stylesheet_destroy (stylesheet);
+}
+
+#ifdef CCSS_WITH_RSVG
+
+static void
+test_svg_quantize (void)
+{
+	static char const _css[] =
+		"small { background-image: url(cache-square.svg); "
+			"background-size: 100px 100px; }\n"
+		"medium { background-image: url(cache-square.svg); "
+			"background-size: 105px 105px; }\n"
+		"large { background-image: url(cache-square.svg); "
+			"background-size: 120px 120px; }\n";
+	ccss_stylesheet_t		*stylesheet;
+	ccss_cairo_image_cache_stats_t	 stats;
+
+	stylesheet = create_stylesheet (_css);
+	ccss_cairo_image_cache_purge ();
+
+	/* The image at its own size, and rasterized at 112 pixels. */
+	draw (stylesheet, "small", 128, 128);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.n_images, ==, 2);
+
+	/* Rounded up to the same raster size. */
+	draw (stylesheet, "medium", 128, 128);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.n_images, ==, 2);
+
+	/* The next step is 128 pixels. */
+	draw (stylesheet, "large", 128, 128);
+	ccss_cairo_image_cache_get_stats (&stats);
+	g_assert_cmpuint (stats.n_images, ==, 3);
+
+	ccss_cairo_image_cache_purge ();
+	ccss_stylesheet_destroy (stylesheet);
+}
+
+#endif /* CCSS_WITH_RSVG */
+
+int
+main (int	  argc,
+      char	**argv)
+{
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (g_getenv ("srcdir"))
+		_srcdir = g_getenv ("srcdir");
+
+	g_test_add_func ("/ccss-cairo-cache/image-lru", test_image_lru);
+	g_test_add_func ("/ccss-cairo-cache/image-pinned", test_image_pinned);
+	g_test_add_func ("/ccss-cairo-cache/image-purge-failed",
+			 test_image_purge_failed);
+	g_test_add_func ("/ccss-cairo-cache/border-image-tiles",
+			 test_border_image_tiles);
+	g_test_add_func ("/ccss-cairo-cache/render-cache", test_render_cache);
+#ifdef CCSS_WITH_RSVG
+	g_test_add_func ("/ccss-cairo-cache/svg-quantize", test_svg_quantize);
+#endif
+
+	return g_test_run ();
+}
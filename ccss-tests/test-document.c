@@ -0,0 +1,191 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "test-document.h"
+
+nodeinfo_t const _document[N_DOCUMENT_NODES] = {
+	{ "window",	"main",	{ NULL },	NULL,			-1 },
+	{ "box",	NULL,	{ "a", NULL },	NULL,			 0 },
+	{ "label",	NULL,	{ NULL },	"weight: bold",		 1 },
+	{ "box",	NULL,	{ NULL },	NULL,			 0 },
+	{ "label",	"name",	{ "a", NULL },	NULL,			 3 },
+	{ "window",	NULL,	{ NULL },	NULL,			-1 },
+	{ "box",	NULL,	{ "b", NULL },	"fill: green",		 5 },
+	{ "label",	NULL,	{ NULL },	NULL,			 6 },
+	{ "label",	NULL,	{ NULL },	"weight: bold",		 6 },
+	{ "frame",	NULL,	{ NULL },	NULL,			-1 },
+	{ "box",	NULL,	{ NULL },	NULL,			 9 },
+	{ "box",	NULL,	{ NULL },	NULL,			10 },
+	{ "label",	NULL,	{ NULL },	NULL,			11 },
+	{ "box",	NULL,	{ "a", "b", NULL }, NULL,		 9 },
+	{ "label",	NULL,	{ NULL },	NULL,			13,
+	  { "accel", "ctrl" } },
+	{ "label",	NULL,	{ NULL },	NULL,			13,
+	  { "accel", "alt" } }
+};
+
+static char const *_properties[] = {
+	"fill", "stroke", "text", "font", "id-set", "weight"
+};
+
+char const _css[] =
+	"window		{ font: sans; }\n"
+	"frame		{ font: serif; }\n"
+	"box		{ fill: none; }\n"
+	"box.a		{ fill: red; }\n"
+	"window > box	{ stroke: blue; }\n"
+	"#main box label	{ text: nested; }\n"
+	"#name		{ id-set: yes; }\n"
+	"label		{ font: inherit; }\n"
+	".b label	{ stroke: inherit; }\n"
+	"label:hover	{ stroke: red; }\n";
+
+int volatile _n_get_container = 0;
+
+int volatile _n_get_style = 0;
+
+int _hover = -1;
+
+ccss_node_t *
+create_node (int index)
+{
+	return ccss_node_create (&_node_class,
+				 CCSS_NODE_CLASS_N_METHODS (_node_class),
+				 (void *) &_document[index]);
+}
+
+static ccss_node_t *
+get_container (ccss_node_t const *self)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	g_atomic_int_inc (&_n_get_container);
+
+	return info->container < 0 ? NULL : create_node (info->container);
+}
+
+static ptrdiff_t
+get_instance (ccss_node_t const *self)
+{
+	/* Document nodes are unique. */
+	return (ptrdiff_t) ccss_node_get_user_data (self);
+}
+
+static char const *
+get_id (ccss_node_t const *self)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return info->id;
+}
+
+static char const *
+get_type (ccss_node_t const *self)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return info->type_name;
+}
+
+static char const **
+get_classes (ccss_node_t const *self)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return info->classes[0] ? (char const **) info->classes : NULL;
+}
+
+static char const **
+get_pseudo_classes (ccss_node_t const *self)
+{
+	static char const *hover[] = { "hover", NULL };
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return _hover >= 0 && info == &_document[_hover] ?
+		(char const **) hover : NULL;
+}
+
+static char *
+get_attribute (ccss_node_t const	*self,
+	       char const		*name)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return info->attribute[0] && 0 == strcmp (name, info->attribute[0]) ?
+		g_strdup (info->attribute[1]) : NULL;
+}
+
+static char const *
+get_style (ccss_node_t const	*self,
+	   unsigned int		 descriptor)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	g_atomic_int_inc (&_n_get_style);
+
+	return info->inline_css;
+}
+
+static void
+release (ccss_node_t *self)
+{
+	ccss_node_destroy (self);
+}
+
+ccss_node_class_t _node_class = {
+	.is_a			= NULL,
+	.get_container		= get_container,
+	.get_base_style		= NULL,
+	.get_instance		= get_instance,
+	.get_id			= get_id,
+	.get_type		= get_type,
+	.get_classes		= get_classes,
+	.get_pseudo_classes	= get_pseudo_classes,
+	.get_attribute		= get_attribute,
+	.get_style		= get_style,
+	.get_viewport		= NULL,
+	.release		= release
+};
+
+/*
+ * Flatten the interesting properties of a style into a string.
+ */
+char *
+fingerprint (ccss_style_t const *style)
+{
+	GString	*str;
+	char	*value;
+
+	str = g_string_new (NULL);
+	for (unsigned int i = 0; style && i < G_N_ELEMENTS (_properties); i++) {
+		value = NULL;
+		if (ccss_style_get_string (style, _properties[i], &value)) {
+			g_string_append_printf (str, "%s=%s;",
+						_properties[i], value);
+			g_free (value);
+		}
+	}
+
+	return g_string_free (str, false);
+}
+
+char *
+query_fingerprint (ccss_stylesheet_t	*stylesheet,
+		   int			 index)
+{
+	ccss_node_t	*node;
+	ccss_style_t	*style;
+	char		*result;
+
+	node = create_node (index);
+	style = ccss_stylesheet_query (stylesheet, node);
+	result = fingerprint (style);
+	if (style) {
+		ccss_style_destroy (style);
+	}
+	ccss_node_destroy (node);
+
+	return result;
+}
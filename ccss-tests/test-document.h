@@ -0,0 +1,51 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/*
+ * A small static document and stylesheet shared by the query tests.
+ */
+
+#ifndef TEST_DOCUMENT_H
+#define TEST_DOCUMENT_H
+
+#include <ccss/ccss.h>
+
+/*
+ * Nodes refer to their container by index.
+ */
+typedef struct {
+	char const	*type_name;
+	char const	*id;
+	char const	*classes[3];
+	char const	*inline_css;
+	int		 container;
+	char const	*attribute[2];	/* Name and value, or NULL. */
+} nodeinfo_t;
+
+#define N_DOCUMENT_NODES 16
+
+extern nodeinfo_t const _document[N_DOCUMENT_NODES];
+
+extern char const _css[];
+
+extern ccss_node_class_t _node_class;
+
+/* Number of calls to the get_container hook. */
+extern int volatile _n_get_container;
+
+/* Number of calls to the get_style hook. */
+extern int volatile _n_get_style;
+
+/* Index of the node in hover state, -1 for none. */
+extern int _hover;
+
+ccss_node_t *
+create_node		(int			 index);
+
+char *
+fingerprint		(ccss_style_t const	*style);
+
+char *
+query_fingerprint	(ccss_stylesheet_t	*stylesheet,
+			 int			 index);
+
+#endif /* TEST_DOCUMENT_H */
@@ -143,6 +143,146 @@ test_generic_property (void)
 
 }
 
+static void
+test_style_hash (void)
+{
+	static char const	 _css[] =
+		"foo, bar { a: 1; b: 2; }\n"
+		"baz { a: 1; b: 2; }\n"
+		"bar { c: 3; }\n";
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_style_t		*foo, *foo_again, *bar, *baz;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, sizeof (_css) - 1,
+							NULL);
+	g_assert (stylesheet);
+
+	foo = ccss_stylesheet_query_type (stylesheet, "foo");
+	foo_again = ccss_stylesheet_query_type (stylesheet, "foo");
+	bar = ccss_stylesheet_query_type (stylesheet, "bar");
+	baz = ccss_stylesheet_query_type (stylesheet, "baz");
+	g_assert (foo && foo_again && bar && baz);
+
+	/* Same property instances. */
+	g_assert (ccss_style_equal (foo, foo_again));
+	g_assert (ccss_style_hash64 (foo) == ccss_style_hash64 (foo_again));
+	g_assert_cmpuint (ccss_style_hash (foo), ==, ccss_style_hash (foo_again));
+	g_assert_cmpuint (ccss_style_hash (foo), !=, 0);
+
+	/* Additional property. */
+	g_assert (!ccss_style_equal (foo, bar));
+	g_assert (ccss_style_hash64 (foo) != ccss_style_hash64 (bar));
+
+	/* Equal values, but different declarations. */
+	g_assert (!ccss_style_equal (foo, baz));
+
+	ccss_style_destroy (baz);
+	ccss_style_destroy (bar);
+	ccss_style_destroy (foo_again);
+	ccss_style_destroy (foo);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+count_property (ccss_style_t const	*self,
+		char const		*property_name,
+		unsigned int		*n_properties)
+{
+	(*n_properties)++;
+}
+
+static void
+test_style_properties (void)
+{
+	static char const	 _css[] =
+		"foo { a: 1; b: 2; a: 3; }\n"
+		"foo { never-used-elsewhere: 4; }\n";
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_style_t		*foo, *foo_again;
+	ccss_property_t const	*b;
+	char			*value;
+	unsigned int		 n_properties;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, sizeof (_css) - 1,
+							NULL);
+	g_assert (stylesheet);
+
+	foo = ccss_stylesheet_query_type (stylesheet, "foo");
+	foo_again = ccss_stylesheet_query_type (stylesheet, "foo");
+	g_assert (foo && foo_again);
+
+	/* Later declarations in a block win. */
+	g_assert (ccss_style_get_string (foo, "a", &value));
+	g_assert_cmpstr (value, ==, "3");
+	g_free (value);
+
+	g_assert (ccss_style_get_string (foo, "never-used-elsewhere", &value));
+	g_assert_cmpstr (value, ==, "4");
+	g_free (value);
+
+	g_assert (!ccss_style_get_property (foo, "c", &b));
+
+	n_properties = 0;
+	ccss_style_foreach (foo, (ccss_style_iterator_f) count_property,
+			    &n_properties);
+	g_assert_cmpuint (n_properties, ==, 3);
+
+	/* Set and unset a property. */
+	g_assert (ccss_style_get_property (foo, "b", &b));
+	ccss_style_set_property (foo, "c", b);
+	g_assert (!ccss_style_equal (foo, foo_again));
+	ccss_style_unset_property (foo, "c");
+	g_assert (!ccss_style_get_property (foo, "c", &b));
+	g_assert (ccss_style_equal (foo, foo_again));
+	g_assert (ccss_style_hash64 (foo) == ccss_style_hash64 (foo_again));
+
+	ccss_style_destroy (foo_again);
+	ccss_style_destroy (foo);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_unload (void)
+{
+	static char const	 _css[] = "foo { a: 1; }\n";
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_style_t		*foo;
+	unsigned int		 descriptor;
+	char			*value;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet (grammar);
+	descriptor = ccss_stylesheet_add_from_buffer (stylesheet,
+						      _css, sizeof (_css) - 1,
+						      CCSS_STYLESHEET_AUTHOR,
+						      NULL);
+	g_assert_cmpuint (descriptor, !=, 0);
+
+	foo = ccss_stylesheet_query_type (stylesheet, "foo");
+	g_assert (foo);
+
+	g_assert (ccss_stylesheet_unload (stylesheet, descriptor));
+	g_assert (NULL == ccss_stylesheet_query_type (stylesheet, "foo"));
+
+	/* Styles keep the properties of unloaded CSS alive. */
+	g_assert (ccss_style_get_string (foo, "a", &value));
+	g_assert_cmpstr (value, ==, "1");
+	g_free (value);
+
+	ccss_style_destroy (foo);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
 int
 main (int	  argc,
       char	**argv)
@@ -151,6 +291,9 @@ main (int	  argc,
 
 	g_test_add_func ("/ccss-parser/color", test_color);
 	g_test_add_func ("/ccss-parser/generic-property", test_generic_property);
+	g_test_add_func ("/ccss-parser/style-hash", test_style_hash);
+	g_test_add_func ("/ccss-parser/style-properties", test_style_properties);
+	g_test_add_func ("/ccss-parser/unload", test_unload);
 
 	return g_test_run ();
 }
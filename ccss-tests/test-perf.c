@@ -0,0 +1,509 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/*
+ * Micro-benchmarks, run with `make perf-report' or `test-perf -m=perf'.
+ * Without `-m=perf' only the smallest configurations are run, as smoke test.
+ * Allocations are counted through the GLib allocator, so memory allocated
+ * by cairo itself isn't accounted for. GSlice is switched to plain
+ * g_malloc(), otherwise list and hash table nodes would go uncounted.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ccss/ccss.h>
+#include <glib.h>
+#include <glib/gprintf.h>
+#include "config.h"
+#ifdef CCSS_WITH_CAIRO
+  #include <ccss-cairo/ccss-cairo.h>
+#endif
+
+static unsigned long _n_allocs = 0;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+	_n_allocs++;
+	return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer	mem,
+		  gsize		n_bytes)
+{
+	if (NULL == mem)
+		_n_allocs++;
+	return realloc (mem, n_bytes);
+}
+
+static GMemVTable _counting_vtable = {
+	.malloc		= counting_malloc,
+	.realloc	= counting_realloc,
+	.free		= free,
+	.calloc		= NULL,
+	.try_malloc	= NULL,
+	.try_realloc	= NULL
+};
+
+/*
+ * Measure `n_ops' operations, see bench_start().
+ */
+typedef struct {
+	char const	*name;
+	unsigned int	 n_ops;
+	unsigned long	 n_allocs;
+} bench_t;
+
+static void
+bench_start (bench_t		*bench,
+	     char const		*name,
+	     unsigned int	 n_ops)
+{
+	bench->name = name;
+	bench->n_ops = n_ops;
+	bench->n_allocs = _n_allocs;
+	g_test_timer_start ();
+}
+
+static void
+bench_stop (bench_t const *bench)
+{
+	double		elapsed;
+	double		ns_per_op;
+	double		allocs_per_op;
+
+	elapsed = g_test_timer_elapsed ();
+	ns_per_op = elapsed * 1e9 / bench->n_ops;
+	allocs_per_op = (double) (_n_allocs - bench->n_allocs) / bench->n_ops;
+
+	g_test_minimized_result (ns_per_op, "%s: %.0f ns/op, %.1f allocs/op",
+				 bench->name, ns_per_op, allocs_per_op);
+	if (g_test_verbose ())
+		g_printf ("%-40s %12.0f ns/op %10.1f allocs/op\n",
+			  bench->name, ns_per_op, allocs_per_op);
+}
+
+/*
+ * Synthetic documents.
+ */
+
+#define N_TYPES		16
+#define N_CLASSES	32
+#define N_IDS		64
+
+typedef struct node_ node_t;
+struct node_ {
+	node_t const	*container;
+	char		*type_name;
+	char		*id;
+	char		*classes[3];
+};
+
+static char const *
+get_type (ccss_node_t const *self)
+{
+	node_t const *node = ccss_node_get_user_data (self);
+
+	return node->type_name;
+}
+
+static char const *
+get_id (ccss_node_t const *self)
+{
+	node_t const *node = ccss_node_get_user_data (self);
+
+	return node->id;
+}
+
+static char const **
+get_classes (ccss_node_t const *self)
+{
+	node_t const *node = ccss_node_get_user_data (self);
+
+	return node->classes[0] ? (char const **) node->classes : NULL;
+}
+
+static ptrdiff_t
+get_instance (ccss_node_t const *self)
+{
+	return (ptrdiff_t) ccss_node_get_user_data (self);
+}
+
+static ccss_node_t *
+get_container (ccss_node_t const *self);
+
+static void
+release (ccss_node_t *self)
+{
+	ccss_node_destroy (self);
+}
+
+static ccss_node_class_t _node_class = {
+	.is_a			= NULL,
+	.get_container		= get_container,
+	.get_base_style		= NULL,
+	.get_instance		= get_instance,
+	.get_id			= get_id,
+	.get_type		= get_type,
+	.get_classes		= get_classes,
+	.get_pseudo_classes	= NULL,
+	.get_attribute		= NULL,
+	.get_style		= NULL,
+	.get_viewport		= NULL,
+	.release		= release
+};
+
+static ccss_node_t *
+create_node (node_t const *node)
+{
+	return ccss_node_create (&_node_class,
+				 CCSS_NODE_CLASS_N_METHODS (_node_class),
+				 (void *) node);
+}
+
+static ccss_node_t *
+get_container (ccss_node_t const *self)
+{
+	node_t const *node = ccss_node_get_user_data (self);
+
+	return node->container ? create_node (node->container) : NULL;
+}
+
+/*
+ * Create a tree of `n_nodes' nodes, each node's container is picked at
+ * random among the preceding nodes, but no deeper than `max_depth'.
+ */
+static node_t *
+create_tree (GRand		*rand,
+	     unsigned int	 n_nodes,
+	     unsigned int	 max_depth)
+{
+	node_t		*nodes;
+	unsigned int	*depths;
+	unsigned int	 container;
+	unsigned int	 n_classes;
+
+	nodes = g_new0 (node_t, n_nodes);
+	depths = g_new0 (unsigned int, n_nodes);
+
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		if (i > 0) {
+			do {
+				container = g_rand_int_range (rand, 0, i);
+			} while (depths[container] >= max_depth);
+			nodes[i].container = &nodes[container];
+			depths[i] = depths[container] + 1;
+		}
+		nodes[i].type_name = g_strdup_printf ("type%d",
+				g_rand_int_range (rand, 0, N_TYPES));
+		if (0 == g_rand_int_range (rand, 0, 8)) {
+			nodes[i].id = g_strdup_printf ("id%d",
+					g_rand_int_range (rand, 0, N_IDS));
+		}
+		n_classes = g_rand_int_range (rand, 0, 3);
+		for (unsigned int j = 0; j < n_classes; j++) {
+			nodes[i].classes[j] = g_strdup_printf ("class%d",
+					g_rand_int_range (rand, 0, N_CLASSES));
+		}
+	}
+
+	g_free (depths);
+
+	return nodes;
+}
+
+static void
+free_tree (node_t	*nodes,
+	   unsigned int	 n_nodes)
+{
+	for (unsigned int i = 0; i < n_nodes; i++) {
+		g_free (nodes[i].type_name);
+		g_free (nodes[i].id);
+		for (unsigned int j = 0; nodes[i].classes[j]; j++) {
+			g_free (nodes[i].classes[j]);
+		}
+	}
+	g_free (nodes);
+}
+
+/*
+ * Synthetic stylesheets, mixing the common selector shapes.
+ */
+static char *
+create_css (GRand	*rand,
+	    unsigned int n_rules)
+{
+	GString *css;
+
+	css = g_string_new (NULL);
+	for (unsigned int i = 0; i < n_rules; i++) {
+		switch (i % 8) {
+		case 0:
+			g_string_append_printf (css, "type%d",
+				g_rand_int_range (rand, 0, N_TYPES));
+			break;
+		case 1:
+			g_string_append_printf (css, ".class%d",
+				g_rand_int_range (rand, 0, N_CLASSES));
+			break;
+		case 2:
+			g_string_append_printf (css, "#id%d",
+				g_rand_int_range (rand, 0, N_IDS));
+			break;
+		case 3:
+			g_string_append_printf (css, "type%d.class%d",
+				g_rand_int_range (rand, 0, N_TYPES),
+				g_rand_int_range (rand, 0, N_CLASSES));
+			break;
+		case 4:
+			g_string_append_printf (css, "type%d type%d",
+				g_rand_int_range (rand, 0, N_TYPES),
+				g_rand_int_range (rand, 0, N_TYPES));
+			break;
+		case 5:
+			g_string_append_printf (css, ".class%d > type%d",
+				g_rand_int_range (rand, 0, N_CLASSES),
+				g_rand_int_range (rand, 0, N_TYPES));
+			break;
+		case 6:
+			g_string_append_printf (css, "#id%d .class%d type%d",
+				g_rand_int_range (rand, 0, N_IDS),
+				g_rand_int_range (rand, 0, N_CLASSES),
+				g_rand_int_range (rand, 0, N_TYPES));
+			break;
+		case 7:
+			g_string_append_printf (css, "type%d:hover",
+				g_rand_int_range (rand, 0, N_TYPES));
+			break;
+		}
+		g_string_append_printf (css,
+			" { color: #%06x; background-color: #%06x; "
+			"border: %dpx solid black; }\n",
+			g_rand_int_range (rand, 0, 0xffffff),
+			g_rand_int_range (rand, 0, 0xffffff),
+			g_rand_int_range (rand, 0, 4));
+	}
+
+	return g_string_free (css, false);
+}
+
+static unsigned int const _n_rules[] = { 100, 1000, 10000, 30000 };
+
+static unsigned int
+n_configurations (unsigned int n)
+{
+	return g_test_perf () ? n : 1;
+}
+
+static void
+test_parse (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	GRand			*rand;
+	char			*css;
+	char			*name;
+	bench_t			 bench;
+
+	grammar = ccss_grammar_create_css ();
+	rand = g_rand_new_with_seed (0);
+
+	for (unsigned int i = 0; i < n_configurations (G_N_ELEMENTS (_n_rules)); i++) {
+
+		css = create_css (rand, _n_rules[i]);
+		name = g_strdup_printf ("parse %u rules, per rule", _n_rules[i]);
+
+		bench_start (&bench, name, _n_rules[i]);
+		stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							css, strlen (css), NULL);
+		bench_stop (&bench);
+
+		g_assert (stylesheet);
+		ccss_stylesheet_destroy (stylesheet);
+		g_free (name);
+		g_free (css);
+	}
+
+	g_rand_free (rand);
+	ccss_grammar_destroy (grammar);
+}
+
+#define N_NODES 2000
+
+static void
+test_query (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_t		*node;
+	ccss_style_t		*style;
+	node_t			*nodes;
+	GRand			*rand;
+	char			*css;
+	char			*name;
+	bench_t			 bench;
+
+	grammar = ccss_grammar_create_css ();
+	rand = g_rand_new_with_seed (0);
+	nodes = create_tree (rand, N_NODES, 12);
+
+	for (unsigned int i = 0; i < n_configurations (G_N_ELEMENTS (_n_rules)); i++) {
+
+		css = create_css (rand, _n_rules[i]);
+		stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							css, strlen (css), NULL);
+		g_assert (stylesheet);
+
+		name = g_strdup_printf ("query %u rules, per node", _n_rules[i]);
+		bench_start (&bench, name, N_NODES);
+		for (unsigned int j = 0; j < N_NODES; j++) {
+			node = create_node (&nodes[j]);
+			style = ccss_stylesheet_query (stylesheet, node);
+			if (style)
+				ccss_style_destroy (style);
+			ccss_node_destroy (node);
+		}
+		bench_stop (&bench);
+		g_free (name);
+
+		ccss_stylesheet_destroy (stylesheet);
+		g_free (css);
+	}
+
+	free_tree (nodes, N_NODES);
+	g_rand_free (rand);
+	ccss_grammar_destroy (grammar);
+}
+
+static unsigned int const _depths[] = { 1, 4, 16, 64 };
+
+#define N_INHERIT_QUERIES 1000
+
+static void
+test_inherit (void)
+{
+	static char const _css[] =
+		"type0 { color: red; background-color: blue; }\n"
+		"type1 { color: inherit; background-color: inherit; }\n";
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_t		*node;
+	ccss_style_t		*style;
+	node_t			*chain;
+	char			*name;
+	unsigned int		 depth;
+	bench_t			 bench;
+
+	grammar = ccss_grammar_create_css ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+					_css, sizeof (_css) - 1, NULL);
+	g_assert (stylesheet);
+
+	for (unsigned int i = 0; i < n_configurations (G_N_ELEMENTS (_depths)); i++) {
+
+		/* Only the root has a value to inherit. */
+		depth = _depths[i];
+		chain = g_new0 (node_t, depth + 1);
+		chain[0].type_name = g_strdup ("type0");
+		for (unsigned int j = 1; j <= depth; j++) {
+			chain[j].container = &chain[j - 1];
+			chain[j].type_name = g_strdup ("type2");
+		}
+		chain[depth].type_name[4] = '1';
+
+		name = g_strdup_printf ("inherit from depth %u, per query",
+					depth);
+		bench_start (&bench, name, N_INHERIT_QUERIES);
+		for (unsigned int j = 0; j < N_INHERIT_QUERIES; j++) {
+			node = create_node (&chain[depth]);
+			style = ccss_stylesheet_query (stylesheet, node);
+			g_assert (style);
+			ccss_style_destroy (style);
+			ccss_node_destroy (node);
+		}
+		bench_stop (&bench);
+		g_free (name);
+
+		free_tree (chain, depth + 1);
+	}
+
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+#ifdef CCSS_WITH_CAIRO
+
+#define N_DRAWS 2000
+
+static void
+test_draw_rectangle (void)
+{
+	static char const _css[] =
+		"plain { background-color: grey; }\n"
+		"border { background-color: grey; border: 2px solid black; }\n"
+		"rounded { background-color: grey; border: 2px solid black; "
+			  "border-radius: 6px; }\n"
+		"dotted { border: 1px dotted red; border-radius: 3px; }\n";
+	static char const *_types[] = { "plain", "border", "rounded", "dotted" };
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_style_t		*style;
+	cairo_surface_t		*surface;
+	cairo_t			*cr;
+	char			*name;
+	bench_t			 bench;
+
+	grammar = ccss_cairo_grammar_create ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+					_css, sizeof (_css) - 1, NULL);
+	g_assert (stylesheet);
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 256, 256);
+	cr = cairo_create (surface);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS (_types); i++) {
+
+		style = ccss_stylesheet_query_type (stylesheet, _types[i]);
+		g_assert (style);
+
+		name = g_strdup_printf ("draw rectangle `%s', per draw",
+					_types[i]);
+		bench_start (&bench, name, N_DRAWS);
+		for (unsigned int j = 0; j < N_DRAWS; j++) {
+			ccss_cairo_style_draw_rectangle (style, cr,
+							 8, 8, 240, 240);
+		}
+		bench_stop (&bench);
+		g_free (name);
+
+		ccss_style_destroy (style);
+	}
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+#endif /* CCSS_WITH_CAIRO */
+
+int
+main (int	  argc,
+      char	**argv)
+{
+	/* Must happen before anything is allocated through GLib. */
+	g_setenv ("G_SLICE", "always-malloc", true);
+	g_mem_set_vtable (&_counting_vtable);
+
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/ccss-perf/parse", test_parse);
+	g_test_add_func ("/ccss-perf/query", test_query);
+	g_test_add_func ("/ccss-perf/inherit", test_inherit);
+#ifdef CCSS_WITH_CAIRO
+	g_test_add_func ("/ccss-perf/draw-rectangle", test_draw_rectangle);
+#endif
+
+	return g_test_run ();
+}
+
@@ -0,0 +1,782 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/*
+ * Single threaded queries: inline styles, the container chain of a query,
+ * restyling nodes that are kept between queries, and styling whole trees.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ccss/ccss.h>
+#include <glib.h>
+#include "test-document.h"
+
+static void
+test_inline_shared (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_t		*node;
+	ccss_style_t		*styles[2];
+	ccss_property_t const	*properties[2];
+	int			 indices[2] = { 2, 8 };
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	/* Different nodes with the same inline CSS share its properties. */
+	for (unsigned int i = 0; i < G_N_ELEMENTS (indices); i++) {
+		node = create_node (indices[i]);
+		styles[i] = ccss_stylesheet_query (stylesheet, node);
+		ccss_node_destroy (node);
+		g_assert (styles[i]);
+		properties[i] = NULL;
+		g_assert (ccss_style_get_property (styles[i], "weight",
+						   &properties[i]));
+	}
+	g_assert (properties[0] == properties[1]);
+
+	ccss_style_destroy (styles[0]);
+	ccss_style_destroy (styles[1]);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_container_chain (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	char			*result;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	/* Matching, inheritance and the ancestor filter share one chain of
+	 * containers, the label is two levels deep. */
+	_n_get_container = 0;
+	result = query_fingerprint (stylesheet, 2);
+	g_assert_cmpstr (result, ==, "text=nested;font=sans;weight=bold;");
+	g_assert_cmpint (_n_get_container, <=, 3);
+	g_free (result);
+
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_kept_node (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_t		*node;
+	ccss_style_t		*style;
+	char			*results[2];
+	char			*expected;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	/* Facts are fetched from the node class again for every query, so
+	 * a kept node picks up its new state. */
+	node = create_node (4);
+	for (unsigned int i = 0; i < G_N_ELEMENTS (results); i++) {
+		_hover = 0 == i ? -1 : 4;
+		style = ccss_stylesheet_query (stylesheet, node);
+		results[i] = fingerprint (style);
+		ccss_style_destroy (style);
+		expected = query_fingerprint (stylesheet, 4);
+		g_assert_cmpstr (results[i], ==, expected);
+		g_free (expected);
+	}
+	_hover = -1;
+	g_assert (NULL == strstr (results[0], "stroke=red;"));
+	g_assert (strstr (results[1], "stroke=red;"));
+
+	g_free (results[0]);
+	g_free (results[1]);
+	ccss_node_destroy (node);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+/* Inline CSS of the node created by test_kept_node_inline(). */
+static char *_inline_css = NULL;
+
+static char const *
+get_changing_style (ccss_node_t const	*self,
+		    unsigned int	 descriptor)
+{
+	return _inline_css;
+}
+
+static void
+test_kept_node_inline (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_class_t	 node_class;
+	ccss_node_t		*node;
+	ccss_style_t		*style;
+	char			*result;
+	char const		*inline_css[] = {
+		"weight: bold", "weight: normal", NULL
+	};
+	char const		*expected[] = {
+		"text=nested;font=sans;id-set=yes;weight=bold;",
+		"text=nested;font=sans;id-set=yes;weight=normal;",
+		"text=nested;font=sans;id-set=yes;"
+	};
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	/* The hook's string is only valid during a query, it's freed and
+	 * changed in between. */
+	node_class = _node_class;
+	node_class.get_style = get_changing_style;
+	node = ccss_node_create (&node_class,
+				 CCSS_NODE_CLASS_N_METHODS (node_class),
+				 (void *) &_document[4]);
+	for (unsigned int i = 0; i < G_N_ELEMENTS (inline_css); i++) {
+		_inline_css = g_strdup (inline_css[i]);
+		style = ccss_stylesheet_query (stylesheet, node);
+		g_free (_inline_css), _inline_css = NULL;
+		result = fingerprint (style);
+		g_assert_cmpstr (result, ==, expected[i]);
+		ccss_style_destroy (style);
+		g_free (result);
+	}
+
+	ccss_node_destroy (node);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+/*
+ * Query the node with `inline_css' and return the instance of its weight
+ * property, which is shared while the inline style is cached.
+ */
+static ccss_property_t const *
+query_inline_weight (ccss_stylesheet_t	*stylesheet,
+		     ccss_node_t	*node,
+		     char const		*inline_css)
+{
+	ccss_style_t		*style;
+	ccss_property_t const	*property;
+
+	_inline_css = g_strdup (inline_css);
+	style = ccss_stylesheet_query (stylesheet, node);
+	g_free (_inline_css), _inline_css = NULL;
+	g_assert (style);
+
+	property = NULL;
+	g_assert (ccss_style_get_property (style, "weight", &property));
+	ccss_style_destroy (style);
+
+	return property;
+}
+
+static void
+test_inline_cache (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_class_t	 node_class;
+	ccss_node_t		*node;
+	ccss_style_t		*style;
+	ccss_property_t const	*property;
+	char			*inline_css;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	node_class = _node_class;
+	node_class.get_style = get_changing_style;
+	node = ccss_node_create (&node_class,
+				 CCSS_NODE_CLASS_N_METHODS (node_class),
+				 (void *) &_document[4]);
+
+	/* Keep a style, so its properties can't be reused by a new parse. */
+	_inline_css = g_strdup ("weight: bold");
+	style = ccss_stylesheet_query (stylesheet, node);
+	g_free (_inline_css), _inline_css = NULL;
+	property = NULL;
+	g_assert (ccss_style_get_property (style, "weight", &property));
+
+	/* Many more distinct inline styles than the cache holds, a recently
+	 * used one must survive them. */
+	for (unsigned int i = 0; i < 1000; i++) {
+		inline_css = g_strdup_printf ("weight: w%u", i);
+		query_inline_weight (stylesheet, node, inline_css);
+		g_free (inline_css);
+		if (i % 100 == 0) {
+			g_assert (property == query_inline_weight (stylesheet,
+						node, "weight: bold"));
+		}
+	}
+	g_assert (property == query_inline_weight (stylesheet, node,
+						   "weight: bold"));
+
+	ccss_style_destroy (style);
+	ccss_node_destroy (node);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_restyle (void)
+{
+	ccss_grammar_t		 *grammar;
+	ccss_stylesheet_t	 *stylesheet;
+	ccss_node_t		 *node;
+	ccss_style_t		 *styles[3];
+	char			 *results[3];
+	char			 *expected;
+	char const		 *changed[] = { "hover", NULL };
+	char const		**pseudo_classes;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	pseudo_classes = ccss_stylesheet_get_pseudo_classes (stylesheet,
+							     "label");
+	g_assert (pseudo_classes);
+	g_assert_cmpstr (pseudo_classes[0], ==, "hover");
+	g_assert (NULL == pseudo_classes[1]);
+	g_free (pseudo_classes);
+	g_assert (NULL == ccss_stylesheet_get_pseudo_classes (stylesheet,
+							      "window"));
+
+	/* Hover the label and back, the node is kept meanwhile. */
+	node = create_node (4);
+	styles[0] = ccss_stylesheet_query (stylesheet, node);
+	results[0] = fingerprint (styles[0]);
+
+	_hover = 4;
+	styles[1] = ccss_stylesheet_restyle (stylesheet, styles[0], node,
+					     changed);
+	results[1] = fingerprint (styles[1]);
+	expected = query_fingerprint (stylesheet, 4);
+	g_assert_cmpstr (results[1], ==, expected);
+	g_assert (strstr (results[1], "stroke=red;"));
+	g_free (expected);
+
+	_hover = -1;
+	styles[2] = ccss_stylesheet_restyle (stylesheet, styles[1], node,
+					     changed);
+	results[2] = fingerprint (styles[2]);
+	g_assert_cmpstr (results[2], ==, results[0]);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS (styles); i++) {
+		ccss_style_destroy (styles[i]);
+		g_free (results[i]);
+	}
+	ccss_node_destroy (node);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_query_states (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_t		*node;
+	ccss_style_t		*styles[3];
+	char			*results[3];
+	char			*expected[2];
+	char const		*states[] = { NULL, "hover", NULL };
+	bool			 ret;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	expected[0] = query_fingerprint (stylesheet, 4);
+	_hover = 4;
+	expected[1] = query_fingerprint (stylesheet, 4);
+	_hover = -1;
+
+	/* Normal, hovered and normal again, in one call. */
+	node = create_node (4);
+	ret = ccss_stylesheet_query_states (stylesheet, node, states,
+					    G_N_ELEMENTS (states), styles);
+	g_assert (ret);
+	for (unsigned int i = 0; i < G_N_ELEMENTS (styles); i++) {
+		results[i] = fingerprint (styles[i]);
+	}
+	g_assert_cmpstr (results[0], ==, expected[0]);
+	g_assert_cmpstr (results[1], ==, expected[1]);
+	g_assert_cmpstr (results[2], ==, expected[0]);
+
+	/* The override is gone, the node's own hook applies again. */
+	for (unsigned int i = 0; i < G_N_ELEMENTS (styles); i++) {
+		ccss_style_destroy (styles[i]);
+		g_free (results[i]);
+	}
+	_hover = 4;
+	styles[0] = ccss_stylesheet_query (stylesheet, node);
+	results[0] = fingerprint (styles[0]);
+	g_assert_cmpstr (results[0], ==, expected[1]);
+	ccss_style_destroy (styles[0]);
+	g_free (results[0]);
+	_hover = -1;
+
+	g_free (expected[0]);
+	g_free (expected[1]);
+	ccss_node_destroy (node);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+typedef struct {
+	char		*expected[N_DOCUMENT_NODES];
+	bool		 is_styled[N_DOCUMENT_NODES];
+	unsigned int	 n_failures;
+} tree_info_t;
+
+static ccss_node_t *
+get_child (ccss_node_t	*container,
+	   unsigned int	 n,
+	   void		*user_data)
+{
+	nodeinfo_t const	*info = ccss_node_get_user_data (container);
+	int			 index;
+
+	index = info - _document;
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		if (_document[i].container == index && 0 == n--)
+			return create_node (i);
+	}
+
+	return NULL;
+}
+
+static void
+check_style (ccss_stylesheet_t	*stylesheet,
+	     ccss_node_t	*node,
+	     ccss_style_t	*style,
+	     void		*user_data)
+{
+	tree_info_t		*tree_info = (tree_info_t *) user_data;
+	nodeinfo_t const	*info = ccss_node_get_user_data (node);
+	char			*result;
+	int			 index;
+
+	index = info - _document;
+	tree_info->is_styled[index] = true;
+
+	result = fingerprint (style);
+	if (strcmp (result, tree_info->expected[index]))
+		tree_info->n_failures++;
+	g_free (result);
+
+	if (style) {
+		ccss_style_destroy (style);
+	}
+}
+
+static void
+test_query_tree (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_node_t		*root;
+	tree_info_t		 tree_info;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		tree_info.expected[i] = query_fingerprint (stylesheet, i);
+		tree_info.is_styled[i] = false;
+	}
+	tree_info.n_failures = 0;
+
+	/* The deepest label inherits its font from three levels up. */
+	g_assert_cmpstr (tree_info.expected[12], ==, "font=serif;");
+
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		if (_document[i].container >= 0)
+			continue;
+		root = create_node (i);
+		ccss_stylesheet_query_tree (stylesheet, root, get_child,
+					    check_style, &tree_info);
+		ccss_node_destroy (root);
+	}
+
+	g_assert_cmpuint (tree_info.n_failures, ==, 0);
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		g_assert (tree_info.is_styled[i]);
+		g_free (tree_info.expected[i]);
+	}
+
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+/*
+ * Style `index' and its descendants, keeping `filter' up to date with their
+ * containers.
+ */
+static unsigned int
+walk_with_filter (ccss_stylesheet_t		 *stylesheet,
+		  ccss_ancestor_filter_t	 *filter,
+		  int				  index,
+		  char				**expected)
+{
+	ccss_node_t	*node;
+	ccss_style_t	*style;
+	char		*result;
+	unsigned int	 n_failures;
+
+	node = create_node (index);
+	style = ccss_stylesheet_query_with_ancestor_filter (stylesheet, node,
+							    filter);
+	result = fingerprint (style);
+	n_failures = strcmp (result, expected[index]) ? 1 : 0;
+	g_free (result);
+	if (style) {
+		ccss_style_destroy (style);
+	}
+
+	ccss_ancestor_filter_push (filter, node);
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		if (_document[i].container == index) {
+			n_failures += walk_with_filter (stylesheet, filter, i,
+							expected);
+		}
+	}
+	ccss_ancestor_filter_pop (filter);
+	ccss_node_destroy (node);
+
+	return n_failures;
+}
+
+static void
+test_ancestor_filter (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_ancestor_filter_t	*filter;
+	char			*expected[N_DOCUMENT_NODES];
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		expected[i] = query_fingerprint (stylesheet, i);
+	}
+
+	/* Popping a subtree must leave its siblings' containers in the
+	 * filter, e.g. `#main' for the second label of the first window.
+	 * The filter is reused for all trees, twice. */
+	filter = ccss_ancestor_filter_create ();
+	for (unsigned int n = 0; n < 2; n++) {
+		for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+			if (_document[i].container >= 0)
+				continue;
+			g_assert_cmpuint (walk_with_filter (stylesheet, filter,
+							    i, expected),
+					  ==, 0);
+		}
+	}
+	ccss_ancestor_filter_destroy (filter);
+
+	for (int i = 0; i < N_DOCUMENT_NODES; i++) {
+		g_free (expected[i]);
+	}
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_ancestor_filter_saturated (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_ancestor_filter_t	*filter;
+	ccss_node_t		*nodes[3];
+	ccss_style_t		*style;
+	char			*result;
+	char			*expected;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	expected = query_fingerprint (stylesheet, 2);
+	g_assert (strstr (expected, "text=nested;"));
+
+	/* Push the window often enough to saturate its counters, which
+	 * then must not drop to zero when popping. */
+	for (unsigned int i = 0; i < G_N_ELEMENTS (nodes); i++) {
+		nodes[i] = create_node (i);
+	}
+	filter = ccss_ancestor_filter_create ();
+	for (unsigned int i = 0; i < 300; i++) {
+		ccss_ancestor_filter_push (filter, nodes[0]);
+	}
+	for (unsigned int i = 0; i < 299; i++) {
+		ccss_ancestor_filter_pop (filter);
+	}
+	ccss_ancestor_filter_push (filter, nodes[1]);
+
+	style = ccss_stylesheet_query_with_ancestor_filter (stylesheet,
+							    nodes[2], filter);
+	result = fingerprint (style);
+	g_assert_cmpstr (result, ==, expected);
+	ccss_style_destroy (style);
+	g_free (result);
+
+	ccss_ancestor_filter_destroy (filter);
+	for (unsigned int i = 0; i < G_N_ELEMENTS (nodes); i++) {
+		ccss_node_destroy (nodes[i]);
+	}
+	g_free (expected);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+/*
+ * Nodes that implement `is_a', windows are widgets too.
+ */
+static ccss_node_class_t _is_a_node_class;
+
+static ccss_node_t *
+create_is_a_node (int index)
+{
+	return ccss_node_create (&_is_a_node_class,
+				 CCSS_NODE_CLASS_N_METHODS (_is_a_node_class),
+				 (void *) &_document[index]);
+}
+
+static bool
+is_a (ccss_node_t const	*self,
+      char const	*type_name)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return 0 == strcmp (type_name, info->type_name) ||
+	       (0 == strcmp (type_name, "widget") &&
+		0 == strcmp (info->type_name, "window"));
+}
+
+static ccss_node_t *
+get_is_a_container (ccss_node_t const *self)
+{
+	nodeinfo_t const *info = ccss_node_get_user_data (self);
+
+	return info->container < 0 ? NULL : create_is_a_node (info->container);
+}
+
+static void
+test_ancestor_filter_is_a (void)
+{
+	static char const css[] = "widget label { text: in-widget; }\n";
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	ccss_ancestor_filter_t	*filter;
+	ccss_node_t		*nodes[3];
+	ccss_style_t		*style;
+	char			*result;
+	int			 indices[] = { 0, 3, 4 };
+
+	_is_a_node_class = _node_class;
+	_is_a_node_class.is_a = is_a;
+	_is_a_node_class.get_container = get_is_a_container;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							css, strlen (css),
+							NULL);
+	g_assert (stylesheet);
+
+	/* Without `is_a' the window is no widget. */
+	result = query_fingerprint (stylesheet, 4);
+	g_assert_cmpstr (result, ==, "");
+	g_free (result);
+
+	/* The filter can't know which types a node with `is_a' is, so the
+	 * rule must not be rejected through the window's type. */
+	for (unsigned int i = 0; i < G_N_ELEMENTS (nodes); i++) {
+		nodes[i] = create_is_a_node (indices[i]);
+	}
+	filter = ccss_ancestor_filter_create ();
+	ccss_ancestor_filter_push (filter, nodes[0]);
+	ccss_ancestor_filter_push (filter, nodes[1]);
+
+	style = ccss_stylesheet_query_with_ancestor_filter (stylesheet,
+							    nodes[2], filter);
+	result = fingerprint (style);
+	g_assert_cmpstr (result, ==, "text=in-widget;");
+	ccss_style_destroy (style);
+	g_free (result);
+
+	/* Same with the filter built by the query. */
+	style = ccss_stylesheet_query (stylesheet, nodes[2]);
+	result = fingerprint (style);
+	g_assert_cmpstr (result, ==, "text=in-widget;");
+	ccss_style_destroy (style);
+	g_free (result);
+
+	ccss_ancestor_filter_destroy (filter);
+	for (unsigned int i = 0; i < G_N_ELEMENTS (nodes); i++) {
+		ccss_node_destroy (nodes[i]);
+	}
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_styling_pass (void)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	char			*expected[2];
+	char			*results[2];
+	int			 indices[2] = { 7, 8 };
+	int			 n_calls[2];
+	int			 n;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS (indices); i++) {
+		expected[i] = query_fingerprint (stylesheet, indices[i]);
+	}
+
+	/* Both labels inherit from the same box and window. Querying a
+	 * container's style asks it for its inline CSS, within a pass only
+	 * the first label does so. */
+	ccss_stylesheet_begin_styling_pass (stylesheet);
+	for (unsigned int i = 0; i < G_N_ELEMENTS (indices); i++) {
+		n = _n_get_style;
+		results[i] = query_fingerprint (stylesheet, indices[i]);
+		n_calls[i] = _n_get_style - n;
+		g_assert_cmpstr (results[i], ==, expected[i]);
+		g_free (results[i]);
+	}
+	ccss_stylesheet_end_styling_pass (stylesheet);
+	g_assert_cmpint (n_calls[0], >, 1);
+	g_assert_cmpint (n_calls[1], ==, 1);
+
+	/* After the pass the containers are queried again. */
+	n = _n_get_style;
+	results[1] = query_fingerprint (stylesheet, indices[1]);
+	g_assert_cmpint (_n_get_style - n, ==, n_calls[0]);
+	g_assert_cmpstr (results[1], ==, expected[1]);
+	g_free (results[1]);
+
+	g_free (expected[0]);
+	g_free (expected[1]);
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_selectors (void)
+{
+	static char const css[] =
+		"frame > box label	{ text: backtracked; }\n"
+		"frame > box > label	{ font: child; }\n"
+		"box.a.b		{ fill: both; }\n"
+		"label[accel]		{ stroke: accel; }\n"
+		"label[accel=ctrl]	{ id-set: ctrl; }\n"
+		"label			{ weight: normal; }\n";
+	static struct {
+		int		 index;
+		char const	*expected;
+	} const nodes[] = {
+		/* The nearest box isn't in the frame, the one above is. */
+		{ 12, "text=backtracked;weight=normal;" },
+		{ 4, "weight=normal;" },
+		/* Both classes are required. */
+		{ 13, "fill=both;" },
+		{ 1, "" },
+		{ 6, "fill=green;" },
+		/* Attribute present, and present with the given value. */
+		{ 14, "stroke=accel;text=backtracked;font=child;"
+		      "id-set=ctrl;weight=normal;" },
+		{ 15, "stroke=accel;text=backtracked;font=child;"
+		      "weight=normal;" },
+		/* Inline CSS applies to its node only, and overrides. */
+		{ 7, "weight=normal;" },
+		{ 8, "weight=bold;" }
+	};
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	char			*result;
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							css, strlen (css),
+							NULL);
+	g_assert (stylesheet);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS (nodes); i++) {
+		result = query_fingerprint (stylesheet, nodes[i].index);
+		g_assert_cmpstr (result, ==, nodes[i].expected);
+		g_free (result);
+	}
+
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+int
+main (int	  argc,
+      char	**argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/ccss-query/inline-shared", test_inline_shared);
+	g_test_add_func ("/ccss-query/container-chain", test_container_chain);
+	g_test_add_func ("/ccss-query/kept-node", test_kept_node);
+	g_test_add_func ("/ccss-query/kept-node-inline", test_kept_node_inline);
+	g_test_add_func ("/ccss-query/inline-cache", test_inline_cache);
+	g_test_add_func ("/ccss-query/restyle", test_restyle);
+	g_test_add_func ("/ccss-query/query-states", test_query_states);
+	g_test_add_func ("/ccss-query/query-tree", test_query_tree);
+	g_test_add_func ("/ccss-query/styling-pass", test_styling_pass);
+	g_test_add_func ("/ccss-query/selectors", test_selectors);
+	g_test_add_func ("/ccss-query/ancestor-filter", test_ancestor_filter);
+	g_test_add_func ("/ccss-query/ancestor-filter-saturated",
+			 test_ancestor_filter_saturated);
+	g_test_add_func ("/ccss-query/ancestor-filter-is-a",
+			 test_ancestor_filter_is_a);
+
+	return g_test_run ();
+}
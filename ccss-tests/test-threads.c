@@ -0,0 +1,121 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ccss/ccss.h>
+#include <glib.h>
+#include <glib/gprintf.h>
+#include "test-document.h"
+
+#define N_THREADS	8
+#define N_ITERATIONS	2000
+
+typedef struct {
+	ccss_stylesheet_t	 *stylesheet;
+	char			**expected;
+	unsigned int		  seed;
+	unsigned int		  n_failures;
+} thread_info_t;
+
+static gpointer
+query_thread (thread_info_t *info)
+{
+	GRand	*rand;
+	char	*result;
+	int	 index;
+
+	rand = g_rand_new_with_seed (info->seed);
+
+	for (unsigned int i = 0; i < N_ITERATIONS; i++) {
+		index = g_rand_int_range (rand, 0, N_DOCUMENT_NODES);
+		result = query_fingerprint (info->stylesheet, index);
+		if (strcmp (result, info->expected[index]))
+			info->n_failures++;
+		g_free (result);
+	}
+
+	g_rand_free (rand);
+
+	return NULL;
+}
+
+static void
+run_threads (unsigned int style_cache_size)
+{
+	ccss_grammar_t		*grammar;
+	ccss_stylesheet_t	*stylesheet;
+	GThread			*threads[N_THREADS];
+	thread_info_t		 infos[N_THREADS];
+	char			*expected[N_DOCUMENT_NODES];
+
+	grammar = ccss_grammar_create_generic ();
+	stylesheet = ccss_grammar_create_stylesheet_from_buffer (grammar,
+							_css, strlen (_css),
+							NULL);
+	g_assert (stylesheet);
+
+	/* Reference results, single threaded and uncached. */
+	for (unsigned int i = 0; i < N_DOCUMENT_NODES; i++) {
+		expected[i] = query_fingerprint (stylesheet, i);
+		if (g_test_verbose ()) g_printf ("%u: %s\n", i, expected[i]);
+	}
+	g_assert_cmpstr (expected[2], ==,
+			 "text=nested;font=sans;weight=bold;");
+	g_assert_cmpstr (expected[7], ==,
+			 "stroke=blue;font=sans;");
+
+	ccss_stylesheet_set_style_cache_size (stylesheet, style_cache_size);
+
+	for (unsigned int i = 0; i < N_THREADS; i++) {
+		infos[i].stylesheet = stylesheet;
+		infos[i].expected = expected;
+		infos[i].seed = i;
+		infos[i].n_failures = 0;
+		threads[i] = g_thread_create ((GThreadFunc) query_thread,
+					      &infos[i], true, NULL);
+		g_assert (threads[i]);
+	}
+
+	for (unsigned int i = 0; i < N_THREADS; i++) {
+		g_thread_join (threads[i]);
+		g_assert_cmpuint (infos[i].n_failures, ==, 0);
+	}
+
+	/* Queried styles must not keep the stylesheet alive. */
+	g_assert_cmpuint (ccss_stylesheet_get_reference_count (stylesheet), ==, 1);
+
+	for (unsigned int i = 0; i < N_DOCUMENT_NODES; i++) {
+		g_free (expected[i]);
+	}
+	ccss_stylesheet_destroy (stylesheet);
+	ccss_grammar_destroy (grammar);
+}
+
+static void
+test_query (void)
+{
+	run_threads (0);
+}
+
+static void
+test_query_cached (void)
+{
+	/* Small enough for the cache to be flushed while querying. */
+	run_threads (3);
+}
+
+int
+main (int	  argc,
+      char	**argv)
+{
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/ccss-threads/query", test_query);
+	g_test_add_func ("/ccss-threads/query-cached", test_query_cached);
+
+	return g_test_run ();
+}
+
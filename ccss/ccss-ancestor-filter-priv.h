@@ -0,0 +1,83 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The `C' CSS Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CCSS_ANCESTOR_FILTER_PRIV_H
+#define CCSS_ANCESTOR_FILTER_PRIV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+#include <ccss/ccss-ancestor-filter.h>
+#include <ccss/ccss-macros.h>
+
+CCSS_BEGIN_DECLS
+
+#define CCSS_ANCESTOR_FILTER_KEY_BITS 12
+#define CCSS_ANCESTOR_FILTER_N_COUNTERS (1 << CCSS_ANCESTOR_FILTER_KEY_BITS)
+
+/* Number of ancestor facts recorded per selector, further facts are only
+ * checked by walking the containers. */
+#define CCSS_ANCESTOR_FILTER_N_HASHES 4
+
+typedef enum {
+	CCSS_ANCESTOR_FACT_TYPE = 1,
+	CCSS_ANCESTOR_FACT_ID,
+	CCSS_ANCESTOR_FACT_CLASS
+} ccss_ancestor_fact_t;
+
+/**
+ * ccss_ancestor_filter_t:
+ *
+ * Counting bloom filter over the types, IDs and classes of a chain of nodes.
+ **/
+struct ccss_ancestor_filter_ {
+	/*< private >*/
+	uint8_t		 counters[CCSS_ANCESTOR_FILTER_N_COUNTERS];
+	GArray		*hashes;
+	GArray		*frames;
+	unsigned int	 n_opaque_types;
+};
+
+/*
+ * Facts a selector requires of a node's containers.
+ * Bits in `type_mask' mark hashes of type names.
+ */
+typedef struct {
+	uint32_t	hashes[CCSS_ANCESTOR_FILTER_N_HASHES];
+	uint8_t		n_hashes;
+	uint8_t		type_mask;
+} ccss_ancestor_hashes_t;
+
+uint32_t
+ccss_ancestor_filter_hash		(ccss_ancestor_fact_t		 fact,
+					 ccss_atom_t			 atom);
+
+ccss_ancestor_filter_t *
+ccss_ancestor_filter_create_for_node	(ccss_node_t			*node);
+
+bool
+ccss_ancestor_filter_may_match		(ccss_ancestor_filter_t const	*self,
+					 ccss_ancestor_hashes_t const	*hashes);
+
+CCSS_END_DECLS
+
+#endif /* CCSS_ANCESTOR_FILTER_PRIV_H */
+
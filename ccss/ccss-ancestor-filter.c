@@ -0,0 +1,248 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The `C' CSS Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include "ccss-ancestor-filter-priv.h"
+#include "ccss-node-priv.h"
+#include "config.h"
+
+#define KEY_MASK (CCSS_ANCESTOR_FILTER_N_COUNTERS - 1)
+#define COUNTER_MAX UINT8_MAX
+
+typedef struct {
+	unsigned int	first_hash;
+	bool		is_opaque;
+} frame_t;
+
+/*
+ * Two keys are derived from each hash, one from the low and one from the
+ * high bits.
+ */
+#define KEY1(hash_) ((hash_) & KEY_MASK)
+#define KEY2(hash_) (((hash_) >> CCSS_ANCESTOR_FILTER_KEY_BITS) & KEY_MASK)
+
+uint32_t
+ccss_ancestor_filter_hash (ccss_ancestor_fact_t	fact,
+			   ccss_atom_t		atom)
+{
+	uint32_t hash;
+
+	/* Salt with the kind of fact, so `.foo' and `#foo' differ. */
+	hash = (atom << 2) ^ fact;
+	hash *= 0x9e3779b1;
+	hash ^= hash >> 15;
+
+	return hash;
+}
+
+/**
+ * ccss_ancestor_filter_create:
+ *
+ * Create an empty filter, to be filled with ccss_ancestor_filter_push() while
+ * descending a document.
+ *
+ * Returns: a #ccss_ancestor_filter_t.
+ **/
+ccss_ancestor_filter_t *
+ccss_ancestor_filter_create (void)
+{
+	ccss_ancestor_filter_t *self;
+
+	self = g_new0 (ccss_ancestor_filter_t, 1);
+	self->hashes = g_array_new (false, false, sizeof (uint32_t));
+	self->frames = g_array_new (false, false, sizeof (frame_t));
+
+	return self;
+}
+
+/**
+ * ccss_ancestor_filter_destroy:
+ * @self: a #ccss_ancestor_filter_t.
+ *
+ * Free the filter and all associated resources.
+ **/
+void
+ccss_ancestor_filter_destroy (ccss_ancestor_filter_t *self)
+{
+	g_return_if_fail (self);
+
+	g_array_free (self->hashes, true);
+	g_array_free (self->frames, true);
+	g_free (self);
+}
+
+static void
+add_hash (ccss_ancestor_filter_t	*self,
+	  uint32_t		 hash)
+{
+	uint8_t *counter;
+
+	g_array_append_val (self->hashes, hash);
+
+	/* Saturated counters stick, they can't be decremented reliably. */
+	counter = &self->counters[KEY1 (hash)];
+	if (*counter < COUNTER_MAX)
+		(*counter)++;
+	counter = &self->counters[KEY2 (hash)];
+	if (*counter < COUNTER_MAX)
+		(*counter)++;
+}
+
+static void
+remove_hash (ccss_ancestor_filter_t	*self,
+	     uint32_t			 hash)
+{
+	uint8_t *counter;
+
+	counter = &self->counters[KEY1 (hash)];
+	if (*counter < COUNTER_MAX)
+		(*counter)--;
+	counter = &self->counters[KEY2 (hash)];
+	if (*counter < COUNTER_MAX)
+		(*counter)--;
+}
+
+/**
+ * ccss_ancestor_filter_push:
+ * @self:	a #ccss_ancestor_filter_t.
+ * @node:	a #ccss_node_t.
+ *
+ * Add @node's type, ID and classes to the filter. When styling a subtree
+ * top-down, push each node before querying its children and pop it
+ * afterwards, so the filter always describes the containers of the nodes
+ * being queried, see ccss_stylesheet_query_with_ancestor_filter().
+ **/
+void
+ccss_ancestor_filter_push (ccss_ancestor_filter_t	*self,
+			   ccss_node_t			*node)
+{
+	frame_t			 frame;
+	ccss_atom_t		 atom;
+	ccss_atom_t const	*atoms;
+
+	g_return_if_fail (self && node);
+
+	frame.first_hash = self->hashes->len;
+	frame.is_opaque = ccss_node_implements_is_a (node);
+
+	if (frame.is_opaque) {
+		/* Type matching is up to the node, can't record it. */
+		self->n_opaque_types++;
+	} else {
+		atom = ccss_node_get_type_atom (node);
+		if (atom) {
+			add_hash (self, ccss_ancestor_filter_hash (
+					CCSS_ANCESTOR_FACT_TYPE, atom));
+		}
+	}
+
+	atom = ccss_node_get_id_atom (node);
+	if (atom) {
+		add_hash (self, ccss_ancestor_filter_hash (
+				CCSS_ANCESTOR_FACT_ID, atom));
+	}
+
+	atoms = ccss_node_get_class_atoms (node);
+	for (; atoms && *atoms; atoms++) {
+		add_hash (self, ccss_ancestor_filter_hash (
+				CCSS_ANCESTOR_FACT_CLASS, *atoms));
+	}
+
+	g_array_append_val (self->frames, frame);
+}
+
+/**
+ * ccss_ancestor_filter_pop:
+ * @self:	a #ccss_ancestor_filter_t.
+ *
+ * Remove the node pushed last from the filter.
+ **/
+void
+ccss_ancestor_filter_pop (ccss_ancestor_filter_t *self)
+{
+	frame_t const *frame;
+
+	g_return_if_fail (self && self->frames->len > 0);
+
+	frame = &g_array_index (self->frames, frame_t, self->frames->len - 1);
+
+	for (unsigned int i = frame->first_hash; i < self->hashes->len; i++) {
+		remove_hash (self, g_array_index (self->hashes, uint32_t, i));
+	}
+	g_array_set_size (self->hashes, frame->first_hash);
+
+	if (frame->is_opaque) {
+		self->n_opaque_types--;
+	}
+
+	g_array_set_size (self->frames, self->frames->len - 1);
+}
+
+/*
+ * Fill a filter with the whole chain of `node's containers.
+ */
+ccss_ancestor_filter_t *
+ccss_ancestor_filter_create_for_node (ccss_node_t *node)
+{
+	ccss_ancestor_filter_t	*self;
+	ccss_node_t		*container;
+
+	g_return_val_if_fail (node, NULL);
+
+	self = ccss_ancestor_filter_create ();
+
+	/* The order of pushing doesn't matter as long as nothing is popped. */
+	container = ccss_node_get_container (node);
+	while (container) {
+		ccss_ancestor_filter_push (self, container);
+		container = ccss_node_get_container (container);
+	}
+
+	return self;
+}
+
+/*
+ * Returns false if some of `hashes' definitely is not a fact of any
+ * container in the filter.
+ */
+bool
+ccss_ancestor_filter_may_match (ccss_ancestor_filter_t const	*self,
+				ccss_ancestor_hashes_t const	*hashes)
+{
+	uint32_t hash;
+
+	g_assert (self && hashes);
+
+	for (unsigned int i = 0; i < hashes->n_hashes; i++) {
+
+		if (self->n_opaque_types &&
+		    (hashes->type_mask & (1 << i)))
+			continue;
+
+		hash = hashes->hashes[i];
+		if (0 == self->counters[KEY1 (hash)] ||
+		    0 == self->counters[KEY2 (hash)])
+			return false;
+	}
+
+	return true;
+}
+
@@ -0,0 +1,48 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The `C' CSS Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CCSS_ANCESTOR_FILTER_H
+#define CCSS_ANCESTOR_FILTER_H
+
+#include <ccss/ccss-macros.h>
+#include <ccss/ccss-node.h>
+
+CCSS_BEGIN_DECLS
+
+typedef struct ccss_ancestor_filter_ ccss_ancestor_filter_t;
+
+ccss_ancestor_filter_t *
+ccss_ancestor_filter_create	(void);
+
+void
+ccss_ancestor_filter_destroy	(ccss_ancestor_filter_t	*self);
+
+void
+ccss_ancestor_filter_push	(ccss_ancestor_filter_t	*self,
+				 ccss_node_t		*node);
+
+void
+ccss_ancestor_filter_pop	(ccss_ancestor_filter_t	*self);
+
+CCSS_END_DECLS
+
+#endif /* CCSS_ANCESTOR_FILTER_H */
+
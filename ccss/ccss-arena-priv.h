@@ -0,0 +1,53 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The `C' CSS Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CCSS_ARENA_PRIV_H
+#define CCSS_ARENA_PRIV_H
+
+#include <stddef.h>
+#include <glib.h>
+#include <ccss/ccss-macros.h>
+
+CCSS_BEGIN_DECLS
+
+/*
+ * Bump pointer allocator for the objects parsed from one CSS file or
+ * buffer. Everything is released at once when the last reference goes
+ * away, after running the registered finalizers.
+ */
+typedef struct ccss_arena_ ccss_arena_t;
+
+ccss_arena_t *	ccss_arena_create	(void);
+ccss_arena_t *	ccss_arena_reference	(ccss_arena_t *self);
+void		ccss_arena_destroy	(ccss_arena_t *self);
+
+void *		ccss_arena_alloc	(ccss_arena_t	*self,
+					 size_t		 size);
+char *		ccss_arena_strdup	(ccss_arena_t	*self,
+					 char const	*str);
+void		ccss_arena_add_finalizer (ccss_arena_t	*self,
+					  GDestroyNotify func,
+					  void		*data);
+
+CCSS_END_DECLS
+
+#endif /* CCSS_ARENA_PRIV_H */
+
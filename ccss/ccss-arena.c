@@ -0,0 +1,173 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The `C' CSS Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "ccss-arena-priv.h"
+#include "config.h"
+
+#define CHUNK_SIZE 4096
+
+/* Round up to the alignment malloc() guarantees. */
+#define ALIGN(size_) (((size_) + G_MEM_ALIGN - 1) & ~(size_t) (G_MEM_ALIGN - 1))
+
+typedef struct chunk_ {
+	struct chunk_	*next;
+	size_t		 size;
+	size_t		 used;
+	/* Followed by the payload. */
+} chunk_t;
+
+typedef struct finalizer_ {
+	struct finalizer_	*next;
+	GDestroyNotify		 func;
+	void			*data;
+} finalizer_t;
+
+struct ccss_arena_ {
+	int volatile	 reference_count;
+	chunk_t		*chunks;	/* Current chunk first */
+	finalizer_t	*finalizers;	/* Allocated from the arena */
+};
+
+#define CHUNK_HEADER_SIZE ALIGN (sizeof (chunk_t))
+
+ccss_arena_t *
+ccss_arena_create (void)
+{
+	ccss_arena_t *self;
+
+	self = g_new0 (ccss_arena_t, 1);
+	self->reference_count = 1;
+
+	return self;
+}
+
+ccss_arena_t *
+ccss_arena_reference (ccss_arena_t *self)
+{
+	g_assert (self);
+
+	g_atomic_int_inc (&self->reference_count);
+
+	return self;
+}
+
+void
+ccss_arena_destroy (ccss_arena_t *self)
+{
+	chunk_t *chunk;
+
+	g_assert (self);
+
+	if (!g_atomic_int_dec_and_test (&self->reference_count))
+		return;
+
+	/* Finalizers run in reverse order of registration. */
+	for (finalizer_t *iter = self->finalizers; iter; iter = iter->next) {
+		iter->func (iter->data);
+	}
+
+	while (self->chunks) {
+		chunk = self->chunks;
+		self->chunks = chunk->next;
+		g_free (chunk);
+	}
+
+	g_free (self);
+}
+
+/*
+ * Returns zeroed memory that lives as long as the arena. Requests that
+ * don't fit a regular chunk get one of their own, behind the current one
+ * so its remaining space is not lost.
+ */
+void *
+ccss_arena_alloc (ccss_arena_t	*self,
+		  size_t	 size)
+{
+	chunk_t	*chunk;
+	size_t	 chunk_size;
+	char	*ret;
+
+	g_assert (self);
+
+	size = ALIGN (MAX (size, 1));
+
+	chunk = self->chunks;
+	if (NULL == chunk || chunk->used + size > chunk->size) {
+		chunk_size = MAX (CHUNK_SIZE - CHUNK_HEADER_SIZE, size);
+		chunk = (chunk_t *) g_malloc (CHUNK_HEADER_SIZE + chunk_size);
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		if (self->chunks && chunk_size > CHUNK_SIZE - CHUNK_HEADER_SIZE) {
+			chunk->next = self->chunks->next;
+			self->chunks->next = chunk;
+		} else {
+			chunk->next = self->chunks;
+			self->chunks = chunk;
+		}
+	}
+
+	ret = (char *) chunk + CHUNK_HEADER_SIZE + chunk->used;
+	chunk->used += size;
+	memset (ret, 0, size);
+
+	return ret;
+}
+
+char *
+ccss_arena_strdup (ccss_arena_t	*self,
+		   char const	*str)
+{
+	size_t	 size;
+	char	*ret;
+
+	if (NULL == str)
+		return NULL;
+
+	size = strlen (str) + 1;
+	ret = (char *) ccss_arena_alloc (self, size);
+	memcpy (ret, str, size);
+
+	return ret;
+}
+
+/*
+ * Have `func' called on `data' before the arena's memory is released,
+ * for objects in the arena that own resources elsewhere.
+ */
+void
+ccss_arena_add_finalizer (ccss_arena_t		*self,
+			  GDestroyNotify	 func,
+			  void			*data)
+{
+	finalizer_t *finalizer;
+
+	g_assert (self && func);
+
+	finalizer = (finalizer_t *) ccss_arena_alloc (self,
+						      sizeof (finalizer_t));
+	finalizer->func = func;
+	finalizer->data = data;
+	finalizer->next = self->finalizers;
+	self->finalizers = finalizer;
+}
@@ -23,11 +23,18 @@
 #define CCSS_BLOCK_PRIV_H
 
 #include <glib.h>
+#include <ccss/ccss-arena-priv.h>
 #include <ccss/ccss-block.h>
 #include <ccss/ccss-macros.h>
+#include <ccss/ccss-property.h>
 
 CCSS_BEGIN_DECLS
 
+typedef struct {
+	GQuark		 id;
+	ccss_property_t	*property;
+} ccss_block_entry_t;
+
 /**
  * ccss_block_t:
  *
@@ -35,16 +42,32 @@ CCSS_BEGIN_DECLS
  **/
 struct ccss_block_ {
 	/*< private >*/
-	unsigned int     reference_count;
-	GHashTable      *properties;
+	int volatile		 reference_count;
+	ccss_arena_t		*arena;		/* NULL for inline CSS */
+	ccss_block_entry_t	*properties;	/* In order of appearance */
+	unsigned int		 n_properties;
+	unsigned int		 n_allocated;
 };
 
-ccss_block_t *	ccss_block_create	(void);
+ccss_block_t *	ccss_block_create	(ccss_arena_t *arena);
 void		ccss_block_destroy	(ccss_block_t *self);
 ccss_block_t *	ccss_block_reference	(ccss_block_t *self);
 
 void		ccss_block_dump	(ccss_block_t const *self);
 
+/* Blocks hold a handful of properties, a linear scan will do. */
+static inline ccss_property_t const *
+ccss_block_lookup_property (ccss_block_t const	*self,
+			    GQuark		 property_id)
+{
+	for (unsigned int i = 0; i < self->n_properties; i++) {
+		if (property_id == self->properties[i].id)
+			return self->properties[i].property;
+	}
+
+	return NULL;
+}
+
 CCSS_END_DECLS
 
 #endif /* CCSS_BLOCK_PRIV_H */
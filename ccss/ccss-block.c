@@ -19,22 +19,44 @@
  * MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <glib.h>
 #include "ccss-block-priv.h"
 #include "ccss-property-impl.h"
+#include "ccss-property-priv.h"
 #include "config.h"
 
+static void
+destroy_properties (ccss_block_t *self)
+{
+	for (unsigned int i = 0; i < self->n_properties; i++) {
+		ccss_property_destroy (self->properties[i].property);
+	}
+	self->n_properties = 0;
+}
+
+/*
+ * Blocks parsed from a stylesheet live in the arena of the file or buffer
+ * they come from. Their properties outlive the block's references, until
+ * the arena goes away. Blocks from inline CSS are allocated separately,
+ * `arena' is NULL.
+ */
 ccss_block_t *
-ccss_block_create (void)
+ccss_block_create (ccss_arena_t *arena)
 {
 	ccss_block_t *self;
 
-	self = g_new0 (ccss_block_t, 1);
+	if (arena) {
+		self = (ccss_block_t *) ccss_arena_alloc (arena,
+							  sizeof (*self));
+		self->arena = arena;
+		ccss_arena_add_finalizer (arena,
+					  (GDestroyNotify) destroy_properties,
+					  self);
+	} else {
+		self = g_new0 (ccss_block_t, 1);
+	}
 	self->reference_count = 1;
-	self->properties = g_hash_table_new_full ((GHashFunc) g_direct_hash, 
-						  (GEqualFunc) g_direct_equal,
-						  NULL,
-						  (GDestroyNotify) ccss_property_destroy);
 
 	return self;
 }
@@ -42,12 +64,12 @@ ccss_block_create (void)
 void
 ccss_block_destroy (ccss_block_t *self)
 {
-	g_return_if_fail (self && self->properties);
-
-	self->reference_count--;
+	g_return_if_fail (self);
 
-	if (self->reference_count == 0) {
-		g_hash_table_destroy (self->properties), self->properties = NULL;
+	if (g_atomic_int_dec_and_test (&self->reference_count) &&
+	    NULL == self->arena) {
+		destroy_properties (self);
+		g_free (self->properties), self->properties = NULL;
 		g_free (self);
 	}
 }
@@ -57,11 +79,35 @@ ccss_block_reference (ccss_block_t *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	self->reference_count++;
+	g_atomic_int_inc (&self->reference_count);
 
 	return self;
 }
 
+static void
+grow (ccss_block_t *self)
+{
+	ccss_block_entry_t	*properties;
+	unsigned int		 n_allocated;
+
+	n_allocated = MAX (4, 2 * self->n_allocated);
+	if (self->arena) {
+		properties = (ccss_block_entry_t *) ccss_arena_alloc (
+				self->arena,
+				n_allocated * sizeof (ccss_block_entry_t));
+		if (self->n_properties) {
+			memcpy (properties, self->properties,
+				self->n_properties * sizeof (ccss_block_entry_t));
+		}
+	} else {
+		properties = g_renew (ccss_block_entry_t, self->properties,
+				      n_allocated);
+	}
+
+	self->properties = properties;
+	self->n_allocated = n_allocated;
+}
+
 /**
  * ccss_block_add_property:
  * @self:		a #ccss_block_t.
@@ -82,23 +128,40 @@ ccss_block_add_property (ccss_block_t		*self,
 		property_id = g_quark_from_string (property_name);
 	}
 
-	g_hash_table_insert (
-			self->properties, 
-			(gpointer) property_id,
-			(gpointer) property);
+	/* Names the grammar doesn't know get their slot on first use. */
+	ccss_property_slots_assign (property_id);
+
+	/* A later declaration replaces an earlier one. */
+	for (unsigned int i = 0; i < self->n_properties; i++) {
+		if (property_id == self->properties[i].id) {
+			if (property != self->properties[i].property) {
+				ccss_property_destroy (
+					self->properties[i].property);
+			}
+			self->properties[i].property = property;
+			return;
+		}
+	}
 
+	if (self->n_properties == self->n_allocated) {
+		grow (self);
+	}
+	self->properties[self->n_properties].id = property_id;
+	self->properties[self->n_properties].property = property;
+	self->n_properties++;
 }
 
 void
 ccss_block_dump (ccss_block_t const *self)
 {
-	GHashTableIter		 iter;
 	GQuark			 property_id;
 	ccss_property_t const	*property;
 	char			*strval;
 
-	g_hash_table_iter_init (&iter, self->properties);
-	while (g_hash_table_iter_next (&iter, (gpointer *) &property_id, (gpointer *) &property))  {
+	for (unsigned int i = 0; i < self->n_properties; i++) {
+
+		property_id = self->properties[i].id;
+		property = self->properties[i].property;
 
 		strval = NULL;
 		if (CCSS_PROPERTY_STATE_NONE == property->state ||
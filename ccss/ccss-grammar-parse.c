@@ -32,13 +32,14 @@
 
 typedef struct {
 	ptrdiff_t		 instance;
-	ccss_selector_group_t	*result_group;
+	GSList			*selectors;
 } instance_info_t;
 
 typedef struct {
 	ccss_grammar_t const		*grammar;
 	ccss_stylesheet_precedence_t	 precedence;
 	unsigned int			 stylesheet_descriptor;
+	ccss_arena_t			*arena;
 	void				*user_data;
 	GHashTable			*blocks;
 	GHashTable			*groups;
@@ -96,6 +97,7 @@ static ccss_selector_t *
 walk_additional_selector (CRAdditionalSel		*cr_add_sel,
 			  ccss_stylesheet_precedence_t	 precedence,
 			  unsigned int			 stylesheet_descriptor,
+			  ccss_arena_t			*arena,
 			  bool				 is_important)
 {
 	ccss_selector_t			*selector;
@@ -116,32 +118,39 @@ walk_additional_selector (CRAdditionalSel		*cr_add_sel,
 		selector = ccss_class_selector_create (name,
 						       precedence,
 						       stylesheet_descriptor,
-						       importance);
+						       importance,
+						       arena);
 		break;
 	case PSEUDO_CLASS_ADD_SELECTOR:
 		name = cr_string_peek_raw_str (cr_add_sel->content.pseudo->name);
 		selector = ccss_pseudo_class_selector_create (name,
 							      precedence,
 							      stylesheet_descriptor,
-							      importance);
+							      importance,
+							      arena);
 		break;
 	case ID_ADD_SELECTOR:
 		name = cr_string_peek_raw_str (cr_add_sel->content.id_name);
 		selector = ccss_id_selector_create (name,
 						    precedence,
 						    stylesheet_descriptor,
-						    importance);
+						    importance,
+						    arena);
 		break;
 	case ATTRIBUTE_ADD_SELECTOR:
 		name = cr_string_peek_raw_str (cr_add_sel->content.attr_sel->name);
-		value = cr_string_peek_raw_str (cr_add_sel->content.attr_sel->value);
+		/* No value for `[name]'. */
+		value = cr_add_sel->content.attr_sel->value ?
+			cr_string_peek_raw_str (cr_add_sel->content.attr_sel->value) :
+			NULL;
 		match = map_attribute_selector_match (cr_add_sel->content.attr_sel->match_way);
 		selector = ccss_attribute_selector_create (name,
 							   value,
 							   match,
 							   precedence,
 							   stylesheet_descriptor,
-							   importance);
+							   importance,
+							   arena);
 		break;
 	case NO_ADD_SELECTOR:
 	default:
@@ -154,6 +163,7 @@ walk_additional_selector (CRAdditionalSel		*cr_add_sel,
 		refinement = walk_additional_selector (cr_add_sel->next,
 						       precedence,
 						       stylesheet_descriptor,
+						       arena,
 						       is_important);
 		ccss_selector_refine (selector, refinement);
 	}
@@ -165,6 +175,7 @@ static ccss_selector_t *
 walk_simple_selector_r (CRSimpleSel			*cr_simple_sel,
 			ccss_stylesheet_precedence_t	 precedence,
 			unsigned int			 stylesheet_descriptor,
+			ccss_arena_t			*arena,
 			bool				 is_important)
 {
 	ccss_selector_t			*selector;
@@ -177,12 +188,14 @@ walk_simple_selector_r (CRSimpleSel			*cr_simple_sel,
 	if (UNIVERSAL_SELECTOR & cr_simple_sel->type_mask) {
 		selector = ccss_universal_selector_create (precedence,
 							   stylesheet_descriptor,
-							   importance);
+							   importance,
+							   arena);
 	} else if (TYPE_SELECTOR & cr_simple_sel->type_mask) {
 		selector = ccss_type_selector_create (cr_string_peek_raw_str (cr_simple_sel->name),
 						      precedence,
 						      stylesheet_descriptor,
-						      importance);
+						      importance,
+						      arena);
 	} else {
 		char const *sel;
 		sel = cr_simple_sel->name ? cr_string_peek_raw_str (cr_simple_sel->name) : NULL;
@@ -197,6 +210,7 @@ walk_simple_selector_r (CRSimpleSel			*cr_simple_sel,
 		refinement = walk_additional_selector (cr_simple_sel->add_sel,
 						       precedence,
 						       stylesheet_descriptor,
+						       arena,
 						       is_important);
 		ccss_selector_refine (selector, refinement);
 	}
@@ -206,6 +220,7 @@ walk_simple_selector_r (CRSimpleSel			*cr_simple_sel,
 		descendant = walk_simple_selector_r (cr_simple_sel->next,
 						     precedence,
 						     stylesheet_descriptor,
+						     arena,
 						     is_important);
 		if (COMB_WS == cr_simple_sel->next->combinator) {
 			selector = ccss_selector_append_descendant (selector,
@@ -227,8 +242,9 @@ walk_selector (CRSelector			*cr_sel,
 	       GHashTable			*groups,
 	       ccss_stylesheet_precedence_t	 precedence,
 	       unsigned int			 stylesheet_descriptor,
+	       ccss_arena_t			*arena,
 	       bool				 is_important,
-	       instance_info_t const		*instance_info)
+	       instance_info_t			*instance_info)
 {
 	ccss_selector_t		*selector;
 	ccss_selector_group_t	*group;
@@ -245,8 +261,8 @@ walk_selector (CRSelector			*cr_sel,
 							  stylesheet_descriptor,
 							  importance);
 		ccss_selector_set_block (selector, block);
-		ccss_selector_group_add_selector (instance_info->result_group,
-						  selector);
+		instance_info->selectors = g_slist_prepend (instance_info->selectors,
+							    selector);
 		return;
 	}
 
@@ -256,6 +272,7 @@ walk_selector (CRSelector			*cr_sel,
 		selector = walk_simple_selector_r (iter->simple_sel,
 						   precedence,
 						   stylesheet_descriptor,
+						   arena,
 						   is_important);
 		if (selector) {
 			ccss_selector_set_block (selector, block);
@@ -331,7 +348,7 @@ property_cb (CRDocHandler	*handler,
 	 * `important' properties. */
 	if (is_important) {
 		if (NULL == info->important_block) {
-			info->important_block = ccss_block_create ();
+			info->important_block = ccss_block_create (info->arena);
 			g_hash_table_insert (info->blocks,
 					     (gpointer) info->important_block,
 					     (gpointer) info->important_block);
@@ -339,7 +356,7 @@ property_cb (CRDocHandler	*handler,
 		block = info->important_block;
 	} else {
 		if (NULL == info->block) {
-			info->block = ccss_block_create ();
+			info->block = ccss_block_create (info->arena);
 			g_hash_table_insert (info->blocks,
 					     (gpointer) info->block,
 					     (gpointer) info->block);
@@ -393,7 +410,7 @@ end_selector_cb (CRDocHandler	*handler,
 	if (info->block) {
 		walk_selector (cr_sel, info->block, info->groups,
 			       info->precedence, info->stylesheet_descriptor,
-			       false, info->instance);
+			       info->arena, false, info->instance);
 		info->block = NULL;
 	}
 
@@ -402,7 +419,7 @@ end_selector_cb (CRDocHandler	*handler,
 	if (info->important_block) {
 		walk_selector (cr_sel, info->important_block, info->groups,
 			       info->precedence, info->stylesheet_descriptor,
-			       true, info->instance);
+			       info->arena, true, info->instance);
 		info->important_block = NULL;
 	}
 }
@@ -412,6 +429,7 @@ ccss_grammar_parse_file (ccss_grammar_t const		*self,
 			 char const			*css_file,
 			 ccss_stylesheet_precedence_t	 precedence,
 			 unsigned int			 stylesheet_descriptor,
+			 ccss_arena_t			*arena,
 			 void				*user_data,
 			 GHashTable			*groups,
 			 GHashTable			*blocks)
@@ -430,6 +448,7 @@ ccss_grammar_parse_file (ccss_grammar_t const		*self,
 	info.grammar = self;
 	info.precedence = precedence;
 	info.stylesheet_descriptor = stylesheet_descriptor;
+	info.arena = arena;
 	info.user_data = user_data;
 	info.blocks = blocks;
 	info.groups = groups;
@@ -464,6 +483,7 @@ ccss_grammar_parse_buffer (ccss_grammar_t const		*self,
 			   size_t			 size,
 			   ccss_stylesheet_precedence_t	 precedence,
 			   unsigned int			 stylesheet_descriptor,
+			   ccss_arena_t			*arena,
 			   void				*user_data,
 			   GHashTable			*groups,
 			   GHashTable			*blocks)
@@ -483,6 +503,7 @@ ccss_grammar_parse_buffer (ccss_grammar_t const		*self,
 	info.grammar = self;
 	info.precedence = precedence;
 	info.stylesheet_descriptor = stylesheet_descriptor;
+	info.arena = arena;
 	info.user_data = user_data;
 	info.blocks = blocks;
 	info.groups = groups;
@@ -513,7 +534,7 @@ ccss_grammar_parse_inline (ccss_grammar_t const		*self,
 			   unsigned int			 stylesheet_descriptor,
 			   ptrdiff_t			 instance,
 			   void				*user_data,
-			   ccss_selector_group_t	*result_group,
+			   GSList			**selectors,
 			   GHashTable			*blocks)
 {
 	CRParser		*parser;
@@ -527,7 +548,7 @@ ccss_grammar_parse_inline (ccss_grammar_t const		*self,
 	g_string_append (stmt, buffer);
 	g_string_append (stmt, "}");
 
-	g_assert (buffer && instance && result_group);
+	g_assert (buffer && instance && selectors);
 
 	parser = cr_parser_new_from_buf ((guchar *) stmt->str, 
 					 (gulong) stmt->len, CR_UTF_8, false);
@@ -537,6 +558,7 @@ ccss_grammar_parse_inline (ccss_grammar_t const		*self,
 	info.grammar = self;
 	info.precedence = precedence;
 	info.stylesheet_descriptor = stylesheet_descriptor;
+	info.arena = NULL;
 	info.blocks = blocks;
 	info.user_data = user_data;
 	info.groups = NULL;
@@ -544,7 +566,7 @@ ccss_grammar_parse_inline (ccss_grammar_t const		*self,
 	info.important_block = NULL;
 	info.instance = &instance_info;
 	instance_info.instance = instance;
-	instance_info.result_group = result_group;
+	instance_info.selectors = NULL;
 
 	handler->start_selector = start_selector_cb;
         handler->property = property_cb;
@@ -560,6 +582,8 @@ ccss_grammar_parse_inline (ccss_grammar_t const		*self,
 	cr_parser_destroy (parser);
 	g_string_free (stmt, true), stmt = NULL;
 
+	*selectors = instance_info.selectors;
+
 	return ret;	
 }
 
@@ -24,6 +24,7 @@
 
 #include <glib.h>
 #include <libcroco/libcroco.h>
+#include <ccss/ccss-arena-priv.h>
 #include <ccss/ccss-grammar.h>
 #include <ccss/ccss-macros.h>
 #include <ccss/ccss-selector-group.h>
@@ -38,7 +39,7 @@ CCSS_BEGIN_DECLS
  **/
 struct ccss_grammar_ {
 	/*< private >*/
-	unsigned int	 reference_count;
+	int volatile	 reference_count;
 	GHashTable	*properties;
 	GHashTable	*functions;
 };
@@ -48,6 +49,7 @@ ccss_grammar_parse_file (ccss_grammar_t const		*self,
 			 char const			*css_file, 
 			 ccss_stylesheet_precedence_t	 precedence,
 			 unsigned int			 stylesheet_descriptor,
+			 ccss_arena_t			*arena,
 			 void				*user_data,
 			 GHashTable			*groups,
 			 GHashTable			*blocks);
@@ -58,6 +60,7 @@ ccss_grammar_parse_buffer (ccss_grammar_t const		*self,
 			   size_t			 buffer_size,
 			   ccss_stylesheet_precedence_t	 precedence,
 			   unsigned int			 stylesheet_descriptor,
+			   ccss_arena_t			*arena,
 			   void				*user_data,
 			   GHashTable			*groups,
 			   GHashTable			*blocks);
@@ -69,7 +72,7 @@ ccss_grammar_parse_inline (ccss_grammar_t const		*self,
 			   unsigned int			 stylesheet_descriptor,
 			   ptrdiff_t			 instance,
 			   void				*user_data,
-			   ccss_selector_group_t	*result_group,
+			   GSList			**selectors,
 			   GHashTable			*blocks);
 
 CCSS_END_DECLS
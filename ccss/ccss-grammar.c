@@ -31,6 +31,7 @@
 #include "ccss-function-impl.h"
 #include "ccss-padding-parser.h"
 #include "ccss-property-impl.h"
+#include "ccss-property-priv.h"
 
 #include "config.h"
 
@@ -98,9 +99,7 @@ ccss_grammar_destroy (ccss_grammar_t *self)
 {
 	g_assert (self && self->reference_count > 0);
 
-	self->reference_count--;
-
-	if (0 == self->reference_count) {
+	if (g_atomic_int_dec_and_test (&self->reference_count)) {
 		g_hash_table_destroy (self->properties), self->properties = NULL;
 		g_hash_table_destroy (self->functions), self->functions = NULL;
 		g_free (self);
@@ -124,7 +123,7 @@ ccss_grammar_reference (ccss_grammar_t *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	self->reference_count++;
+	g_atomic_int_inc (&self->reference_count);
 
 	return self;
 }
@@ -141,7 +140,7 @@ ccss_grammar_get_reference_count (ccss_grammar_t const *self)
 {
 	g_return_val_if_fail (self, 0);
 
-	return self->reference_count;
+	return g_atomic_int_get ((int *) &self->reference_count);
 }
 
 /**
@@ -167,6 +166,12 @@ ccss_grammar_add_properties (ccss_grammar_t			*self,
 		g_hash_table_insert (self->properties,
 				     (gpointer) properties[i].name,
 				     (gpointer) &properties[i]);
+
+		/* Styles store properties by slot. */
+		if (g_strcmp0 (properties[i].name, "*")) {
+			ccss_property_slots_assign (
+				g_quark_from_static_string (properties[i].name));
+		}
 	}
 }
 
@@ -291,6 +296,7 @@ ccss_grammar_create_stylesheet_from_buffer (ccss_grammar_t	*self,
 					    void		*user_data)
 {
 	ccss_stylesheet_t	*stylesheet;
+	ccss_arena_t		*arena;
 	enum CRStatus		 ret;
 
 	g_return_val_if_fail (self, NULL);
@@ -300,15 +306,18 @@ ccss_grammar_create_stylesheet_from_buffer (ccss_grammar_t	*self,
 	stylesheet = ccss_stylesheet_create ();
 	stylesheet->grammar = ccss_grammar_reference (self);
 	stylesheet->current_descriptor++;
+	arena = ccss_stylesheet_create_arena (stylesheet,
+					      stylesheet->current_descriptor);
 
 	ret = ccss_grammar_parse_buffer (self, buffer, size,
 					 CCSS_STYLESHEET_AUTHOR, 
-					 stylesheet->current_descriptor,
+					 stylesheet->current_descriptor, arena,
 					 user_data,
 					 stylesheet->groups, stylesheet->blocks);
 
 	if (CR_OK == ret) {
 		ccss_stylesheet_fix_dangling_selectors (stylesheet);
+		ccss_stylesheet_build_index (stylesheet);
 		return stylesheet;
 	} else {
 		ccss_stylesheet_unload (stylesheet,
@@ -333,6 +342,7 @@ ccss_grammar_create_stylesheet_from_file (ccss_grammar_t	*self,
 					  void			*user_data)
 {
 	ccss_stylesheet_t	*stylesheet;
+	ccss_arena_t		*arena;
 	enum CRStatus		 ret;
 
 	g_return_val_if_fail (self, NULL);
@@ -341,15 +351,18 @@ ccss_grammar_create_stylesheet_from_file (ccss_grammar_t	*self,
 	stylesheet = ccss_stylesheet_create ();
 	stylesheet->grammar = ccss_grammar_reference (self);
 	stylesheet->current_descriptor++;
+	arena = ccss_stylesheet_create_arena (stylesheet,
+					      stylesheet->current_descriptor);
 
 	ret = ccss_grammar_parse_file (self, css_file,
 				       CCSS_STYLESHEET_AUTHOR,
-				       stylesheet->current_descriptor,
+				       stylesheet->current_descriptor, arena,
 				       user_data,
 				       stylesheet->groups, stylesheet->blocks);
 
 	if (CR_OK == ret) {
 		ccss_stylesheet_fix_dangling_selectors (stylesheet);
+		ccss_stylesheet_build_index (stylesheet);
 		return stylesheet;
 	} else {
 		ccss_stylesheet_unload (stylesheet,
@@ -47,15 +47,38 @@ struct ccss_node_ {
 	CCSS_DEPRECATED (char const	**css_classes);
 	CCSS_DEPRECATED (char const	**pseudo_classes);
 	CCSS_DEPRECATED (char const	 *inline_style);
+	CCSS_DEPRECATED (ccss_atom_t	  type_atom);
+	CCSS_DEPRECATED (ccss_atom_t	  id_atom);
+	CCSS_DEPRECATED (ccss_atom_t const *class_atoms);
+	CCSS_DEPRECATED (ccss_atom_t const *pseudo_class_atoms);
+	CCSS_DEPRECATED (unsigned int	  fetched);
+	CCSS_DEPRECATED (ccss_node_t	 *container);
 };
 
 bool
 ccss_node_is_a			(ccss_node_t		*self,
 				 char const		*type_name);
 
+bool
+ccss_node_is_a_atom		(ccss_node_t		*self,
+				 ccss_atom_t		 type_atom);
+
+bool
+ccss_node_implements_is_a	(ccss_node_t const	*self);
+
 ccss_node_t *
 ccss_node_get_container		(ccss_node_t		*self);
 
+void
+ccss_node_clear_facts		(ccss_node_t		*self);
+
+void
+ccss_node_clear_pseudo_classes	(ccss_node_t		*self);
+
+void
+ccss_node_set_pseudo_classes	(ccss_node_t		 *self,
+				 char const		**pseudo_classes);
+
 ccss_node_t *
 ccss_node_get_base_style	(ccss_node_t		*self);
 
@@ -74,6 +97,18 @@ ccss_node_get_classes           (ccss_node_t 		*self);
 const char **
 ccss_node_get_pseudo_classes    (ccss_node_t 		*self);
 
+ccss_atom_t
+ccss_node_get_type_atom		(ccss_node_t		*self);
+
+ccss_atom_t
+ccss_node_get_id_atom		(ccss_node_t		*self);
+
+ccss_atom_t const *
+ccss_node_get_class_atoms	(ccss_node_t		*self);
+
+ccss_atom_t const *
+ccss_node_get_pseudo_class_atoms (ccss_node_t		*self);
+
 char *
 ccss_node_get_attribute		(ccss_node_t const	*self,
 				 char const		*name);
@@ -103,6 +103,57 @@ release (ccss_node_t *self)
 	return;
 }
 
+static ccss_atom_t
+get_type_atom (ccss_node_t const *self)
+{
+	/* Names that have never been interned can't match any selector. */
+	return g_quark_try_string (ccss_node_get_type ((ccss_node_t *) self));
+}
+
+static ccss_atom_t
+get_id_atom (ccss_node_t const *self)
+{
+	return g_quark_try_string (ccss_node_get_id ((ccss_node_t *) self));
+}
+
+static ccss_atom_t *
+atoms_from_strings (char const **strings)
+{
+	ccss_atom_t	*atoms;
+	unsigned int	 n;
+
+	if (NULL == strings)
+		return NULL;
+
+	for (n = 0; strings[n]; n++)
+		;
+
+	atoms = g_new (ccss_atom_t, n + 1);
+	n = 0;
+	for (; *strings; strings++) {
+		atoms[n] = g_quark_try_string (*strings);
+		if (atoms[n])
+			n++;
+	}
+	atoms[n] = 0;
+
+	return atoms;
+}
+
+static ccss_atom_t const *
+get_class_atoms (ccss_node_t const *self)
+{
+	return atoms_from_strings (
+			ccss_node_get_classes ((ccss_node_t *) self));
+}
+
+static ccss_atom_t const *
+get_pseudo_class_atoms (ccss_node_t const *self)
+{
+	return atoms_from_strings (
+			ccss_node_get_pseudo_classes ((ccss_node_t *) self));
+}
+
 static const ccss_node_class_t _default_node_class = {
 	.is_a			= is_a,
 	.get_container		= get_container,
@@ -115,11 +166,31 @@ static const ccss_node_class_t _default_node_class = {
 	.get_attribute		= get_attribute,
 	.get_style		= get_style,
 	.get_viewport		= get_viewport,
-	.release		= release
+	.release		= release,
+	.get_type_atom		= get_type_atom,
+	.get_id_atom		= get_id_atom,
+	.get_class_atoms	= get_class_atoms,
+	.get_pseudo_class_atoms	= get_pseudo_class_atoms
 };
 
 typedef void (*node_f) (void);
 
+/* Facts cached by the node during a query, remembered even when empty. */
+enum {
+	FETCHED_CONTAINER		= 1 << 0,
+	FETCHED_TYPE			= 1 << 1,
+	FETCHED_INSTANCE		= 1 << 2,
+	FETCHED_ID			= 1 << 3,
+	FETCHED_CLASSES			= 1 << 4,
+	FETCHED_PSEUDO_CLASSES		= 1 << 5,
+	FETCHED_TYPE_ATOM		= 1 << 6,
+	FETCHED_ID_ATOM			= 1 << 7,
+	FETCHED_CLASS_ATOMS		= 1 << 8,
+	FETCHED_PSEUDO_CLASS_ATOMS	= 1 << 9,
+	FETCHED_STYLE			= 1 << 10,
+	OWNS_PSEUDO_CLASS_ATOMS		= 1 << 11	/* Set by ccss_node_set_pseudo_classes() */
+};
+
 /**
  * ccss_node_create:
  * @node_class:	a #ccss_node_class_t vtable.
@@ -149,8 +220,10 @@ ccss_node_create (ccss_node_class_t const       *node_class,
 	user_vtable = (node_f const *) node_class;
 	default_vtable = (node_f const *) &_default_node_class;
 	vtable = (node_f *) self; /* The node class is at the start of the node. */
-	for (unsigned int i = 0; i < n_methods; i++) {
-		if (user_vtable[i])
+	for (unsigned int i = 0; i < CCSS_NODE_CLASS_N_METHODS (_default_node_class); i++) {
+		/* Methods missing from shorter vtables fall back to the
+		 * default implementation as well. */
+		if (i < n_methods && user_vtable[i])
 			vtable[i] = user_vtable[i];
 		else
 			vtable[i] = default_vtable[i];
@@ -170,9 +243,52 @@ ccss_node_create (ccss_node_class_t const       *node_class,
 void
 ccss_node_destroy (ccss_node_t *self)
 {
+	g_return_if_fail (self);
+
+	ccss_node_clear_facts (self);
+	ccss_node_clear_pseudo_classes (self);
+
 	g_free (self);
 }
 
+/*
+ * Fetch the pseudo-classes again on next access, after they changed.
+ */
+void
+ccss_node_clear_pseudo_classes (ccss_node_t *self)
+{
+	g_return_if_fail (self);
+
+	if (self->node_class.get_pseudo_class_atoms == get_pseudo_class_atoms ||
+	    self->fetched & OWNS_PSEUDO_CLASS_ATOMS) {
+		g_free ((ccss_atom_t *) self->pseudo_class_atoms);
+	}
+	self->pseudo_class_atoms = NULL;
+	self->pseudo_classes = NULL;
+	self->fetched &= ~(FETCHED_PSEUDO_CLASSES |
+			   FETCHED_PSEUDO_CLASS_ATOMS |
+			   OWNS_PSEUDO_CLASS_ATOMS);
+}
+
+/*
+ * Query the node as if it had `pseudo_classes' instead of its own, until
+ * ccss_node_clear_pseudo_classes(). The array is not copied.
+ */
+void
+ccss_node_set_pseudo_classes (ccss_node_t	 *self,
+			      char const	**pseudo_classes)
+{
+	g_return_if_fail (self);
+
+	ccss_node_clear_pseudo_classes (self);
+
+	self->pseudo_classes = pseudo_classes;
+	self->pseudo_class_atoms = atoms_from_strings (pseudo_classes);
+	self->fetched |= FETCHED_PSEUDO_CLASSES |
+			 FETCHED_PSEUDO_CLASS_ATOMS |
+			 OWNS_PSEUDO_CLASS_ATOMS;
+}
+
 /**
  * ccss_node_is_a:
  *
@@ -198,6 +314,39 @@ ccss_node_is_a (ccss_node_t	*self,
 	}
 }
 
+/**
+ * ccss_node_is_a_atom:
+ *
+ * Like ccss_node_is_a(), but compares atoms unless the `is_a' function is
+ * implemented.
+ **/
+bool
+ccss_node_is_a_atom (ccss_node_t	*self,
+		     ccss_atom_t	 type_atom)
+{
+	g_return_val_if_fail (self, false);
+	g_return_val_if_fail (type_atom, false);
+
+	if (self->node_class.is_a != is_a) {
+		return self->node_class.is_a (self,
+					      g_quark_to_string (type_atom));
+	} else {
+		return type_atom == ccss_node_get_type_atom (self);
+	}
+}
+
+/*
+ * Whether type matching is implemented by the node, rather than by comparing
+ * the node's type name.
+ */
+bool
+ccss_node_implements_is_a (ccss_node_t const *self)
+{
+	g_return_val_if_fail (self, false);
+
+	return self->node_class.is_a != is_a;
+}
+
 /**
  * ccss_node_get_user_data:
  * @self: a #ccss_node_t.
@@ -214,12 +363,85 @@ ccss_node_get_user_data (ccss_node_t const *self)
 	return self->user_data;
 }
 
+/*
+ * The container is fetched once and owned by `self', so the chain of
+ * containers is materialized once per query, along with the facts cached
+ * by each container.
+ */
 ccss_node_t *
 ccss_node_get_container (ccss_node_t *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	return self->node_class.get_container (self);
+	if (!(self->fetched & FETCHED_CONTAINER)) {
+		self->container = self->node_class.get_container (self);
+		self->fetched |= FETCHED_CONTAINER;
+	}
+
+	return self->container;
+}
+
+/*
+ * Forget the facts fetched from the node class, except pseudo-classes set
+ * through ccss_node_set_pseudo_classes(). Atom arrays derived from strings
+ * are owned by the node.
+ */
+static void
+clear_facts (ccss_node_t *self)
+{
+	if (self->node_class.get_class_atoms == get_class_atoms) {
+		g_free ((ccss_atom_t *) self->class_atoms);
+	}
+	if (!(self->fetched & OWNS_PSEUDO_CLASS_ATOMS)) {
+		ccss_node_clear_pseudo_classes (self);
+	}
+
+	self->instance = 0;
+	self->id = NULL;
+	self->type_name = NULL;
+	self->css_classes = NULL;
+	self->inline_style = NULL;
+	self->type_atom = 0;
+	self->id_atom = 0;
+	self->class_atoms = NULL;
+	self->fetched &= FETCHED_PSEUDO_CLASSES |
+			 FETCHED_PSEUDO_CLASS_ATOMS |
+			 OWNS_PSEUDO_CLASS_ATOMS;
+}
+
+/* Release the materialized chain of containers. */
+static void
+clear_containers (ccss_node_t *self)
+{
+	ccss_node_t *container;
+	ccss_node_t *next;
+
+	container = self->container;
+	self->container = NULL;
+	self->fetched &= ~FETCHED_CONTAINER;
+
+	/* Detach before releasing, in case releasing doesn't destroy. */
+	while (container) {
+		next = container->container;
+		container->container = NULL;
+		container->fetched &= ~FETCHED_CONTAINER;
+		clear_facts (container);
+		ccss_node_release (container);
+		container = next;
+	}
+}
+
+/*
+ * Called when a query returns. Values returned by the node class are only
+ * valid until then, and the document may change before the next query.
+ */
+void
+ccss_node_clear_facts (ccss_node_t *self)
+{
+	g_return_if_fail (self);
+
+	clear_containers (self);
+	clear_facts (self);
 }
 
 ccss_node_t *
@@ -235,8 +457,10 @@ ccss_node_get_type (ccss_node_t		*self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	if (NULL == self->type_name)
+	if (!(self->fetched & FETCHED_TYPE)) {
 		self->type_name = self->node_class.get_type (self);
+		self->fetched |= FETCHED_TYPE;
+	}
 
 	return self->type_name;
 }
@@ -246,8 +470,10 @@ ccss_node_get_instance (ccss_node_t     *self)
 {
 	g_return_val_if_fail (self, 0);
 
-	if (0 == self->instance)
+	if (!(self->fetched & FETCHED_INSTANCE)) {
 		self->instance = self->node_class.get_instance (self);
+		self->fetched |= FETCHED_INSTANCE;
+	}
 
 	return self->instance;
 }
@@ -257,8 +483,10 @@ ccss_node_get_id (ccss_node_t   *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	if (NULL == self->id)
+	if (!(self->fetched & FETCHED_ID)) {
 		self->id = self->node_class.get_id (self);
+		self->fetched |= FETCHED_ID;
+	}
 
 	return self->id;
 }
@@ -268,8 +496,10 @@ ccss_node_get_classes (ccss_node_t      *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	if (NULL == self->css_classes)
+	if (!(self->fetched & FETCHED_CLASSES)) {
 		self->css_classes = self->node_class.get_classes (self);
+		self->fetched |= FETCHED_CLASSES;
+	}
 
 	return self->css_classes;
 }
@@ -279,12 +509,92 @@ ccss_node_get_pseudo_classes (ccss_node_t       *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	if (NULL == self->pseudo_classes)
+	if (!(self->fetched & FETCHED_PSEUDO_CLASSES)) {
 		self->pseudo_classes = self->node_class.get_pseudo_classes (self);
+		self->fetched |= FETCHED_PSEUDO_CLASSES;
+	}
 
 	return self->pseudo_classes;
 }
 
+ccss_atom_t
+ccss_node_get_type_atom (ccss_node_t	*self)
+{
+	g_return_val_if_fail (self, 0);
+
+	if (!(self->fetched & FETCHED_TYPE_ATOM)) {
+		self->type_atom = self->node_class.get_type_atom (self);
+		self->fetched |= FETCHED_TYPE_ATOM;
+	}
+
+	return self->type_atom;
+}
+
+ccss_atom_t
+ccss_node_get_id_atom (ccss_node_t	*self)
+{
+	g_return_val_if_fail (self, 0);
+
+	if (!(self->fetched & FETCHED_ID_ATOM)) {
+		self->id_atom = self->node_class.get_id_atom (self);
+		self->fetched |= FETCHED_ID_ATOM;
+	}
+
+	return self->id_atom;
+}
+
+ccss_atom_t const *
+ccss_node_get_class_atoms (ccss_node_t	*self)
+{
+	g_return_val_if_fail (self, NULL);
+
+	if (!(self->fetched & FETCHED_CLASS_ATOMS)) {
+		self->class_atoms = self->node_class.get_class_atoms (self);
+		self->fetched |= FETCHED_CLASS_ATOMS;
+	}
+
+	return self->class_atoms;
+}
+
+ccss_atom_t const *
+ccss_node_get_pseudo_class_atoms (ccss_node_t	*self)
+{
+	g_return_val_if_fail (self, NULL);
+
+	if (!(self->fetched & FETCHED_PSEUDO_CLASS_ATOMS)) {
+		self->pseudo_class_atoms = self->node_class.get_pseudo_class_atoms (self);
+		self->fetched |= FETCHED_PSEUDO_CLASS_ATOMS;
+	}
+
+	return self->pseudo_class_atoms;
+}
+
+/**
+ * ccss_atom_from_string:
+ * @string:	a string.
+ *
+ * Intern @string.
+ *
+ * Returns: the atom representing @string, or 0 for %NULL.
+ **/
+ccss_atom_t
+ccss_atom_from_string (char const *string)
+{
+	return g_quark_from_string (string);
+}
+
+/**
+ * ccss_atom_to_string:
+ * @atom:	a #ccss_atom_t.
+ *
+ * Returns: the string represented by @atom, or %NULL for 0.
+ **/
+char const *
+ccss_atom_to_string (ccss_atom_t atom)
+{
+	return g_quark_to_string (atom);
+}
+
 char *
 ccss_node_get_attribute (ccss_node_t const	*self,
 			 char const		*name)
@@ -300,9 +610,11 @@ ccss_node_get_style (ccss_node_t	*self,
 {
 	g_return_val_if_fail (self, NULL);
 
-	if (NULL == self->inline_style)
+	if (!(self->fetched & FETCHED_STYLE)) {
 		self->inline_style = self->node_class.get_style (self,
 								 descriptor);
+		self->fetched |= FETCHED_STYLE;
+	}
 
 	return self->inline_style;
 }
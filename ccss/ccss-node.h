@@ -31,6 +31,20 @@ CCSS_BEGIN_DECLS
 
 typedef struct ccss_node_ ccss_node_t;
 
+/**
+ * ccss_atom_t:
+ *
+ * Integer representation of an interned string, compatible with #GQuark.
+ * The atom 0 does not represent any string.
+ **/
+typedef uint32_t ccss_atom_t;
+
+ccss_atom_t
+ccss_atom_from_string	(char const	*string);
+
+char const *
+ccss_atom_to_string	(ccss_atom_t	 atom);
+
 /** 
  * ccss_node_is_a_f:
  * @self:	a #ccss_node_t.
@@ -163,6 +177,51 @@ typedef bool (*ccss_node_get_viewport_f) (ccss_node_t const     *self,
 					  double		*width,
 					  double		*height);
 
+/**
+ * ccss_node_get_type_atom_f:
+ * @self:	a #ccss_node_t.
+ *
+ * Optional hook function to query the type name of a #ccss_node_t as an
+ * atom, see ccss_atom_from_string(). Saves the selection engine from
+ * interning the name returned by #ccss_node_get_type_f.
+ *
+ * Returns: node type atom or 0.
+ **/
+typedef ccss_atom_t (*ccss_node_get_type_atom_f) (ccss_node_t const *self);
+
+/**
+ * ccss_node_get_id_atom_f:
+ * @self:	a #ccss_node_t.
+ *
+ * Optional hook function to query the ID of a #ccss_node_t as an atom.
+ *
+ * Returns: node ID atom or 0.
+ **/
+typedef ccss_atom_t (*ccss_node_get_id_atom_f) (ccss_node_t const *self);
+
+/**
+ * ccss_node_get_class_atoms_f:
+ * @self:	a #ccss_node_t.
+ *
+ * Optional hook function to query the class names of a #ccss_node_t as atoms.
+ *
+ * Returns: 0-terminated array of class atoms or %NULL.
+ * The returned values must be valid until the current stylesheet query returns.
+ **/
+typedef ccss_atom_t const * (*ccss_node_get_class_atoms_f) (ccss_node_t const *self);
+
+/**
+ * ccss_node_get_pseudo_class_atoms_f:
+ * @self:	a #ccss_node_t.
+ *
+ * Optional hook function to query the pseudo-class names of a #ccss_node_t
+ * as atoms.
+ *
+ * Returns: 0-terminated array of pseudo-class atoms or %NULL.
+ * The returned values must be valid until the current stylesheet query returns.
+ **/
+typedef ccss_atom_t const * (*ccss_node_get_pseudo_class_atoms_f) (ccss_node_t const *self);
+
 /** 
  * ccss_node_release_f:
  * @self:	a #ccss_node_t.
@@ -185,12 +244,18 @@ typedef void (*ccss_node_release_f) (ccss_node_t *self);
  * @get_style:		a #ccss_node_get_style_f.
  * @get_viewport:	a #ccss_node_get_viewport_f.
  * @release:		a #ccss_node_release_f.
+ * @get_type_atom:	a #ccss_node_get_type_atom_f.
+ * @get_id_atom:	a #ccss_node_get_id_atom_f.
+ * @get_class_atoms:	a #ccss_node_get_class_atoms_f.
+ * @get_pseudo_class_atoms: a #ccss_node_get_pseudo_class_atoms_f.
  *
  * Dispatch table a CCSS consumer has to fill so the selection engine can 
  * retrieve information about the document the document.
  *
  * The implemented dispatch table needs to be passed to #ccss_node_create.
  * All fields have to be initialised to either a node function or %NULL.
+ * The atom based functions are optional, if they are not implemented the
+ * atoms are derived from the corresponding string based functions.
  **/
 typedef struct {
 	ccss_node_is_a_f		is_a;
@@ -205,6 +270,10 @@ typedef struct {
 	ccss_node_get_style_f		get_style;
 	ccss_node_get_viewport_f	get_viewport;
 	ccss_node_release_f		release;
+	ccss_node_get_type_atom_f	get_type_atom;
+	ccss_node_get_id_atom_f		get_id_atom;
+	ccss_node_get_class_atoms_f	get_class_atoms;
+	ccss_node_get_pseudo_class_atoms_f get_pseudo_class_atoms;
 } ccss_node_class_t;
 
 /**
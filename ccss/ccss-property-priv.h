@@ -0,0 +1,99 @@
+/* vim: set ts=8 sw=8 noexpandtab: */
+
+/* The `C' CSS Library.
+ * Copyright (C) 2008 Robert Staudinger
+ *
+ * This  library is free  software; you can  redistribute it and/or
+ * modify it  under  the terms  of the  GNU Lesser  General  Public
+ * License  as published  by the Free  Software  Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed  in the hope that it will be useful,
+ * but  WITHOUT ANY WARRANTY; without even  the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License  along  with  this library;  if not,  write to  the Free
+ * Software Foundation, Inc., 51  Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CCSS_PROPERTY_PRIV_H
+#define CCSS_PROPERTY_PRIV_H
+
+#include <glib.h>
+#include <ccss/ccss-macros.h>
+
+CCSS_BEGIN_DECLS
+
+/*
+ * Styles store their properties in arrays indexed by property slot.
+ * Slots are small integers, assigned to property names when a grammar
+ * registers them, or when a block first uses a name the grammar doesn't
+ * know. Slot 0 is never assigned.
+ *
+ * The map from GQuark to slot is a chain of open addressing tables that
+ * are only ever inserted into, so it can be read without locking. When the
+ * newest table is half full a table twice its size is put in front of it,
+ * entries are never moved or freed.
+ */
+typedef struct {
+	GQuark		id;
+	unsigned int	slot;
+} ccss_property_slot_entry_t;
+
+typedef struct ccss_property_slots_ ccss_property_slots_t;
+struct ccss_property_slots_ {
+	ccss_property_slots_t const	*next;		/* Older, smaller table */
+	unsigned int			 mask;		/* Size - 1 */
+	unsigned int			 n_entries;
+	ccss_property_slot_entry_t	 entries[1];
+};
+
+ccss_property_slots_t const *
+ccss_property_slots_get (void);
+
+unsigned int
+ccss_property_slots_get_n_slots (void);
+
+unsigned int
+ccss_property_slots_assign (GQuark property_id);
+
+static inline unsigned int
+ccss_property_slots_hash (GQuark property_id)
+{
+	/* Fibonacci hashing, quarks are sequential. */
+	return property_id * 2654435761u;
+}
+
+/*
+ * Look up the slot of `property_id' in `self' and the tables after it.
+ * Entries are published by setting their id last.
+ */
+static inline unsigned int
+ccss_property_slots_lookup (ccss_property_slots_t const	*self,
+			    GQuark			 property_id)
+{
+	ccss_property_slot_entry_t const	*entry;
+	unsigned int				 i;
+	GQuark					 id;
+
+	for (; self; self = self->next) {
+		i = ccss_property_slots_hash (property_id) & self->mask;
+		while (0 != (id = (GQuark) g_atomic_int_get (
+				(int volatile *) &self->entries[i].id))) {
+			entry = &self->entries[i];
+			if (id == property_id)
+				return entry->slot;
+			i = (i + 1) & self->mask;
+		}
+	}
+
+	return 0;
+}
+
+CCSS_END_DECLS
+
+#endif /* CCSS_PROPERTY_PRIV_H */
+
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <glib.h>
 #include "ccss-property-impl.h"
+#include "ccss-property-priv.h"
 #include "config.h"
 
 /**
@@ -54,6 +55,86 @@ ccss_property_destroy (ccss_property_t *self)
 	self->vtable->destroy (self);
 }
 
+#define N_SLOT_ENTRIES_MIN 64
+
+G_LOCK_DEFINE_STATIC (_slots);
+static ccss_property_slots_t *_slots = NULL;
+static unsigned int _n_slots = 1;
+
+/* Newest table of the slot map, see ccss_property_slots_lookup(). */
+ccss_property_slots_t const *
+ccss_property_slots_get (void)
+{
+	return (ccss_property_slots_t const *) g_atomic_pointer_get (&_slots);
+}
+
+/* Upper bound of the assigned slots. */
+unsigned int
+ccss_property_slots_get_n_slots (void)
+{
+	return (unsigned int) g_atomic_int_get ((int volatile *) &_n_slots);
+}
+
+/* Put an empty table of `n_entries' in front of the chain. Call with the
+ * lock held. */
+static void
+slots_grow (unsigned int n_entries)
+{
+	ccss_property_slots_t *slots;
+
+	slots = g_malloc0 (sizeof (ccss_property_slots_t) +
+			   (n_entries - 1) * sizeof (ccss_property_slot_entry_t));
+	slots->next = _slots;
+	slots->mask = n_entries - 1;
+	g_atomic_pointer_set (&_slots, slots);
+}
+
+/*
+ * Look up the slot of a property name, assign one if it hasn't got one yet.
+ */
+unsigned int
+ccss_property_slots_assign (GQuark property_id)
+{
+	ccss_property_slot_entry_t	*entry;
+	unsigned int			 i;
+	unsigned int			 slot;
+
+	g_assert (property_id);
+
+	slot = ccss_property_slots_lookup (ccss_property_slots_get (),
+					   property_id);
+	if (slot)
+		return slot;
+
+	G_LOCK (_slots);
+
+	slot = ccss_property_slots_lookup (_slots, property_id);
+	if (0 == slot) {
+		/* Keep the newest table at most half full. */
+		if (NULL == _slots) {
+			slots_grow (N_SLOT_ENTRIES_MIN);
+		} else if (2 * (_slots->n_entries + 1) > _slots->mask + 1) {
+			slots_grow (2 * (_slots->mask + 1));
+		}
+
+		i = ccss_property_slots_hash (property_id) & _slots->mask;
+		while (_slots->entries[i].id) {
+			i = (i + 1) & _slots->mask;
+		}
+
+		slot = _n_slots;
+		entry = &_slots->entries[i];
+		entry->slot = slot;
+		g_atomic_int_set ((int volatile *) &entry->id, property_id);
+		_slots->n_entries++;
+		g_atomic_int_set ((int volatile *) &_n_slots, slot + 1);
+	}
+
+	G_UNLOCK (_slots);
+
+	return slot;
+}
+
 /**
  * ccss_property_get_state:
  * @self: a #ccss_property_t.
@@ -20,7 +20,10 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <glib.h>
+#include "ccss-node-priv.h"
 #include "ccss-selector-group.h"
 #include "config.h"
 
@@ -28,11 +31,34 @@ typedef struct {
 	GSList *selectors;
 } ccss_selector_set_t;
 
+/*
+ * Compacted form of the group, used for all traversals except unloading.
+ * `selectors' is sorted by ascending specificity, most recently added first
+ * among equal specificities; that is the order of walking the tree.
+ * The buckets hold positions in `selectors', keyed by the most selective part
+ * of the selectors' rightmost compound selector, see
+ * ccss_selector_get_index_key(). Sorting candidate positions restores the
+ * order of `selectors'.
+ * `ancestor_hashes' and `programs' run parallel to `selectors', see
+ * ccss_selector_get_ancestor_hashes() and ccss_selector_compile().
+ */
+typedef struct {
+	ccss_selector_t const	**selectors;
+	ccss_ancestor_hashes_t	 *ancestor_hashes;
+	ccss_selector_program_t	**programs;
+	unsigned int		  n_selectors;
+	GArray			 *unkeyed;
+	GHashTable		 *ids;
+	GHashTable		 *classes;
+	GHashTable		 *pseudo_classes;
+} ccss_selector_index_t;
+
 struct ccss_selector_group_ {
-	GTree		*sets;
-	unsigned int	 n_selectors;
-	unsigned int	 min_specificity_e;
-	GSList		*dangling_selectors;
+	GTree			*sets;
+	unsigned int		 n_selectors;
+	unsigned int		 min_specificity_e;
+	GSList			*dangling_selectors;
+	ccss_selector_index_t	*index;
 };
 
 static int
@@ -61,6 +87,44 @@ free_set (ccss_selector_set_t *set)
 	g_free (set);
 }
 
+static void
+free_bucket (GArray *bucket)
+{
+	g_array_free (bucket, true);
+}
+
+static void
+index_destroy (ccss_selector_index_t *index)
+{
+	g_assert (index);
+
+	for (unsigned int i = 0; i < index->n_selectors; i++) {
+		ccss_selector_program_destroy (index->programs[i]);
+	}
+	g_free (index->programs);
+	g_free (index->selectors);
+	g_free (index->ancestor_hashes);
+	g_array_free (index->unkeyed, true);
+	g_hash_table_destroy (index->ids);
+	g_hash_table_destroy (index->classes);
+	g_hash_table_destroy (index->pseudo_classes);
+	g_free (index);
+}
+
+/*
+ * The index references the selectors held by the group, so it is dropped
+ * whenever the group changes. It is rebuilt by
+ * ccss_selector_group_build_index() after loading, or lazily on the next
+ * traversal.
+ */
+static void
+invalidate_index (ccss_selector_group_t *self)
+{
+	if (self->index) {
+		index_destroy (self->index), self->index = NULL;
+	}
+}
+
 /**
  * ccss_selector_group_create:
  *
@@ -94,6 +158,7 @@ ccss_selector_group_destroy (ccss_selector_group_t *self)
 {
 	g_assert (self);
 
+	invalidate_index (self);
 	g_tree_destroy (self->sets), self->sets = NULL;
 	g_free (self);
 }
@@ -101,6 +166,7 @@ ccss_selector_group_destroy (ccss_selector_group_t *self)
 typedef struct {
 	unsigned int     descriptor;
 	GSList		*empty_sets;
+	unsigned int	 n_removed;
 	bool		 ret;
 } traverse_unload_info_t;
 
@@ -134,6 +200,7 @@ traverse_unload (size_t			 specificity,
 			} else {
 				iter = g_slist_delete_link (iter, iter);
 			}
+			info->n_removed++;
 			info->ret = true;
 		} else {
 			iter = iter->next;
@@ -164,6 +231,7 @@ ccss_selector_group_unload (ccss_selector_group_t	*self,
 
 	info.descriptor = descriptor;
 	info.empty_sets = NULL;
+	info.n_removed = 0;
 	info.ret = false;
 
 	g_tree_foreach (self->sets, (GTraverseFunc) traverse_unload, &info);
@@ -175,6 +243,11 @@ ccss_selector_group_unload (ccss_selector_group_t	*self,
 		iter = g_slist_delete_link (iter, iter);
 	}
 
+	if (info.ret) {
+		self->n_selectors -= info.n_removed;
+		invalidate_index (self);
+	}
+
 	return info.ret;
 }
 
@@ -199,68 +272,29 @@ ccss_selector_group_add_selector (ccss_selector_group_t	*self,
 	}
 	set->selectors = g_slist_prepend (set->selectors, selector);
 	self->n_selectors++;
+
+	invalidate_index (self);
 }
 
 static unsigned int
-calculate_min_specificity_e (ccss_selector_group_t	*group,
-			     unsigned int		 n_specificities)
+calculate_min_specificity_e (unsigned int	*min_specificity_e,
+			     unsigned int	 n_specificities)
 {
 	unsigned int specificity_e;
 
 	/* The tree is walked in order, so we remember how many
 	 * specificities `e' will be required to insert the merged selectors at
-	 * the right place. `- 1' because "group->min_specificity_e" already has
+	 * the right place. `- 1' because "min_specificity_e" already has
 	 * the next free value. */
-	g_assert (((signed) group->min_specificity_e - (signed) n_specificities - 1) >= 0);
-	specificity_e = group->min_specificity_e - n_specificities - 1;
+	g_assert (((signed) *min_specificity_e - (signed) n_specificities - 1) >= 0);
+	specificity_e = *min_specificity_e - n_specificities - 1;
 
-	group->min_specificity_e -= n_specificities;
-	g_assert (group->min_specificity_e >= 0);
+	*min_specificity_e -= n_specificities;
+	g_assert (*min_specificity_e >= 0);
 
 	return specificity_e;
 }
 
-typedef struct {
-	ccss_selector_group_t	*self;
-	unsigned int		 specificity_e;
-} traverse_merge_info_t;
-
-static bool
-traverse_merge (size_t			 	 specificity,
-		ccss_selector_set_t const	*set,
-		traverse_merge_info_t		*info)
-{
-	ccss_selector_t const	*selector;
-	ccss_selector_t		*new_selector;
-
-	g_assert (info->self && set);
-
-	for (GSList const *iter = set->selectors; iter != NULL; iter = iter->next) {
-		selector = (ccss_selector_t const *) iter->data;
-		new_selector = ccss_selector_copy_as_base (selector, info->specificity_e);
-		ccss_selector_group_add_selector (info->self, new_selector);
-	}
-
-	info->specificity_e++;
-
-	return false;
-}
-
-void
-ccss_selector_group_merge_as_base (ccss_selector_group_t	*self,
-				   ccss_selector_group_t const	*group)
-{
-	traverse_merge_info_t info;
-
-	g_assert (self && group);
-
-	info.self = self;
-	info.specificity_e = calculate_min_specificity_e (self,
-				self->n_selectors);
-
-	g_tree_foreach (group->sets, (GTraverseFunc) traverse_merge, &info);
-}
-
 GSList const *
 ccss_selector_group_get_dangling_selectors (ccss_selector_group_t const *self)
 {
@@ -287,137 +321,405 @@ ccss_selector_group_clear_dangling_selectors (ccss_selector_group_t *self)
 	self->dangling_selectors = NULL;
 }
 
-typedef struct {
-	ccss_node_t 		*node;
-	ccss_selector_group_t	*result_group;
-	bool			 as_base;
-	unsigned int		 specificity_e;
-	bool			 ret;
-} traverse_query_info_t;
+static GArray *
+lookup_bucket (GHashTable	*buckets,
+	       ccss_atom_t	 atom)
+{
+	GArray *bucket;
+
+	bucket = (GArray *) g_hash_table_lookup (buckets,
+						 GUINT_TO_POINTER (atom));
+	if (NULL == bucket) {
+		bucket = g_array_new (false, false, sizeof (unsigned int));
+		g_hash_table_insert (buckets, GUINT_TO_POINTER (atom), bucket);
+	}
+
+	return bucket;
+}
 
 static bool
-traverse_query (size_t			 specificity,
+traverse_index (size_t			 specificity,
 		ccss_selector_set_t	*set,
-		traverse_query_info_t	*info)
+		ccss_selector_index_t	*index)
 {
-	ccss_selector_t const	*selector;
-	ccss_selector_t		*new_selector;
-	GSList const		*iter;
-	bool			 ret;
+	ccss_selector_t	const	*selector;
+	ccss_atom_t		 atom;
+	GArray			*bucket;
+	unsigned int		 position;
+
+	for (GSList const *iter = set->selectors; iter != NULL; iter = iter->next) {
 
-	iter = set->selectors;
-	while (iter) {
 		selector = (ccss_selector_t const *) iter->data;
-		ret = ccss_selector_query (selector, info->node);
-		if (ret) {
-			if (info->as_base) {
-				new_selector = ccss_selector_copy_as_base (selector, info->specificity_e);
-				info->specificity_e++;
-			} else {
-				new_selector = ccss_selector_copy (selector);
-			}
-			ccss_selector_group_add_selector (info->result_group, new_selector);
-			info->ret = true;
+		position = index->n_selectors++;
+		index->selectors[position] = selector;
+		ccss_selector_get_ancestor_hashes (selector,
+				&index->ancestor_hashes[position]);
+		index->programs[position] = ccss_selector_compile (selector);
+
+		bucket = NULL;
+		switch (ccss_selector_get_index_key (selector, &atom)) {
+		case CCSS_SELECTOR_KEY_NONE:
+			bucket = index->unkeyed;
+			break;
+		case CCSS_SELECTOR_KEY_ID:
+			bucket = lookup_bucket (index->ids, atom);
+			break;
+		case CCSS_SELECTOR_KEY_CLASS:
+			bucket = lookup_bucket (index->classes, atom);
+			break;
+		case CCSS_SELECTOR_KEY_PSEUDO_CLASS:
+			bucket = lookup_bucket (index->pseudo_classes, atom);
+			break;
 		}
-		iter = iter->next;
+		g_assert (bucket);
+
+		g_array_append_val (bucket, position);
 	}
 
 	return false;
 }
 
-bool
-ccss_selector_group_query (ccss_selector_group_t const	*self,
-			   ccss_node_t			*node,
-			   bool				 as_base,
-			   ccss_selector_group_t	*result_group)
+/**
+ * ccss_selector_group_build_index:
+ * @self:	a #ccss_selector_group_t.
+ *
+ * Build the compacted, sorted form of the group that all traversals use,
+ * and bucket the selectors by their ID, class or pseudo-class, so queries only
+ * need to test selectors that can possibly match a node.
+ * Modifying the group drops the index, it should be rebuilt after loading or
+ * unloading CSS. Does nothing if the index is up to date.
+ **/
+void
+ccss_selector_group_build_index (ccss_selector_group_t *self)
 {
-	traverse_query_info_t info;
+	ccss_selector_index_t *index;
 
-	g_assert (self && self->sets && node && result_group);
+	g_return_if_fail (self);
 
-	info.node = node;
-	info.result_group = result_group;
-	info.as_base = as_base;
-	if (as_base) {
-		info.specificity_e = calculate_min_specificity_e (result_group,
+	if (self->index)
+		return;
+
+	index = g_new0 (ccss_selector_index_t, 1);
+	index->selectors = g_new (ccss_selector_t const *, self->n_selectors);
+	index->ancestor_hashes = g_new (ccss_ancestor_hashes_t,
 					self->n_selectors);
+	index->programs = g_new (ccss_selector_program_t *,
+				 self->n_selectors);
+	index->n_selectors = 0;
+	index->unkeyed = g_array_new (false, false, sizeof (unsigned int));
+	index->ids = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					    NULL, (GDestroyNotify) free_bucket);
+	index->classes = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						NULL, (GDestroyNotify) free_bucket);
+	index->pseudo_classes = g_hash_table_new_full (g_direct_hash,
+					g_direct_equal, NULL,
+					(GDestroyNotify) free_bucket);
+
+	g_tree_foreach (self->sets, (GTraverseFunc) traverse_index, index);
+	g_assert (index->n_selectors == self->n_selectors);
+
+	self->index = index;
+}
+
+static ccss_selector_index_t const *
+get_index (ccss_selector_group_t const *self)
+{
+	if (NULL == self->index) {
+		/* The index is a cache, building it doesn't modify the
+		 * group in a way visible to the outside.
+		 * Stylesheets build their indexes right after loading, so
+		 * concurrent queries never get here. */
+		ccss_selector_group_build_index ((ccss_selector_group_t *) self);
 	}
-	info.ret = false;
 
-	g_tree_foreach (self->sets, (GTraverseFunc) traverse_query, &info);
+	return self->index;
+}
 
-	return info.ret;
+void
+ccss_selector_group_merge_as_base (ccss_selector_group_t	*self,
+				   ccss_selector_group_t const	*group)
+{
+	ccss_selector_index_t const	*index;
+	ccss_selector_t			*new_selector;
+	unsigned int			 specificity_e;
+
+	g_assert (self && group && self != group);
+
+	specificity_e = calculate_min_specificity_e (&self->min_specificity_e,
+						     self->n_selectors);
+
+	/* Every specificity of `group' is assigned its own `e'. */
+	index = get_index (group);
+	for (unsigned int i = 0; i < index->n_selectors; i++) {
+		if (i > 0 &&
+		    ccss_selector_get_specificity (index->selectors[i]) !=
+		    ccss_selector_get_specificity (index->selectors[i - 1])) {
+			specificity_e++;
+		}
+		new_selector = ccss_selector_copy_as_base (index->selectors[i],
+							   specificity_e);
+		ccss_selector_group_add_selector (self, new_selector);
+	}
 }
 
 typedef struct {
-	char const		*type_name;
-	ccss_node_t const	*node;
-	ccss_style_t		*style;
-	bool			 ret;
-} traverse_apply_info_t;
+	ccss_node_t 			*node;
+	ccss_ancestor_filter_t		**filter;
+	ccss_selector_match_list_t	*matches;
+	bool				 as_base;
+	unsigned int			 specificity_e;
+	bool				 ret;
+} traverse_query_info_t;
 
+/*
+ * Rule out selectors whose child and descendant parts can't be satisfied by
+ * the node's containers. The filter is only built once needed.
+ */
 static bool
-traverse_apply (size_t			 specificity,
-		ccss_selector_set_t	*set,
-		traverse_apply_info_t	*info)
+may_match_ancestors (ccss_ancestor_hashes_t const	*hashes,
+		     traverse_query_info_t		*info)
 {
-	ccss_selector_t const	*selector;
+	if (0 == hashes->n_hashes)
+		return true;
 
-	for (GSList const *iter = set->selectors; iter != NULL; iter = iter->next) {
-	
-		selector = (ccss_selector_t const *) iter->data;
-		if (info->type_name) {
+	if (NULL == *info->filter) {
+		*info->filter = ccss_ancestor_filter_create_for_node (
+								info->node);
+	}
 
-			/* Apply only if it's a specific type. */
-			char const *key;
-			unsigned int a, b, c, d, e;
+	return ccss_ancestor_filter_may_match (*info->filter, hashes);
+}
 
-			key = ccss_selector_get_key (selector);
-			ccss_selector_get_specificity_values (selector,
-							     &a, &b, &c, &d, &e);
+static int
+compare_selector (ccss_selector_t const * const	*selector1,
+		  ccss_selector_t const * const	*selector2)
+{
+	return *selector1 < *selector2 ? -1 : *selector1 > *selector2;
+}
 
-			if (ccss_selector_is_type (selector) &&
-			    0 == g_strcmp0 (info->type_name, key) &&
-			    a == 0 && b == 0 && c == 0 && d == 1 && e == 0) {
+/*
+ * Whether a selector that doesn't refer to any changed pseudo-class matched
+ * when restyling.
+ */
+static bool
+matched_previously (ccss_selector_match_list_t const	*matches,
+		    ccss_selector_t const		*selector)
+{
+	return NULL != bsearch (&selector, matches->previous,
+				matches->n_previous,
+				sizeof (ccss_selector_t const *),
+				(int (*) (void const *, void const *))
+					compare_selector);
+}
 
-				info->ret |= ccss_selector_apply (selector,
-								  info->node,
-								  info->style);
-			}
+static void
+query_selector (ccss_selector_t const		*selector,
+		ccss_selector_program_t const	*program,
+		ccss_ancestor_hashes_t const	*hashes,
+		traverse_query_info_t		*info)
+{
+	ccss_selector_match_list_t const	*matches;
+	uint32_t				 specificity;
+	bool					 ret;
+
+	matches = info->matches;
+	if (matches->previous &&
+	    !ccss_selector_program_may_refer_to (program,
+						 matches->changed_mask)) {
+		ret = matched_previously (matches, selector);
+	} else {
+		ret = may_match_ancestors (hashes, info) &&
+		      ccss_selector_program_query (program, info->node);
+	}
 
+	if (ret) {
+		if (info->as_base) {
+			specificity = ccss_selector_get_specificity_as_base (
+						selector, info->specificity_e);
+			info->specificity_e++;
 		} else {
-			info->ret |= ccss_selector_apply (selector,
-							  info->node,
-							  info->style);
+			specificity = ccss_selector_get_specificity (selector);
 		}
+		ccss_selector_match_list_append (info->matches, selector,
+						 specificity);
+		info->ret = true;
 	}
+}
 
-	return false;
+#define N_PREALLOCATED_CANDIDATES (64)
+
+/*
+ * Positions of the selectors that may match a node. Like the match list it
+ * lives on the stack and only spills to the heap for large candidate sets.
+ */
+typedef struct {
+	unsigned int	*positions;
+	unsigned int	 n_positions;
+	unsigned int	 n_allocated;
+	unsigned int	 preallocated[N_PREALLOCATED_CANDIDATES];
+} candidate_list_t;
+
+static void
+candidate_list_init (candidate_list_t *self)
+{
+	self->positions = self->preallocated;
+	self->n_positions = 0;
+	self->n_allocated = G_N_ELEMENTS (self->preallocated);
+}
+
+static void
+candidate_list_clear (candidate_list_t *self)
+{
+	if (self->positions != self->preallocated) {
+		g_free (self->positions);
+	}
+	candidate_list_init (self);
+}
+
+static void
+candidate_list_append (candidate_list_t		*self,
+		       unsigned int const	*positions,
+		       unsigned int		 n_positions)
+{
+	unsigned int n_needed;
+
+	n_needed = self->n_positions + n_positions;
+	if (n_needed > self->n_allocated) {
+		while (self->n_allocated < n_needed) {
+			self->n_allocated *= 2;
+		}
+		if (self->positions == self->preallocated) {
+			self->positions = g_new (unsigned int,
+						 self->n_allocated);
+			memcpy (self->positions, self->preallocated,
+				self->n_positions * sizeof (unsigned int));
+		} else {
+			self->positions = g_renew (unsigned int,
+						   self->positions,
+						   self->n_allocated);
+		}
+	}
+
+	memcpy (&self->positions[self->n_positions], positions,
+		n_positions * sizeof (unsigned int));
+	self->n_positions = n_needed;
+}
+
+static void
+append_bucket (candidate_list_t	*candidates,
+	       GHashTable	*buckets,
+	       ccss_atom_t	 atom)
+{
+	GArray const *bucket;
+
+	bucket = (GArray const *) g_hash_table_lookup (buckets,
+						       GUINT_TO_POINTER (atom));
+	if (bucket) {
+		candidate_list_append (candidates,
+				       (unsigned int const *) bucket->data,
+				       bucket->len);
+	}
+}
+
+static int
+compare_position (unsigned int const	*position1,
+		  unsigned int const	*position2)
+{
+	return *position1 < *position2 ? -1 : *position1 > *position2;
+}
+
+static void
+index_query (ccss_selector_index_t const	*index,
+	     traverse_query_info_t		*info)
+{
+	candidate_list_t	 candidates;
+	ccss_atom_t		 id;
+	ccss_atom_t const	*atoms;
+	unsigned int		 position;
+
+	candidate_list_init (&candidates);
+	candidate_list_append (&candidates,
+			       (unsigned int const *) index->unkeyed->data,
+			       index->unkeyed->len);
+
+	/* Only bother the node for information that is actually indexed. */
+	if (g_hash_table_size (index->ids)) {
+		id = ccss_node_get_id_atom (info->node);
+		if (id) {
+			append_bucket (&candidates, index->ids, id);
+		}
+	}
+
+	if (g_hash_table_size (index->classes)) {
+		atoms = ccss_node_get_class_atoms (info->node);
+		for (; atoms && *atoms; atoms++) {
+			append_bucket (&candidates, index->classes, *atoms);
+		}
+	}
+
+	if (g_hash_table_size (index->pseudo_classes)) {
+		atoms = ccss_node_get_pseudo_class_atoms (info->node);
+		for (; atoms && *atoms; atoms++) {
+			append_bucket (&candidates, index->pseudo_classes,
+				       *atoms);
+		}
+	}
+
+	/* Restore traversal order, so results are the same as when walking
+	 * the whole tree. Duplicates stem from duplicate node classes. */
+	qsort (candidates.positions, candidates.n_positions,
+	       sizeof (unsigned int),
+	       (int (*) (void const *, void const *)) compare_position);
+	for (unsigned int i = 0; i < candidates.n_positions; i++) {
+		position = candidates.positions[i];
+		if (i > 0 && position == candidates.positions[i - 1])
+			continue;
+		query_selector (index->selectors[position],
+				index->programs[position],
+				&index->ancestor_hashes[position], info);
+	}
+
+	candidate_list_clear (&candidates);
 }
 
 /**
- * ccss_selector_group_apply:
+ * ccss_selector_group_query:
  * @self:	a #ccss_selector_group_t.
  * @node:	a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
- * @style:	a #ccss_style_t.
+ * @as_base:	whether @self holds the selectors of a base style of @node.
+ * @filter:	a #ccss_ancestor_filter_t describing the containers of @node.
+ *		If *@filter is %NULL a filter is created on demand and
+ *		returned for reuse, the caller must free it.
+ * @matches:	a #ccss_selector_match_list_t to append matching selectors to.
  *
- * Apply the styling information held by #self to #style.
+ * Collect the selectors matching @node. The selectors are not copied, so
+ * @matches is valid only as long as @self is not modified.
+ *
+ * Returns: %TRUE if any selector matched.
  **/
 bool
-ccss_selector_group_apply (ccss_selector_group_t const	*self,
-			   ccss_node_t const		*node,
-			   ccss_style_t			*style)
+ccss_selector_group_query (ccss_selector_group_t const	*self,
+			   ccss_node_t			*node,
+			   bool				 as_base,
+			   ccss_ancestor_filter_t	**filter,
+			   ccss_selector_match_list_t	*matches)
 {
-	traverse_apply_info_t info;
+	traverse_query_info_t info;
 
-	g_assert (self && self->sets && style);
+	g_assert (self && self->sets && node && filter && matches);
 
-	info.type_name = NULL;
 	info.node = node;
-	info.style = style;
+	info.filter = filter;
+	info.matches = matches;
+	info.as_base = as_base;
+	if (as_base) {
+		info.specificity_e = calculate_min_specificity_e (
+					&matches->min_specificity_e,
+					self->n_selectors);
+	}
 	info.ret = false;
 
-	g_tree_foreach (self->sets, (GTraverseFunc) traverse_apply, &info);
+	index_query (get_index (self), &info);
 
 	return info.ret;
 }
@@ -437,18 +739,216 @@ ccss_selector_group_apply_type (ccss_selector_group_t const	*self,
 			       char const			*type_name,
 			       ccss_style_t			*style)
 {
-	traverse_apply_info_t info;
+	ccss_selector_index_t const	*index;
+	ccss_selector_t const		*selector;
+	char const			*key;
+	unsigned int			 a, b, c, d, e;
+	bool				 ret;
 
 	g_assert (self && self->sets && style);
 
-	info.type_name = type_name;
-	info.node = NULL;
-	info.style = style;
-	info.ret = false;
+	ret = false;
+	index = get_index (self);
+	for (unsigned int i = 0; i < index->n_selectors; i++) {
 
-	g_tree_foreach (self->sets, (GTraverseFunc) traverse_apply, &info);
+		selector = index->selectors[i];
 
-	return info.ret;
+		/* Apply only if it's a specific type. */
+		key = ccss_selector_get_key (selector);
+		ccss_selector_get_specificity_values (selector,
+						     &a, &b, &c, &d, &e);
+
+		if (ccss_selector_is_type (selector) &&
+		    0 == g_strcmp0 (type_name, key) &&
+		    a == 0 && b == 0 && c == 0 && d == 1 && e == 0) {
+
+			ret |= ccss_selector_apply (selector, NULL, style);
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * ccss_selector_match_list_init:
+ * @self:	a #ccss_selector_match_list_t, usually allocated on the stack.
+ *
+ * Initialise an empty match list.
+ **/
+void
+ccss_selector_match_list_init (ccss_selector_match_list_t *self)
+{
+	g_assert (self);
+
+	self->matches = self->preallocated;
+	self->n_matches = 0;
+	self->previous = NULL;
+	self->n_previous = 0;
+	self->changed_mask = 0;
+	self->n_allocated = G_N_ELEMENTS (self->preallocated);
+	self->min_specificity_e = CCSS_SELECTOR_MAX_SPECIFICITY;
+}
+
+/**
+ * ccss_selector_match_list_clear:
+ * @self:	a #ccss_selector_match_list_t.
+ *
+ * Free resources associated with the match list, if any.
+ **/
+void
+ccss_selector_match_list_clear (ccss_selector_match_list_t *self)
+{
+	g_assert (self);
+
+	if (self->matches != self->preallocated) {
+		g_free (self->matches);
+	}
+	ccss_selector_match_list_init (self);
+}
+
+void
+ccss_selector_match_list_append (ccss_selector_match_list_t	*self,
+				 ccss_selector_t const		*selector,
+				 uint32_t			 specificity)
+{
+	ccss_selector_match_t *match;
+
+	g_assert (self && selector);
+
+	if (self->n_matches == self->n_allocated) {
+		self->n_allocated *= 2;
+		if (self->matches == self->preallocated) {
+			self->matches = g_new (ccss_selector_match_t,
+					       self->n_allocated);
+			memcpy (self->matches, self->preallocated,
+				sizeof (self->preallocated));
+		} else {
+			self->matches = g_renew (ccss_selector_match_t,
+						 self->matches,
+						 self->n_allocated);
+		}
+	}
+
+	match = &self->matches[self->n_matches];
+	match->specificity = specificity;
+	match->position = self->n_matches;
+	match->selector = selector;
+	self->n_matches++;
+}
+
+static int
+compare_match (ccss_selector_match_t const	*match1,
+	       ccss_selector_match_t const	*match2)
+{
+	if (match1->specificity != match2->specificity) {
+		return match1->specificity < match2->specificity ? -1 : 1;
+	}
+
+	/* Matches of equal specificity are applied in reverse order, so the
+	 * first match wins. Sets list their selectors newest first, hence the
+	 * most recently loaded selector takes precedence. */
+	return match1->position > match2->position ? -1 :
+	       match1->position < match2->position;
+}
+
+/*
+ * Copy of the matching selectors sorted by address, for restyling.
+ */
+ccss_selector_t const **
+ccss_selector_match_list_dup_selectors (ccss_selector_match_list_t const	*self,
+					unsigned int			*n_selectors)
+{
+	ccss_selector_t const **selectors;
+
+	g_assert (self && n_selectors);
+
+	*n_selectors = self->n_matches;
+	if (0 == self->n_matches)
+		return NULL;
+
+	selectors = g_new (ccss_selector_t const *, self->n_matches);
+	for (unsigned int i = 0; i < self->n_matches; i++) {
+		selectors[i] = self->matches[i].selector;
+	}
+	qsort (selectors, self->n_matches, sizeof (ccss_selector_t const *),
+	       (int (*) (void const *, void const *)) compare_selector);
+
+	return selectors;
+}
+
+/**
+ * ccss_selector_match_list_apply:
+ * @self:	a #ccss_selector_match_list_t.
+ * @node:	a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
+ * @style:	a #ccss_style_t.
+ *
+ * Apply the matching selectors to @style, in order of ascending specificity.
+ *
+ * Returns: %TRUE if any style information has been applied.
+ **/
+bool
+ccss_selector_match_list_apply (ccss_selector_match_list_t	*self,
+				ccss_node_t const		*node,
+				ccss_style_t			*style)
+{
+	bool ret;
+
+	g_assert (self && style);
+
+	qsort (self->matches, self->n_matches, sizeof (ccss_selector_match_t),
+	       (int (*) (void const *, void const *)) compare_match);
+
+	ret = false;
+	for (unsigned int i = 0; i < self->n_matches; i++) {
+		ret |= ccss_selector_apply (self->matches[i].selector,
+					    node, style);
+	}
+
+	return ret;
+}
+
+/**
+ * ccss_selector_group_collect_pseudo_classes:
+ * @self:	a #ccss_selector_group_t.
+ * @atoms:	a #GHashTable to insert the atoms of pseudo-classes into.
+ *
+ * Collect the pseudo-classes that selectors in @self refer to.
+ **/
+void
+ccss_selector_group_collect_pseudo_classes (ccss_selector_group_t const	*self,
+					    GHashTable			*atoms)
+{
+	ccss_selector_index_t const *index;
+
+	g_return_if_fail (self && atoms);
+
+	index = get_index (self);
+	for (unsigned int i = 0; i < index->n_selectors; i++) {
+		ccss_selector_collect_pseudo_classes (index->selectors[i],
+						      atoms);
+	}
+}
+
+/**
+ * ccss_selector_group_collect_attribute_names:
+ * @self:	a #ccss_selector_group_t.
+ * @names:	a #GHashTable to insert newly allocated attribute names into.
+ *
+ * Collect the names of the attributes that selectors in @self refer to.
+ **/
+void
+ccss_selector_group_collect_attribute_names (ccss_selector_group_t const	*self,
+					     GHashTable			*names)
+{
+	ccss_selector_index_t const *index;
+
+	g_return_if_fail (self && names);
+
+	index = get_index (self);
+	for (unsigned int i = 0; i < index->n_selectors; i++) {
+		ccss_selector_collect_attribute_names (index->selectors[i],
+						       names);
+	}
 }
 
 static bool
@@ -23,7 +23,9 @@
 #define CCSS_SELECTOR_GROUP_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <glib.h>
+#include <ccss/ccss-ancestor-filter.h>
 #include <ccss/ccss-node.h>
 #include <ccss/ccss-macros.h>
 #include <ccss/ccss-selector.h>
@@ -33,6 +35,35 @@ CCSS_BEGIN_DECLS
 
 typedef struct ccss_selector_group_ ccss_selector_group_t;
 
+/*
+ * A selector matching a node, see ccss_selector_group_query().
+ */
+typedef struct {
+	uint32_t		 specificity;
+	unsigned int		 position;
+	ccss_selector_t const	*selector;
+} ccss_selector_match_t;
+
+#define CCSS_SELECTOR_MATCH_LIST_N_PREALLOCATED (32)
+
+/*
+ * Vector of matching selectors. It is meant to live on the stack and only
+ * spills to the heap when a node matches many selectors.
+ * When restyling, `previous' holds the selectors that matched before, sorted
+ * by address. Only selectors that may refer to a pseudo-class in
+ * `changed_mask' are matched again, see ccss_selector_pseudo_class_mask().
+ */
+typedef struct {
+	ccss_selector_match_t	*matches;
+	unsigned int		 n_matches;
+	unsigned int		 n_allocated;
+	unsigned int		 min_specificity_e;
+	ccss_selector_t const	**previous;
+	unsigned int		 n_previous;
+	uint64_t		 changed_mask;
+	ccss_selector_match_t	 preallocated[CCSS_SELECTOR_MATCH_LIST_N_PREALLOCATED];
+} ccss_selector_match_list_t;
+
 ccss_selector_group_t *	
 ccss_selector_group_create	(void);
 
@@ -48,11 +79,6 @@ ccss_selector_group_apply_type (ccss_selector_group_t const	*self,
 				char const			*type,
 				ccss_style_t			*style);
 
-bool
-ccss_selector_group_apply	(ccss_selector_group_t const	*self,
-				 ccss_node_t const		*node,
-				 ccss_style_t			*style);
-
 void
 ccss_selector_group_add_selector	(ccss_selector_group_t		*self, 
 					 ccss_selector_t		*selector);
@@ -61,6 +87,9 @@ void
 ccss_selector_group_merge_as_base	(ccss_selector_group_t		*self,
 					 ccss_selector_group_t const	*group);
 
+void
+ccss_selector_group_build_index		(ccss_selector_group_t		*self);
+
 GSList const *
 ccss_selector_group_get_dangling_selectors	(ccss_selector_group_t const	*self);
 
@@ -71,7 +100,36 @@ bool
 ccss_selector_group_query (ccss_selector_group_t const	*self, 
 			   ccss_node_t			*node,
 			   bool				 as_base,
-			   ccss_selector_group_t	*result_group);
+			   ccss_ancestor_filter_t	**filter,
+			   ccss_selector_match_list_t	*matches);
+
+void
+ccss_selector_match_list_init	(ccss_selector_match_list_t	*self);
+
+void
+ccss_selector_match_list_clear	(ccss_selector_match_list_t	*self);
+
+void
+ccss_selector_match_list_append	(ccss_selector_match_list_t	*self,
+				 ccss_selector_t const		*selector,
+				 uint32_t			 specificity);
+
+ccss_selector_t const **
+ccss_selector_match_list_dup_selectors (ccss_selector_match_list_t const	*self,
+					unsigned int			*n_selectors);
+
+bool
+ccss_selector_match_list_apply	(ccss_selector_match_list_t	*self,
+				 ccss_node_t const		*node,
+				 ccss_style_t			*style);
+
+void
+ccss_selector_group_collect_attribute_names (ccss_selector_group_t const	*self,
+					     GHashTable			*names);
+
+void
+ccss_selector_group_collect_pseudo_classes (ccss_selector_group_t const	*self,
+					    GHashTable			*atoms);
 
 void
 ccss_selector_group_dump (ccss_selector_group_t const *self);
@@ -65,8 +65,25 @@ struct ccss_selector_ {
 	struct ccss_selector_		*container;
 	struct ccss_selector_		*antecessor;
 	ccss_block_t			*block;
+	ccss_arena_t			*arena;		/* NULL if allocated */
 };
 
+/* Selectors parsed from a stylesheet live in the arena of the file or
+ * buffer they come from, copies and inline selectors are allocated. */
+static void *
+selector_alloc (ccss_arena_t	*arena,
+		size_t		 size)
+{
+	return arena ? ccss_arena_alloc (arena, size) : g_malloc0 (size);
+}
+
+static char *
+selector_strdup (ccss_arena_t	*arena,
+		 char const	*str)
+{
+	return arena ? ccss_arena_strdup (arena, str) : g_strdup (str);
+}
+
 static void
 selector_sync (ccss_selector_t const	*self,
 	       ccss_selector_t		*to)
@@ -85,6 +102,7 @@ selector_sync (ccss_selector_t const	*self,
 	to->refinement = NULL;
 	to->container = NULL;
 	to->antecessor = NULL;
+	to->arena = NULL;
 	if (self->block) {
 		to->block = ccss_block_reference (self->block);
 	} else {
@@ -100,11 +118,13 @@ typedef ccss_selector_t ccss_universal_selector_t;
 ccss_selector_t * 
 ccss_universal_selector_create (unsigned int			precedence,
 				unsigned int			stylesheet_descriptor,
-				ccss_selector_importance_t	importance)
+				ccss_selector_importance_t	importance,
+				ccss_arena_t			*arena)
 {
 	ccss_universal_selector_t *self;
 
-	self = g_new0 (ccss_universal_selector_t, 1);
+	self = selector_alloc (arena, sizeof (ccss_universal_selector_t));
+	self->arena = arena;
 	self->modality = CCSS_SELECTOR_MODALITY_UNIVERSAL;
 	self->stylesheet_descriptor = stylesheet_descriptor;
 	self->importance = importance;
@@ -129,7 +149,8 @@ universal_selector_destroy (ccss_universal_selector_t *self)
 {
 	g_assert (self);
 
-	g_free (self);
+	if (NULL == self->arena)
+		g_free (self);
 }
 
 static void
@@ -145,25 +166,29 @@ universal_selector_serialize (ccss_universal_selector_t const	*self,
 typedef struct {
 	ccss_selector_t	 parent;
 	char		*type_name;
+	ccss_atom_t	 type_atom;
 } ccss_type_selector_t;
 
 ccss_selector_t *
 ccss_type_selector_create (char const			*type_name,
 			   unsigned int			 precedence,
 			   unsigned int			 stylesheet_descriptor,
-			   ccss_selector_importance_t	 importance)
+			   ccss_selector_importance_t	 importance,
+			   ccss_arena_t			*arena)
 {
 	ccss_type_selector_t *self;
 
 	g_assert (type_name);
 
-	self = g_new0 (ccss_type_selector_t, 1);
+	self = selector_alloc (arena, sizeof (ccss_type_selector_t));
+	self->parent.arena = arena;
 	self->parent.modality = CCSS_SELECTOR_MODALITY_TYPE;
 	self->parent.stylesheet_descriptor = stylesheet_descriptor;
 	self->parent.importance = importance;
 	self->parent.precedence = precedence;
 	self->parent.d = 1;
-	self->type_name = g_strdup (type_name);
+	self->type_name = selector_strdup (arena, type_name);
+	self->type_atom = ccss_atom_from_string (type_name);
 
 	return (ccss_selector_t *) self;
 }
@@ -176,6 +201,7 @@ type_selector_dup (ccss_type_selector_t const *original)
 	self = g_new0 (ccss_type_selector_t, 1);
 	selector_sync ((ccss_selector_t const *) original, &self->parent);
 	self->type_name = g_strdup (original->type_name);
+	self->type_atom = original->type_atom;
 
 	return (ccss_selector_t *) self;
 }
@@ -185,8 +211,10 @@ type_selector_destroy (ccss_type_selector_t *self)
 {
 	g_assert (self);
 
-	g_free (self->type_name);
-	g_free (self);
+	if (NULL == self->parent.arena) {
+		g_free (self->type_name);
+		g_free (self);
+	}
 }
 
 static void
@@ -212,7 +240,8 @@ ccss_base_type_selector_create (char const			*type_name,
 	self = ccss_type_selector_create (type_name,
 					  precedence,
 					  stylesheet_descriptor,
-					  importance);
+					  importance,
+					  NULL);
 	self->modality = CCSS_SELECTOR_MODALITY_BASE_TYPE;
 
 	self->a = 0;
@@ -230,25 +259,29 @@ ccss_base_type_selector_create (char const			*type_name,
 typedef struct {
 	ccss_selector_t	 parent;
 	char		*class_name;
+	ccss_atom_t	 class_atom;
 } ccss_class_selector_t;
 
 ccss_selector_t *
 ccss_class_selector_create (char const			*class_name,
 			    unsigned int		 precedence,
 			    unsigned int		 stylesheet_descriptor,
-			    ccss_selector_importance_t	 importance)
+			    ccss_selector_importance_t	 importance,
+			    ccss_arena_t			*arena)
 {
 	ccss_class_selector_t *self;
 
 	g_assert (class_name);
 
-	self = g_new0 (ccss_class_selector_t, 1);
+	self = selector_alloc (arena, sizeof (ccss_class_selector_t));
+	self->parent.arena = arena;
 	self->parent.modality = CCSS_SELECTOR_MODALITY_CLASS;
 	self->parent.stylesheet_descriptor = stylesheet_descriptor;
 	self->parent.importance = importance;
 	self->parent.precedence = precedence;
 	self->parent.c = 1;
-	self->class_name = g_strdup (class_name);
+	self->class_name = selector_strdup (arena, class_name);
+	self->class_atom = ccss_atom_from_string (class_name);
 
 	return (ccss_selector_t *) self;
 }
@@ -261,6 +294,7 @@ class_selector_dup (ccss_class_selector_t const *original)
 	self = g_new0 (ccss_class_selector_t, 1);
 	selector_sync ((ccss_selector_t const *) original, &self->parent);
 	self->class_name = g_strdup (original->class_name);
+	self->class_atom = original->class_atom;
 
 	return (ccss_selector_t *) self;
 }
@@ -270,8 +304,10 @@ class_selector_destroy (ccss_class_selector_t *self)
 {
 	g_assert (self);
 
-	g_free (self->class_name);
-	g_free (self);
+	if (NULL == self->parent.arena) {
+		g_free (self->class_name);
+		g_free (self);
+	}
 }
 
 static void
@@ -287,25 +323,29 @@ class_selector_serialize (ccss_class_selector_t const   *self,
 typedef struct {
 	ccss_selector_t	 parent;
 	char		*id;
+	ccss_atom_t	 id_atom;
 } ccss_id_selector_t;
 
 ccss_selector_t *
 ccss_id_selector_create (char const			*id,
 			 unsigned int			 precedence,
 			 unsigned int			 stylesheet_descriptor,
-			 ccss_selector_importance_t	 importance)
+			 ccss_selector_importance_t	 importance,
+			 ccss_arena_t			*arena)
 {
 	ccss_id_selector_t *self;
 
 	g_assert (id);
 
-	self = g_new0 (ccss_id_selector_t, 1);
+	self = selector_alloc (arena, sizeof (ccss_id_selector_t));
+	self->parent.arena = arena;
 	self->parent.modality = CCSS_SELECTOR_MODALITY_ID;
 	self->parent.stylesheet_descriptor = stylesheet_descriptor;
 	self->parent.importance = importance;
 	self->parent.precedence = precedence;
 	self->parent.b = 1;
-	self->id = g_strdup (id);
+	self->id = selector_strdup (arena, id);
+	self->id_atom = ccss_atom_from_string (id);
 
 	return (ccss_selector_t *) self;
 }
@@ -318,6 +358,7 @@ id_selector_dup (ccss_id_selector_t const *original)
 	self = g_new0 (ccss_id_selector_t, 1);
 	selector_sync ((ccss_selector_t const *) original, &self->parent);
 	self->id = g_strdup (original->id);
+	self->id_atom = original->id_atom;
 
 	return (ccss_selector_t *) self;
 }
@@ -327,8 +368,10 @@ id_selector_destroy (ccss_id_selector_t *self)
 {
 	g_assert (self);
 
-	g_free (self->id);
-	g_free (self);
+	if (NULL == self->parent.arena) {
+		g_free (self->id);
+		g_free (self);
+	}
 }
 
 static void
@@ -354,20 +397,23 @@ ccss_attribute_selector_create (char const			*name,
 				ccss_attribute_selector_match_t	 match,
 				unsigned int			 precedence,
 				unsigned int			 stylesheet_descriptor,
-				ccss_selector_importance_t	 importance)
+				ccss_selector_importance_t	 importance,
+				ccss_arena_t			*arena)
 {
 	ccss_attribute_selector_t *self;
 
-	g_assert (name && value);
+	g_assert (name);
+	g_assert (value || CCSS_ATTRIBUTE_SELECTOR_MATCH_EXISTS == match);
 
-	self = g_new0 (ccss_attribute_selector_t, 1);
+	self = selector_alloc (arena, sizeof (ccss_attribute_selector_t));
+	self->parent.arena = arena;
 	self->parent.modality = CCSS_SELECTOR_MODALITY_ATTRIBUTE;
 	self->parent.stylesheet_descriptor = stylesheet_descriptor;
 	self->parent.importance = importance;
 	self->parent.precedence = precedence;
 	self->parent.c = 1;
-	self->name = g_strdup (name);
-	self->value = g_strdup (value);
+	self->name = selector_strdup (arena, name);
+	self->value = selector_strdup (arena, value);
 	self->match = match;
 
 	return (ccss_selector_t *) self;
@@ -392,9 +438,11 @@ attribute_selector_destroy (ccss_attribute_selector_t *self)
 {
 	g_assert (self);
 
-	g_free (self->name);
-	g_free (self->value);
-	g_free (self);
+	if (NULL == self->parent.arena) {
+		g_free (self->name);
+		g_free (self->value);
+		g_free (self);
+	}
 }
 
 static void
@@ -419,25 +467,29 @@ attribute_selector_serialize (ccss_attribute_selector_t const   *self,
 typedef struct {
 	ccss_selector_t	 parent;
 	char		*pseudo_class;
+	ccss_atom_t	 pseudo_class_atom;
 } ccss_pseudo_class_selector_t;
 
 ccss_selector_t *
 ccss_pseudo_class_selector_create (char const			*pseudo_class,
 				   unsigned int			 precedence,
 				   unsigned int			 stylesheet_descriptor,
-				   ccss_selector_importance_t	 importance)
+				   ccss_selector_importance_t	 importance,
+				   ccss_arena_t			*arena)
 {
 	ccss_pseudo_class_selector_t *self;
 
 	g_assert (pseudo_class);
 
-	self = g_new0 (ccss_pseudo_class_selector_t, 1);
+	self = selector_alloc (arena, sizeof (ccss_pseudo_class_selector_t));
+	self->parent.arena = arena;
 	self->parent.modality = CCSS_SELECTOR_MODALITY_PSEUDO_CLASS;
 	self->parent.stylesheet_descriptor = stylesheet_descriptor;
 	self->parent.importance = importance;
 	self->parent.precedence = precedence;
 	self->parent.d = 1;
-	self->pseudo_class = g_strdup (pseudo_class);
+	self->pseudo_class = selector_strdup (arena, pseudo_class);
+	self->pseudo_class_atom = ccss_atom_from_string (pseudo_class);
 
 	return (ccss_selector_t *) self;
 }
@@ -450,6 +502,7 @@ pseudo_class_selector_dup (ccss_pseudo_class_selector_t const *original)
 	self = g_new0 (ccss_pseudo_class_selector_t, 1);
 	selector_sync ((ccss_selector_t const *) original, &self->parent);
 	self->pseudo_class = g_strdup (original->pseudo_class);
+	self->pseudo_class_atom = original->pseudo_class_atom;
 
 	return (ccss_selector_t *) self;
 }
@@ -459,8 +512,10 @@ pseudo_class_selector_destroy (ccss_pseudo_class_selector_t *self)
 {
 	g_assert (self);
 
-	g_free (self->pseudo_class);
-	g_free (self);
+	if (NULL == self->parent.arena) {
+		g_free (self->pseudo_class);
+		g_free (self);
+	}
 }
 
 static void
@@ -861,6 +916,54 @@ ccss_selector_get_key (ccss_selector_t const *self)
 	return NULL;
 }
 
+/*
+ * Find the most selective simple selector of the rightmost compound selector,
+ * i.e. `self' and its refinements. An ID beats a class, which beats a
+ * pseudo-class. Selectors are bucketed by this key in the selector group's
+ * index, so only candidates that can possibly match are tested.
+ */
+ccss_selector_key_t
+ccss_selector_get_index_key (ccss_selector_t const	*self,
+			     ccss_atom_t		*atom)
+{
+	ccss_selector_t const	*iter;
+	ccss_selector_key_t	 key;
+
+	g_return_val_if_fail (self && atom, CCSS_SELECTOR_KEY_NONE);
+
+	key = CCSS_SELECTOR_KEY_NONE;
+	*atom = 0;
+	for (iter = self; iter != NULL; iter = iter->refinement) {
+		switch (iter->modality) {
+		case CCSS_SELECTOR_MODALITY_ID:
+			*atom = ((ccss_id_selector_t const *) iter)->id_atom;
+			return CCSS_SELECTOR_KEY_ID;
+		case CCSS_SELECTOR_MODALITY_CLASS:
+			if (key != CCSS_SELECTOR_KEY_CLASS) {
+				key = CCSS_SELECTOR_KEY_CLASS;
+				*atom = ((ccss_class_selector_t const *) iter)->class_atom;
+			}
+			break;
+		case CCSS_SELECTOR_MODALITY_PSEUDO_CLASS:
+			if (key == CCSS_SELECTOR_KEY_NONE) {
+				key = CCSS_SELECTOR_KEY_PSEUDO_CLASS;
+				*atom = ((ccss_pseudo_class_selector_t const *) iter)->pseudo_class_atom;
+			}
+			break;
+		case CCSS_SELECTOR_MODALITY_UNIVERSAL:
+		case CCSS_SELECTOR_MODALITY_TYPE:
+		case CCSS_SELECTOR_MODALITY_BASE_TYPE:
+		case CCSS_SELECTOR_MODALITY_ATTRIBUTE:
+		case CCSS_SELECTOR_MODALITY_INSTANCE:
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+	}
+
+	return key;
+}
+
 unsigned int
 ccss_selector_get_descriptor (ccss_selector_t const *self)
 {
@@ -881,6 +984,26 @@ ccss_selector_get_specificity (ccss_selector_t const *self)
 	return self->e | (self->d << 5) | (self->c << 10) | (self->b << 15) | (self->a << 20) | (self->precedence << 25) | (self->importance << 30);
 }
 
+/*
+ * Specificity of the selector as if it was copied using
+ * ccss_selector_copy_as_base(), without actually copying it.
+ */
+uint32_t
+ccss_selector_get_specificity_as_base (ccss_selector_t const	*self,
+				       unsigned int		 specificity_e)
+{
+	unsigned int d;
+	unsigned int e;
+
+	g_assert (self && self->modality == CCSS_SELECTOR_MODALITY_TYPE);
+	g_assert (specificity_e <= CCSS_SELECTOR_MAX_SPECIFICITY);
+
+	d = self->d > 0 ? self->d - 1 : 0;
+	e = self->e == 0 ? specificity_e : self->e;
+
+	return e | (d << 5) | (self->c << 10) | (self->b << 15) | (self->a << 20) | (self->precedence << 25) | (self->importance << 30);
+}
+
 void
 ccss_selector_get_specificity_values (ccss_selector_t const	*self, 
 				      unsigned int		*a,
@@ -907,133 +1030,488 @@ ccss_selector_get_specificity_values (ccss_selector_t const	*self,
 		*e = self->e;
 }
 
-static bool
-match_antecessor_r (ccss_selector_t const	*self, 
-		    ccss_node_t			*node)
-{
-	ccss_node_t		*container;
-	bool			 is_matching;
+/*
+ * Selectors are compiled into a flat program for matching, the tree form is
+ * kept for serialization, copying and the index. Instructions test the
+ * current node, right to left: first the rightmost compound selector, then
+ * the parts that apply to the node's containers.
+ */
+typedef enum {
+	OP_MATCH = 0,		/* Done, the selector matches. */
+	OP_TYPE,
+	OP_CLASS,
+	OP_ID,
+	OP_PSEUDO_CLASS,
+	OP_ATTRIBUTE_EXISTS,
+	OP_ATTRIBUTE_EQUALS,
+	OP_INSTANCE,
+	OP_CONTAINER,		/* Continue with the container. */
+	OP_ANCESTOR,		/* Continue with each ancestor until matching. */
+	OP_RETURN		/* Back to the node before the last
+				 * OP_CONTAINER or OP_ANCESTOR. */
+} opcode_t;
 
-	container = ccss_node_get_container (node);
-	if (container) {
-		is_matching = ccss_selector_query (self, container);
-		if (!is_matching) {
-			is_matching = match_antecessor_r (self, container);
-		}
-		ccss_node_release (container);
-	} else {
-		is_matching = false;
-	}
+typedef struct {
+	opcode_t		 opcode;
+	ccss_atom_t		 atom;
+	ptrdiff_t		 instance;
+	char const		*name;
+	char const		*value;
+} instruction_t;
+
+struct ccss_selector_program_ {
+	uint64_t		 pseudo_class_mask;
+	unsigned int		 max_depth;
+	unsigned int		 n_instructions;
+	instruction_t		 instructions[1];
+};
 
-	return is_matching;
+static void
+emit (GArray		*instructions,
+      opcode_t		 opcode,
+      ccss_atom_t	 atom)
+{
+	instruction_t instruction;
+
+	memset (&instruction, 0, sizeof (instruction));
+	instruction.opcode = opcode;
+	instruction.atom = atom;
+	g_array_append_val (instructions, instruction);
 }
 
-bool
-ccss_selector_query (ccss_selector_t const	*self, 
-		     ccss_node_t 		*node)
+static void
+emit_test (GArray		*instructions,
+	   ccss_selector_t const	*self)
 {
-	char const	*name;
-	char		*value;
-	ptrdiff_t	 instance;
-	bool		 is_matching;
-
-	g_return_val_if_fail (self && node, false);
+	ccss_attribute_selector_t const	*attribute;
+	instruction_t			*instruction;
 
-	is_matching = false;
 	switch (self->modality) {
 	case CCSS_SELECTOR_MODALITY_UNIVERSAL:
-		is_matching = true;
+	case CCSS_SELECTOR_MODALITY_BASE_TYPE:
+		/* Always matching. Base type selectors are only set up
+		 * internally, in the fixup run after loading the stylesheet. */
 		break;
 	case CCSS_SELECTOR_MODALITY_TYPE:
-		is_matching = ccss_node_is_a (node, 
-				((ccss_type_selector_t *) self)->type_name);
-		break;
-	case CCSS_SELECTOR_MODALITY_BASE_TYPE:
-		/* HACK warning: let's just say it matches, because the base
-		 * type selectors have been set up internally -- that is in the
-		 * fixup run after loading the stylesheet. */
-		is_matching = true;
+		emit (instructions, OP_TYPE,
+		      ((ccss_type_selector_t const *) self)->type_atom);
 		break;
 	case CCSS_SELECTOR_MODALITY_CLASS:
-		for (const char **classes = ccss_node_get_classes (node);
-		     classes && *classes;
-		     classes++) {
-			is_matching = !g_strcmp0 (*classes,
-				((ccss_class_selector_t *) self)->class_name);
-		}
+		emit (instructions, OP_CLASS,
+		      ((ccss_class_selector_t const *) self)->class_atom);
 		break;
 	case CCSS_SELECTOR_MODALITY_ID:
-		name = ccss_node_get_id (node);
-		is_matching = !g_strcmp0 (name, 
-				((ccss_id_selector_t *) self)->id);
+		emit (instructions, OP_ID,
+		      ((ccss_id_selector_t const *) self)->id_atom);
+		break;
+	case CCSS_SELECTOR_MODALITY_PSEUDO_CLASS:
+		emit (instructions, OP_PSEUDO_CLASS,
+		      ((ccss_pseudo_class_selector_t const *) self)->pseudo_class_atom);
 		break;
 	case CCSS_SELECTOR_MODALITY_ATTRIBUTE:
-		name = ((ccss_attribute_selector_t *) self)->name;
-		value = ccss_node_get_attribute (node, name);
-		switch (((ccss_attribute_selector_t *) self)->match) {
+		attribute = (ccss_attribute_selector_t const *) self;
+		switch (attribute->match) {
 		case CCSS_ATTRIBUTE_SELECTOR_MATCH_EXISTS:
-			is_matching = value ? true : false;
+			emit (instructions, OP_ATTRIBUTE_EXISTS, 0);
 			break;
 		case CCSS_ATTRIBUTE_SELECTOR_MATCH_EQUALS:
-			is_matching = !g_strcmp0 (value, 
-				((ccss_attribute_selector_t *) self)->value);
+			emit (instructions, OP_ATTRIBUTE_EQUALS, 0);
 			break;
 		}
-		g_free (value), value = NULL;
-		break;
-	case CCSS_SELECTOR_MODALITY_PSEUDO_CLASS:
-		for (const char **pseudo_classes = ccss_node_get_pseudo_classes (node);
-		     pseudo_classes && *pseudo_classes;
-		     pseudo_classes++) {
-			is_matching = !g_strcmp0 (*pseudo_classes,
-				((ccss_pseudo_class_selector_t *) self)->pseudo_class);
-		}
+		instruction = &g_array_index (instructions, instruction_t,
+					      instructions->len - 1);
+		instruction->name = attribute->name;
+		instruction->value = attribute->value;
 		break;
 	case CCSS_SELECTOR_MODALITY_INSTANCE:
-		instance = ccss_node_get_instance (node);
-		is_matching = (instance ==
-				((ccss_instance_selector_t *) self)->instance);
+		emit (instructions, OP_INSTANCE, 0);
+		instruction = &g_array_index (instructions, instruction_t,
+					      instructions->len - 1);
+		instruction->instance =
+			((ccss_instance_selector_t const *) self)->instance;
 		break;
 	default:
 		g_assert_not_reached ();
-		return false;
 	}
+}
 
-	if (!is_matching) {
-		return false;
+static void
+compile_r (ccss_selector_t const	*self,
+	   GArray			*instructions,
+	   unsigned int			 depth,
+	   unsigned int			*max_depth)
+{
+	ccss_selector_t const *iter;
+
+	*max_depth = MAX (*max_depth, depth);
+
+	/* Attributes are fetched as newly allocated strings, test them
+	 * last. */
+	for (iter = self; iter != NULL; iter = iter->refinement) {
+		if (iter->modality != CCSS_SELECTOR_MODALITY_ATTRIBUTE)
+			emit_test (instructions, iter);
+	}
+	for (iter = self; iter != NULL; iter = iter->refinement) {
+		if (iter->modality == CCSS_SELECTOR_MODALITY_ATTRIBUTE)
+			emit_test (instructions, iter);
 	}
 
-	/* recursively match refinements */
-	if (self->refinement) {
-		is_matching = ccss_selector_query (self->refinement, node);
-		if (!is_matching) {
-			return false;
+	for (iter = self; iter != NULL; iter = iter->refinement) {
+		if (iter->container) {
+			emit (instructions, OP_CONTAINER, 0);
+			compile_r (iter->container, instructions, depth + 1,
+				   max_depth);
+			emit (instructions, OP_RETURN, 0);
+		}
+		if (iter->antecessor) {
+			emit (instructions, OP_ANCESTOR, 0);
+			compile_r (iter->antecessor, instructions, depth + 1,
+				   max_depth);
+			emit (instructions, OP_RETURN, 0);
 		}
 	}
+}
 
-	/* match container */
-	if (self->container) {
-		ccss_node_t *container;
-		container = ccss_node_get_container (node);
-		is_matching = false;
-		if (container) {
-			is_matching = ccss_selector_query (self->container, container);
-			ccss_node_release (container);
+/*
+ * Compile the selector chain for ccss_selector_program_query(). The program
+ * refers to strings of the selector, it must not outlive it.
+ */
+ccss_selector_program_t *
+ccss_selector_compile (ccss_selector_t const *self)
+{
+	ccss_selector_program_t	*program;
+	GArray			*instructions;
+	unsigned int		 max_depth;
+
+	g_return_val_if_fail (self, NULL);
+
+	instructions = g_array_new (false, false, sizeof (instruction_t));
+	max_depth = 0;
+	compile_r (self, instructions, 0, &max_depth);
+	emit (instructions, OP_MATCH, 0);
+
+	program = g_malloc (sizeof (ccss_selector_program_t) +
+			    (instructions->len - 1) * sizeof (instruction_t));
+	program->pseudo_class_mask = 0;
+	program->max_depth = max_depth;
+	program->n_instructions = instructions->len;
+	memcpy (program->instructions, instructions->data,
+		instructions->len * sizeof (instruction_t));
+	g_array_free (instructions, true);
+
+	for (unsigned int i = 0; i < program->n_instructions; i++) {
+		if (OP_PSEUDO_CLASS == program->instructions[i].opcode) {
+			program->pseudo_class_mask |= ccss_selector_pseudo_class_mask (
+					program->instructions[i].atom);
+		}
+	}
+
+	return program;
+}
+
+/*
+ * One bit per pseudo-class, shared by pseudo-classes whose atoms are
+ * congruent modulo 64.
+ */
+uint64_t
+ccss_selector_pseudo_class_mask (ccss_atom_t pseudo_class)
+{
+	return G_GUINT64_CONSTANT (1) << (pseudo_class % 64);
+}
+
+/*
+ * Whether the selector may refer to one of the pseudo-classes in `mask',
+ * see ccss_selector_pseudo_class_mask().
+ */
+bool
+ccss_selector_program_may_refer_to (ccss_selector_program_t const	*self,
+				    uint64_t				 mask)
+{
+	g_return_val_if_fail (self, true);
+
+	return self->pseudo_class_mask & mask;
+}
+
+void
+ccss_selector_program_destroy (ccss_selector_program_t *self)
+{
+	g_free (self);
+}
+
+/* A node entered through OP_CONTAINER or OP_ANCESTOR. */
+typedef struct {
+	ccss_node_t		*node;
+	unsigned int		 retry;		/* 0 for OP_CONTAINER */
+} frame_t;
+
+static bool
+has_atom (ccss_atom_t const	*atoms,
+	  ccss_atom_t		 atom)
+{
+	for (; atoms && *atoms; atoms++) {
+		if (*atoms == atom)
+			return true;
+	}
+
+	return false;
+}
+
+/* Node facts are fetched once per query and cached by the node. */
+static bool
+test (instruction_t const	*instruction,
+      ccss_node_t		*node)
+{
+	char	*value;
+	bool	 is_matching;
+
+	switch (instruction->opcode) {
+	case OP_TYPE:
+		return ccss_node_is_a_atom (node, instruction->atom);
+	case OP_CLASS:
+		return has_atom (ccss_node_get_class_atoms (node),
+				 instruction->atom);
+	case OP_ID:
+		return ccss_node_get_id_atom (node) == instruction->atom;
+	case OP_PSEUDO_CLASS:
+		return has_atom (ccss_node_get_pseudo_class_atoms (node),
+				 instruction->atom);
+	case OP_ATTRIBUTE_EXISTS:
+	case OP_ATTRIBUTE_EQUALS:
+		value = ccss_node_get_attribute (node, instruction->name);
+		if (OP_ATTRIBUTE_EXISTS == instruction->opcode) {
+			is_matching = value ? true : false;
+		} else {
+			is_matching = !g_strcmp0 (value, instruction->value);
 		}
-		if (!is_matching) {
-			return false;
+		g_free (value), value = NULL;
+		return is_matching;
+	case OP_INSTANCE:
+		return ccss_node_get_instance (node) == instruction->instance;
+	default:
+		g_assert_not_reached ();
+	}
+
+	return false;
+}
+
+/*
+ * Run a compiled selector against `node'. Failing inside an OP_ANCESTOR
+ * retries with the next ancestor, once it succeeded the choice is final,
+ * since the following instructions don't depend on it.
+ * Containers are owned by the nodes, see ccss_node_get_container().
+ */
+bool
+ccss_selector_program_query (ccss_selector_program_t const	*self,
+			     ccss_node_t			*node)
+{
+	instruction_t const	*instruction;
+	frame_t			*frames;
+	frame_t			*frame;
+	ccss_node_t		*current;
+	ccss_node_t		*container;
+	unsigned int		 depth;
+	unsigned int		 pc;
+	bool			 is_matching;
+
+	g_return_val_if_fail (self && node, false);
+
+	frames = g_newa (frame_t, self->max_depth + 1);
+	current = node;
+	depth = 0;
+	pc = 0;
+
+	for (;;) {
+		g_assert (pc < self->n_instructions);
+		instruction = &self->instructions[pc++];
+
+		switch (instruction->opcode) {
+		case OP_MATCH:
+			g_assert (depth == 0);
+			return true;
+		case OP_CONTAINER:
+		case OP_ANCESTOR:
+			container = ccss_node_get_container (current);
+			is_matching = (container != NULL);
+			if (container) {
+				frame = &frames[depth++];
+				frame->node = container;
+				frame->retry = OP_ANCESTOR == instruction->opcode ?
+					       pc : 0;
+				current = container;
+			}
+			break;
+		case OP_RETURN:
+			g_assert (depth > 0);
+			depth--;
+			current = depth ? frames[depth - 1].node : node;
+			is_matching = true;
+			break;
+		default:
+			is_matching = test (instruction, current);
 		}
+
+		if (is_matching)
+			continue;
+
+		/* Leave nodes until one that was entered through OP_ANCESTOR
+		 * has a container left to try. */
+		for (;;) {
+			if (depth == 0)
+				return false;
+			frame = &frames[depth - 1];
+			container = frame->retry ?
+				    ccss_node_get_container (frame->node) :
+				    NULL;
+			if (container) {
+				frame->node = container;
+				pc = frame->retry;
+				break;
+			}
+			depth--;
+		}
+		current = frame->node;
 	}
 
-	/* recursively match antecessor */
-	if (self->antecessor) {
-		is_matching = match_antecessor_r (self->antecessor, node);
-		if (!is_matching) {
-			return false;
+	return false;
+}
+
+static void
+add_ancestor_hash (ccss_ancestor_hashes_t	*hashes,
+		   ccss_ancestor_fact_t		 fact,
+		   ccss_atom_t			 atom)
+{
+	if (hashes->n_hashes == CCSS_ANCESTOR_FILTER_N_HASHES)
+		return;
+
+	if (CCSS_ANCESTOR_FACT_TYPE == fact)
+		hashes->type_mask |= 1 << hashes->n_hashes;
+	hashes->hashes[hashes->n_hashes++] =
+				ccss_ancestor_filter_hash (fact, atom);
+}
+
+/*
+ * `is_ancestor' tells whether the compound selector `self' applies to one of
+ * the containers rather than the queried node.
+ */
+static void
+collect_ancestor_hashes_r (ccss_selector_t const	*self,
+			   bool				 is_ancestor,
+			   ccss_ancestor_hashes_t	*hashes)
+{
+	for (ccss_selector_t const *iter = self;
+	     iter != NULL;
+	     iter = iter->refinement) {
+
+		if (is_ancestor) {
+			switch (iter->modality) {
+			case CCSS_SELECTOR_MODALITY_TYPE:
+				add_ancestor_hash (hashes,
+					CCSS_ANCESTOR_FACT_TYPE,
+					((ccss_type_selector_t const *) iter)->type_atom);
+				break;
+			case CCSS_SELECTOR_MODALITY_ID:
+				add_ancestor_hash (hashes,
+					CCSS_ANCESTOR_FACT_ID,
+					((ccss_id_selector_t const *) iter)->id_atom);
+				break;
+			case CCSS_SELECTOR_MODALITY_CLASS:
+				add_ancestor_hash (hashes,
+					CCSS_ANCESTOR_FACT_CLASS,
+					((ccss_class_selector_t const *) iter)->class_atom);
+				break;
+			default:
+				/* Not recorded in the filter. */
+				break;
+			}
+		}
+
+		if (iter->container) {
+			collect_ancestor_hashes_r (iter->container, true,
+						   hashes);
+		}
+
+		if (iter->antecessor) {
+			collect_ancestor_hashes_r (iter->antecessor, true,
+						   hashes);
 		}
 	}
+}
 
-	return true;
+/*
+ * Collect the types, IDs and classes that the child and descendant parts of
+ * the selector chain require of a node's containers, for rejecting the
+ * selector through a #ccss_ancestor_filter_t.
+ */
+void
+ccss_selector_get_ancestor_hashes (ccss_selector_t const	*self,
+				   ccss_ancestor_hashes_t	*hashes)
+{
+	g_return_if_fail (self && hashes);
+
+	hashes->n_hashes = 0;
+	hashes->type_mask = 0;
+	collect_ancestor_hashes_r (self, false, hashes);
+}
+
+/*
+ * Collect the names of all attributes the selector chain refers to.
+ */
+void
+ccss_selector_collect_attribute_names (ccss_selector_t const	*self,
+				       GHashTable		*names)
+{
+	char const *name;
+
+	g_return_if_fail (self && names);
+
+	if (CCSS_SELECTOR_MODALITY_ATTRIBUTE == self->modality) {
+		name = ((ccss_attribute_selector_t const *) self)->name;
+		if (!g_hash_table_lookup (names, name)) {
+			g_hash_table_insert (names, g_strdup (name),
+					     GINT_TO_POINTER (1));
+		}
+	}
+
+	if (self->refinement) {
+		ccss_selector_collect_attribute_names (self->refinement, names);
+	}
+
+	if (self->container) {
+		ccss_selector_collect_attribute_names (self->container, names);
+	}
+
+	if (self->antecessor) {
+		ccss_selector_collect_attribute_names (self->antecessor, names);
+	}
+}
+
+/*
+ * Collect the atoms of all pseudo-classes the selector chain refers to.
+ */
+void
+ccss_selector_collect_pseudo_classes (ccss_selector_t const	*self,
+				      GHashTable		*atoms)
+{
+	ccss_atom_t atom;
+
+	g_return_if_fail (self && atoms);
+
+	if (CCSS_SELECTOR_MODALITY_PSEUDO_CLASS == self->modality) {
+		atom = ((ccss_pseudo_class_selector_t const *) self)->pseudo_class_atom;
+		g_hash_table_insert (atoms, GUINT_TO_POINTER (atom), NULL);
+	}
+
+	if (self->refinement) {
+		ccss_selector_collect_pseudo_classes (self->refinement, atoms);
+	}
+
+	if (self->container) {
+		ccss_selector_collect_pseudo_classes (self->container, atoms);
+	}
+
+	if (self->antecessor) {
+		ccss_selector_collect_pseudo_classes (self->antecessor, atoms);
+	}
 }
 
 bool
@@ -1041,26 +1519,26 @@ ccss_selector_apply (ccss_selector_t const	*self,
 		     ccss_node_t const		*node,
 		     ccss_style_t		*style)
 {
-	GHashTableIter		 iter;
-	gpointer		 key;
-	gpointer		 value;
-	double			 x, y, width, height;
-	bool			 ret;
+	ccss_block_entry_t const	*entry;
+	double				 x, y, width, height;
+	bool				 ret;
 
 	g_return_val_if_fail (self && self->block && style, false);
 
+	if (self->block->arena) {
+		ccss_style_hold_arena (style, self->block->arena);
+	}
+
 	/* Apply css properties to the style.
 	 * FIXME: this simple merge strategy doesn't work for `border-image',
 	 * as they should be overridden by a higher specificity `border'. */
-	g_hash_table_iter_init (&iter, self->block->properties);
-	while (g_hash_table_iter_next (&iter, &key, &value)) {
+	for (unsigned int i = 0; i < self->block->n_properties; i++) {
 
-		g_hash_table_insert (style->properties, key, value);
+		entry = &self->block->properties[i];
+		ccss_style_insert_property (style, entry->id, entry->property);
 #ifdef CCSS_DEBUG
 		/* Track where the property comes from. */
-		ccss_style_set_property_selector (style,
-						  (ccss_property_t const *) value,
-						  self);
+		ccss_style_set_property_selector (style, entry->property, self);
 #endif
 	}
 
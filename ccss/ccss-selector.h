@@ -26,6 +26,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <glib.h>
+#include <ccss/ccss-ancestor-filter-priv.h>
+#include <ccss/ccss-arena-priv.h>
 #include <ccss/ccss-block.h>
 #include <ccss/ccss-macros.h>
 #include <ccss/ccss-node.h>
@@ -39,6 +41,8 @@ CCSS_BEGIN_DECLS
 
 typedef struct ccss_selector_ ccss_selector_t;
 
+typedef struct ccss_selector_program_ ccss_selector_program_t;
+
 typedef enum {
 	CCSS_SELECTOR_IMPORTANCE_NONE	= 0,
 	CCSS_SELECTOR_IMPORTANCE_AUTHOR,
@@ -51,15 +55,24 @@ typedef enum {
 	/* more match types go here */
 } ccss_attribute_selector_match_t;
 
+typedef enum {
+	CCSS_SELECTOR_KEY_NONE = 0,
+	CCSS_SELECTOR_KEY_ID,
+	CCSS_SELECTOR_KEY_CLASS,
+	CCSS_SELECTOR_KEY_PSEUDO_CLASS
+} ccss_selector_key_t;
+
 ccss_selector_t *
 ccss_universal_selector_create	(unsigned int			 precedence,
 				 unsigned int			 stylesheet_descriptor,
-				 ccss_selector_importance_t	 importance);
+				 ccss_selector_importance_t	 importance,
+				 ccss_arena_t			*arena);
 ccss_selector_t *
 ccss_type_selector_create	(char const			*type_name,
 				 unsigned int			 precedence,
 				 unsigned int			 stylesheet_descriptor,
-				 ccss_selector_importance_t	 importance);
+				 ccss_selector_importance_t	 importance,
+				 ccss_arena_t			*arena);
 ccss_selector_t *
 ccss_base_type_selector_create	(char const			*type_name,
 				 unsigned int			 precedence,
@@ -70,24 +83,28 @@ ccss_selector_t *
 ccss_class_selector_create	(char const			*class_name,
 				 unsigned int			 precedence,
 				 unsigned int			 stylesheet_descriptor,
-				 ccss_selector_importance_t	 importance);
+				 ccss_selector_importance_t	 importance,
+				 ccss_arena_t			*arena);
 ccss_selector_t *
 ccss_id_selector_create		(char const			*id,
 				 unsigned int			 precedence,
 				 unsigned int			 stylesheet_descriptor,
-				 ccss_selector_importance_t	 importance);
+				 ccss_selector_importance_t	 importance,
+				 ccss_arena_t			*arena);
 ccss_selector_t *
 ccss_attribute_selector_create	(char const			*name,
 				 char const			*value,
 				 ccss_attribute_selector_match_t match,
 				 unsigned int			 precedence,
 				 unsigned int			 stylesheet_descriptor,
-				 ccss_selector_importance_t	 importance);
+				 ccss_selector_importance_t	 importance,
+				 ccss_arena_t			*arena);
 ccss_selector_t *
 ccss_pseudo_class_selector_create (char const			*pseudo_class,
 				   unsigned int			 precedence,
 				   unsigned int			 stylesheet_descriptor,
-				   ccss_selector_importance_t	 importance);
+				   ccss_selector_importance_t	 importance,
+				   ccss_arena_t			*arena);
 ccss_selector_t *
 ccss_instance_selector_create	(ptrdiff_t			 instance,
 				 unsigned int			 precedence,
@@ -113,10 +130,14 @@ void			ccss_selector_set_block	(ccss_selector_t	*self,
 						 ccss_block_t		*block);
 
 char const *			ccss_selector_get_key		(ccss_selector_t const *self);
+ccss_selector_key_t		ccss_selector_get_index_key	(ccss_selector_t const *self,
+								 ccss_atom_t *atom);
 ccss_selector_importance_t	ccss_selector_get_importance	(ccss_selector_t const *self);
 /*ccss_stylesheet_precedence_t	ccss_selector_get_precedence	(ccss_selector_t const *self);*/
 unsigned int			ccss_selector_get_descriptor	(ccss_selector_t const *self);
 uint32_t			ccss_selector_get_specificity	(ccss_selector_t const *self);
+uint32_t			ccss_selector_get_specificity_as_base	(ccss_selector_t const *self,
+									 unsigned int specificity_e);
 void				ccss_selector_get_specificity_values	(ccss_selector_t const *self, 
 									 unsigned int *a,
 									 unsigned int *b,
@@ -124,9 +145,34 @@ void				ccss_selector_get_specificity_values	(ccss_selector_t const *self,
 									 unsigned int *d,
 									 unsigned int *e);
 
+ccss_selector_program_t *
+ccss_selector_compile (ccss_selector_t const *self);
+
+void
+ccss_selector_program_destroy (ccss_selector_program_t *self);
+
+bool
+ccss_selector_program_query (ccss_selector_program_t const	*self,
+			     ccss_node_t			*node);
+
+uint64_t
+ccss_selector_pseudo_class_mask (ccss_atom_t pseudo_class);
+
 bool
-ccss_selector_query (ccss_selector_t const	*self,
-		     ccss_node_t 		*node);
+ccss_selector_program_may_refer_to (ccss_selector_program_t const	*self,
+				    uint64_t				 mask);
+
+void
+ccss_selector_collect_attribute_names (ccss_selector_t const	*self,
+				       GHashTable		*names);
+
+void
+ccss_selector_collect_pseudo_classes (ccss_selector_t const	*self,
+				      GHashTable		*atoms);
+
+void
+ccss_selector_get_ancestor_hashes (ccss_selector_t const	*self,
+				   ccss_ancestor_hashes_t	*hashes);
 
 bool
 ccss_selector_apply (ccss_selector_t const	*self,
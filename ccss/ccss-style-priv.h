@@ -23,8 +23,10 @@
 #define CCSS_STYLE_PRIV_H
 
 #include <glib.h>
+#include <ccss/ccss-arena-priv.h>
 #include <ccss/ccss-macros.h>
 #include <ccss/ccss-property.h>
+#include <ccss/ccss-property-priv.h>
 #include <ccss/ccss-selector.h>
 #include <ccss/ccss-style.h>
 #include <ccss/ccss-stylesheet.h>
@@ -33,22 +35,83 @@
 
 CCSS_BEGIN_DECLS
 
+typedef struct {
+	GQuark			 id;
+	ccss_property_t const	*property;
+} ccss_style_slot_t;
+
 struct ccss_style_ {
 	/*< private >*/
-	ccss_stylesheet_t	*stylesheet;
-	GHashTable		*properties;
-	double			 viewport_x;
-	double			 viewport_y;
-	double			 viewport_width;
-	double			 viewport_height;
+	int volatile			 reference_count;
+	ccss_stylesheet_t		*stylesheet;
+	ccss_property_slots_t const	*slots;		/* Map at last insert */
+	ccss_style_slot_t		*properties;	/* Indexed by slot */
+	unsigned int			 n_slots;
+	unsigned int			 n_properties;
+	GSList				*blocks;	/* Inline CSS blocks */
+	GSList				*arenas;	/* Holding properties */
+	uint64_t			 properties_hash; /* Sum over properties */
+	double				 viewport_x;
+	double				 viewport_y;
+	double				 viewport_width;
+	double				 viewport_height;
+	void				*draw_record;	/* Drawing library's, g_free()d */
+	ccss_selector_t const		**matched;	/* Sorted, for restyling */
+	unsigned int			 n_matched;
+	unsigned int			 matched_generation;
 #ifdef CCSS_DEBUG
-	GHashTable		*selectors;     /* Property pointers to string */
+	GHashTable			*selectors;     /* Property pointers to string */
 #endif
 };
 
+/*
+ * Every property in the style was inserted after its slot had been assigned,
+ * so the map from the last insertion knows all of them. This is inline
+ * because the drawing libraries look up properties too.
+ */
+static inline ccss_property_t const *
+ccss_style_lookup_property (ccss_style_t const	*self,
+			    GQuark		 property_id)
+{
+	unsigned int slot;
+
+	slot = ccss_property_slots_lookup (self->slots, property_id);
+
+	return slot && slot < self->n_slots ?
+		self->properties[slot].property :
+		NULL;
+}
+
 ccss_style_t *
 ccss_style_create (void);
 
+void
+ccss_style_cache_hold (ccss_style_t *self);
+
+void
+ccss_style_cache_release (ccss_style_t *self);
+
+void
+ccss_style_insert_property (ccss_style_t		*self,
+			    GQuark			 property_id,
+			    ccss_property_t const	*property);
+
+void
+ccss_style_remove_property (ccss_style_t	*self,
+			    GQuark		 property_id);
+
+void
+ccss_style_take_block (ccss_style_t *self,
+		       ccss_block_t *block);
+
+void
+ccss_style_hold_arena (ccss_style_t *self,
+		       ccss_arena_t *arena);
+
+void
+ccss_style_share_blocks (ccss_style_t		*self,
+			 ccss_style_t const	*from);
+
 void
 ccss_style_set_property_selector (ccss_style_t		*self,
 				  ccss_property_t const	*property,
@@ -22,6 +22,7 @@
 
 #include <string.h>
 #include <glib.h>
+#include "ccss-block-priv.h"
 #include "ccss-property-impl.h"
 #include "ccss-style-priv.h"
 #include "config.h"
@@ -37,8 +38,7 @@ ccss_style_create (void)
 	ccss_style_t *self;
 
 	self = g_new0 (ccss_style_t, 1);
-	self->properties = g_hash_table_new ((GHashFunc) g_direct_hash,
-					     (GEqualFunc) g_direct_equal);
+	self->reference_count = 1;
 #ifdef CCSS_DEBUG
 	self->selectors = g_hash_table_new_full ((GHashFunc) g_direct_hash,
 						 (GEqualFunc) g_direct_equal,
@@ -49,34 +49,326 @@ ccss_style_create (void)
 	return self;
 }
 
+static void
+style_free (ccss_style_t *self)
+{
+	g_free (self->properties), self->properties = NULL;
+	g_free (self->draw_record), self->draw_record = NULL;
+	g_free (self->matched), self->matched = NULL;
+	while (self->blocks) {
+		ccss_block_destroy ((ccss_block_t *) self->blocks->data);
+		self->blocks = g_slist_delete_link (self->blocks, self->blocks);
+	}
+	while (self->arenas) {
+		ccss_arena_destroy ((ccss_arena_t *) self->arenas->data);
+		self->arenas = g_slist_delete_link (self->arenas, self->arenas);
+	}
+#ifdef CCSS_DEBUG
+	g_hash_table_destroy (self->selectors), self->selectors = NULL;
+#endif
+	g_free (self);
+}
+
 /**
  * ccss_style_destroy:
  * @self: a #ccss_style_t.
  *
- * Frees the style an all associated resources.
+ * Decreases the reference count on @self by one. If the result is zero, then
+ * @self and all associated resources are freed. See ccss_style_reference().
  **/
 void
 ccss_style_destroy (ccss_style_t *self)
 {
-	g_return_if_fail (self && self->properties);
+	ccss_stylesheet_t *stylesheet;
 
+	g_return_if_fail (self);
+
+	/* Every reference holds a reference on the stylesheet, except the
+	 * one held by the stylesheet's style cache.
+	 * Release the stylesheet last, this may release the cache which
+	 * in turn holds a reference to @self. */
+	stylesheet = self->stylesheet;
+
+	if (g_atomic_int_dec_and_test (&self->reference_count)) {
+		self->stylesheet = NULL;
+		style_free (self);
+	}
+
+	if (stylesheet) {
+		ccss_stylesheet_destroy (stylesheet);
+	}
+}
+
+/**
+ * ccss_style_reference:
+ * @self: a #ccss_style_t.
+ *
+ * Increases the reference count on @self by one. This prevents @self from being
+ * destroyed until a matching call to ccss_style_destroy() is made.
+ *
+ * Returns: the referenced #ccss_style_t.
+ **/
+ccss_style_t *
+ccss_style_reference (ccss_style_t *self)
+{
+	g_return_val_if_fail (self, NULL);
+
+	g_atomic_int_inc (&self->reference_count);
 	if (self->stylesheet) {
-		ccss_stylesheet_destroy (self->stylesheet), self->stylesheet = NULL;
+		ccss_stylesheet_reference (self->stylesheet);
 	}
 
-	g_hash_table_destroy (self->properties), self->properties = NULL;
-#ifdef CCSS_DEBUG
-	g_hash_table_destroy (self->selectors), self->selectors = NULL;
-#endif
-	g_free (self);
+	return self;
+}
+
+/*
+ * Reference held by the stylesheet's style cache. Does not reference the
+ * stylesheet, so the cache doesn't keep its own stylesheet alive.
+ */
+void
+ccss_style_cache_hold (ccss_style_t *self)
+{
+	g_assert (self);
+
+	g_atomic_int_inc (&self->reference_count);
+}
+
+void
+ccss_style_cache_release (ccss_style_t *self)
+{
+	g_assert (self && self->reference_count > 0);
+
+	if (g_atomic_int_dec_and_test (&self->reference_count)) {
+		self->stylesheet = NULL;
+		style_free (self);
+	}
+}
+
+/*
+ * Blocks parsed from inline CSS are owned by the styles that use their
+ * properties, rather than by the stylesheet, which is shared between
+ * queries. Takes over the reference on `block'.
+ */
+void
+ccss_style_take_block (ccss_style_t *self,
+		       ccss_block_t *block)
+{
+	g_assert (self && block);
+
+	self->blocks = g_slist_prepend (self->blocks, block);
+}
+
+/*
+ * Keep the arena holding properties applied from a stylesheet alive, it is
+ * released when the CSS is unloaded.
+ */
+void
+ccss_style_hold_arena (ccss_style_t *self,
+		       ccss_arena_t *arena)
+{
+	g_assert (self && arena);
+
+	/* Styles use few arenas, mostly one. */
+	for (GSList const *iter = self->arenas; iter != NULL; iter = iter->next) {
+		if (arena == iter->data)
+			return;
+	}
+
+	self->arenas = g_slist_prepend (self->arenas,
+					ccss_arena_reference (arena));
+}
+
+/*
+ * Keep the inline blocks and arenas of `from' alive, for when properties are
+ * inherited.
+ */
+void
+ccss_style_share_blocks (ccss_style_t		*self,
+			 ccss_style_t const	*from)
+{
+	g_assert (self && from);
+
+	for (GSList const *iter = from->blocks; iter != NULL; iter = iter->next) {
+		self->blocks = g_slist_prepend (self->blocks,
+				ccss_block_reference ((ccss_block_t *) iter->data));
+	}
+
+	for (GSList const *iter = from->arenas; iter != NULL; iter = iter->next) {
+		ccss_style_hold_arena (self, (ccss_arena_t *) iter->data);
+	}
+}
+
+/* Finalizer from splitmix64, spreads all input bits over the result. */
+static uint64_t
+mix (uint64_t x)
+{
+	x ^= x >> 30;
+	x *= G_GUINT64_CONSTANT (0xbf58476d1ce4e5b9);
+	x ^= x >> 27;
+	x *= G_GUINT64_CONSTANT (0x94d049bb133111eb);
+	x ^= x >> 31;
+
+	return x;
+}
+
+static uint64_t
+property_hash (GQuark			 property_id,
+	       ccss_property_t const	*property)
+{
+	return mix (mix ((uintptr_t) property) + property_id);
+}
+
+/*
+ * Insert a property and update the style's hash. The hash is the sum of
+ * the hashes of all (id, property) pairs, so it does not depend on the order
+ * properties are applied in.
+ */
+void
+ccss_style_insert_property (ccss_style_t		*self,
+			    GQuark			 property_id,
+			    ccss_property_t const	*property)
+{
+	ccss_style_slot_t	*entry;
+	unsigned int		 slot;
+	unsigned int		 n_slots;
+
+	slot = ccss_property_slots_assign (property_id);
+	if (slot >= self->n_slots) {
+		/* Make room for all the slots assigned so far, so this
+		 * rarely happens more than once per style. */
+		n_slots = MAX (slot + 1, ccss_property_slots_get_n_slots ());
+		self->properties = g_renew (ccss_style_slot_t,
+					    self->properties, n_slots);
+		memset (self->properties + self->n_slots, 0,
+			(n_slots - self->n_slots) * sizeof (ccss_style_slot_t));
+		self->n_slots = n_slots;
+	}
+	self->slots = ccss_property_slots_get ();
+
+	entry = &self->properties[slot];
+	if (entry->property == property)
+		return;
+	if (entry->property)
+		self->properties_hash -= property_hash (property_id,
+							entry->property);
+	else
+		self->n_properties++;
+
+	entry->id = property_id;
+	entry->property = property;
+	self->properties_hash += property_hash (property_id, property);
+}
+
+void
+ccss_style_remove_property (ccss_style_t	*self,
+			    GQuark		 property_id)
+{
+	ccss_style_slot_t	*entry;
+	unsigned int		 slot;
+
+	slot = ccss_property_slots_lookup (self->slots, property_id);
+	if (0 == slot || slot >= self->n_slots)
+		return;
+
+	entry = &self->properties[slot];
+	if (entry->property) {
+		self->properties_hash -= property_hash (property_id,
+							entry->property);
+		entry->property = NULL;
+		self->n_properties--;
+	}
+}
+
+/* Bits of a double, with 0.0 and -0.0 hashing alike since they compare
+ * equal. */
+static uint64_t
+double_bits (double value)
+{
+	uint64_t bits;
+
+	if (value == 0)
+		return 0;
+
+	memcpy (&bits, &value, sizeof (bits));
+
+	return bits;
+}
+
+/**
+ * ccss_style_hash64:
+ * @self: a #ccss_style_t.
+ *
+ * Calculates a 64 bit hash value over the identities of the properties in
+ * @self and its viewport. The value does not depend on the order in which
+ * properties have been applied, and styles that are equal according to
+ * ccss_style_equal() have the same hash value. The hash is maintained
+ * while the style is built, so this is cheap.
+ *
+ * Returns: hash value.
+ **/
+uint64_t
+ccss_style_hash64 (ccss_style_t const *self)
+{
+	uint64_t hash;
+
+	g_return_val_if_fail (self, 0);
+
+	hash = self->properties_hash;
+	hash = mix (hash + double_bits (self->viewport_x));
+	hash = mix (hash + double_bits (self->viewport_y));
+	hash = mix (hash + double_bits (self->viewport_width));
+	hash = mix (hash + double_bits (self->viewport_height));
+
+	return hash;
+}
+
+/**
+ * ccss_style_equal:
+ * @self:	a #ccss_style_t.
+ * @other:	another #ccss_style_t.
+ *
+ * Styles are equal when they hold the same property instances under the
+ * same names, and have the same viewport.
+ *
+ * Returns: %TRUE if @self and @other are equal.
+ **/
+bool
+ccss_style_equal (ccss_style_t const	*self,
+		  ccss_style_t const	*other)
+{
+	ccss_style_slot_t const *entry;
+
+	g_return_val_if_fail (self && other, false);
+
+	if (self == other)
+		return true;
+
+	if (self->properties_hash != other->properties_hash ||
+	    self->viewport_x != other->viewport_x ||
+	    self->viewport_y != other->viewport_y ||
+	    self->viewport_width != other->viewport_width ||
+	    self->viewport_height != other->viewport_height ||
+	    self->n_properties != other->n_properties)
+		return false;
+
+	for (unsigned int i = 1; i < self->n_slots; i++) {
+		entry = &self->properties[i];
+		if (entry->property &&
+		    entry->property != ccss_style_lookup_property (other,
+								   entry->id))
+			return false;
+	}
+
+	return true;
 }
 
 /**
  * ccss_style_hash:
  * @self: a #ccss_style_t.
  *
- * Calculates a hash value that uniquely identifies a style. If two styles
- * have the same hash value they are equal.
+ * Calculates a hash value for a style, folded from ccss_style_hash64().
+ * Equal styles have the same hash value, but different styles may collide;
+ * use ccss_style_equal() to tell them apart.
  *
  * A hash value of 0 is returned for %NULL or empty styles.
  *
@@ -85,36 +377,14 @@ ccss_style_destroy (ccss_style_t *self)
 uint32_t
 ccss_style_hash (ccss_style_t const *self)
 {
-	uint32_t hash = 0;
+	uint64_t hash;
 
 	g_return_val_if_fail (self, 0);
-	g_return_val_if_fail (self->properties, 0);
-	g_return_val_if_fail (g_hash_table_size (self->properties), 0);
+	g_return_val_if_fail (self->n_properties, 0);
 
-	{
-	ccss_property_t const	*property;
-	GHashTableIter		 iter;
-	int			 n_properties = g_hash_table_size (self->properties);
-	void			*property_ptrs[n_properties * sizeof (void *) + 1];
-	char const		*property_str = (char const *) property_ptrs;
-	int			 i = 0;
-
-	/* Accumulate string of property pointers. */
-	g_hash_table_iter_init (&iter, self->properties);
-	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &property)) {
-		property_ptrs[i] = (void *) property;
-		i++;
-	}
-	property_ptrs[i] = NULL;
-
-	/* sdbm hash */
-	while (0 != (i = *property_str++)) {
-		hash = i + (hash << 6) + (hash << 16) - hash;
-	}
-
-	}
+	hash = ccss_style_hash64 (self);
 
-	return hash;
+	return (uint32_t) (hash ^ (hash >> 32)) | 1;
 }
 
 /**
@@ -223,7 +493,8 @@ ccss_style_get_property	(ccss_style_t const	 *self,
 			 char const		 *property_name,
 			 ccss_property_t const	**property)
 {
-	GQuark property_id;
+	GQuark			 property_id;
+	ccss_property_t const	*value;
 
 	g_return_val_if_fail (self && property_name && property, false);
 
@@ -233,9 +504,13 @@ ccss_style_get_property	(ccss_style_t const	 *self,
 		return false;
 	}
 
-	return g_hash_table_lookup_extended (self->properties,
-					     (gconstpointer) property_id, NULL,
-					     (void **) property);
+	value = ccss_style_lookup_property (self, property_id);
+	if (NULL == value) {
+		return false;
+	}
+
+	*property = value;
+	return true;
 }
 
 /**
@@ -256,8 +531,29 @@ ccss_style_set_property	(ccss_style_t		*self,
 	g_return_if_fail (self && property_name && value);
 
 	property_id = g_quark_from_string (property_name);
-	g_hash_table_insert (self->properties,
-			     (gpointer) property_id, (gpointer) value);
+	ccss_style_insert_property (self, property_id, value);
+}
+
+/**
+ * ccss_style_unset_property:
+ * @self:		a #ccss_style_t.
+ * @property_name:	name of the property.
+ *
+ * Remove a custom property, see ccss_style_set_property(). This is for
+ * custom property implementations only.
+ **/
+void
+ccss_style_unset_property (ccss_style_t	*self,
+			   char const	*property_name)
+{
+	GQuark property_id;
+
+	g_return_if_fail (self && property_name);
+
+	property_id = g_quark_try_string (property_name);
+	if (property_id) {
+		ccss_style_remove_property (self, property_id);
+	}
 }
 
 /**
@@ -353,9 +649,8 @@ ccss_style_interpret_property (ccss_style_t const	 *self,
 		return false;
 	}
 
-	g_hash_table_lookup_extended (self->properties,
-				      (gconstpointer) property_id, NULL,
-				      (void **) &generic_property);
+	generic_property = (ccss_property_generic_t const *)
+			ccss_style_lookup_property (self, property_id);
 
 	if (generic_property) {
 		*property = property_ctor (ccss_stylesheet_get_grammar (self->stylesheet),
@@ -380,17 +675,16 @@ ccss_style_foreach (ccss_style_t const		*self,
 		    ccss_style_iterator_f	 func,
 		    void			*user_data)
 {
-	GHashTableIter 	 iter;
-	GQuark		 property_id;
-	gpointer	 value;
-	char const	*property_name;
+	char const *property_name;
 
 	g_return_if_fail (self && func);
 
-	g_hash_table_iter_init (&iter, self->properties);
-	while (g_hash_table_iter_next (&iter, (gpointer) &property_id, &value)) {
+	for (unsigned int i = 1; i < self->n_slots; i++) {
 
-		property_name = g_quark_to_string (property_id);
+		if (NULL == self->properties[i].property)
+			continue;
+
+		property_name = g_quark_to_string (self->properties[i].id);
 		func (self, property_name, user_data);
 	}
 }
@@ -404,13 +698,16 @@ ccss_style_foreach (ccss_style_t const		*self,
 void
 ccss_style_dump (ccss_style_t const *self)
 {
-	GHashTableIter		 iter;
 	GQuark			 property_id;
 	ccss_property_t const	*property;
 	char			*strval;
 
-	g_hash_table_iter_init (&iter, self->properties);
-	while (g_hash_table_iter_next (&iter, (gpointer *) &property_id, (gpointer *) &property))  {
+	for (unsigned int i = 1; i < self->n_slots; i++) {
+
+		property_id = self->properties[i].id;
+		property = self->properties[i].property;
+		if (NULL == property)
+			continue;
 
 		strval = NULL;
 		if (CCSS_PROPERTY_STATE_NONE == property->state ||
@@ -41,9 +41,19 @@ typedef struct ccss_style_ ccss_style_t;
 void
 ccss_style_destroy	(ccss_style_t		*self);
 
+ccss_style_t *
+ccss_style_reference	(ccss_style_t		*self);
+
 uint32_t
 ccss_style_hash		(ccss_style_t const     *self);
 
+uint64_t
+ccss_style_hash64	(ccss_style_t const	*self);
+
+bool
+ccss_style_equal	(ccss_style_t const	*self,
+			 ccss_style_t const	*other);
+
 /* Somewhat hackish */
 struct ccss_stylesheet_ *
 ccss_style_get_stylesheet (ccss_style_t const	*self);
@@ -68,6 +78,10 @@ ccss_style_set_property	(ccss_style_t 		*self,
 			 char const		*property_name,
 			 ccss_property_t const	*value);
 
+void
+ccss_style_unset_property (ccss_style_t	*self,
+			   char const	*property_name);
+
 /**
  * ccss_style_iterator_f:
  * @self:		a #ccss_style_t.
@@ -22,6 +22,8 @@
 #ifndef CCSS_STYLESHEET_PRIV_H
 #define CCSS_STYLESHEET_PRIV_H
 
+#include <glib.h>
+#include <ccss/ccss-arena-priv.h>
 #include <ccss/ccss-grammar.h>
 #include <ccss/ccss-macros.h>
 #include <ccss/ccss-stylesheet.h>
@@ -30,21 +32,53 @@ CCSS_BEGIN_DECLS
 
 /**
  * ccss_stylesheet_t:
- * @reference_count:	reference count.
+ * @reference_count:	reference count, updated atomically.
  * @grammar:		The grammar for this stylesheet.
  * @blocks:		List owning all blocks parsed from the stylesheet.
  * @groups:		Associates type names with all applying selectors.
+ * @arenas:		maps descriptors to the arenas holding the selectors
+ *			and blocks parsed from them.
  * @current_descriptor: descriptor of the recently loaded CSS file or buffer.
+ * @generation:		changes whenever CSS is loaded or unloaded, unique
+ *			across stylesheets.
+ * @style_cache:	maps node signatures to shared styles.
+ * @style_cache_size:	maximum number of cached styles, 0 disables the cache.
+ * @style_cache_generation: generation the cached styles were computed for.
+ * @attribute_names:	attribute names used by selectors, part of the
+ *			node signature.
+ * @n_styling_passes:	nesting depth of ccss_stylesheet_begin_styling_pass().
+ * @container_styles:	maps container instances to their own styles during
+ *			a styling pass, for resolving inheritance.
+ * @container_styles_generation: generation the container styles were
+ *			computed for.
+ * @inline_styles:	maps inline CSS strings to their parsed selectors and
+ *			blocks, bounded in size.
+ * @inline_lru:		cached inline styles, most recently used first.
+ * @lock:		guards the caches, so the stylesheet can be queried
+ *			from multiple threads.
  *
  * Represents a parsed instance of a stylesheet.
+ * Everything but the caches is read-only once CSS is loaded.
  **/
 struct ccss_stylesheet_ {
 	/*< private >*/
-	unsigned int	 reference_count;
+	int volatile	 reference_count;
 	ccss_grammar_t	*grammar;
 	GHashTable	*blocks;
 	GHashTable	*groups;
+	GHashTable	*arenas;
 	unsigned int     current_descriptor;
+	unsigned int	 generation;
+	GHashTable	*style_cache;
+	unsigned int	 style_cache_size;
+	unsigned int	 style_cache_generation;
+	GHashTable	*attribute_names;
+	unsigned int	 n_styling_passes;
+	GHashTable	*container_styles;
+	unsigned int	 container_styles_generation;
+	GHashTable	*inline_styles;
+	GQueue		 inline_lru;
+	GStaticMutex	 lock;
 };
 
 ccss_stylesheet_t *
@@ -53,6 +87,13 @@ ccss_stylesheet_create (void);
 void
 ccss_stylesheet_fix_dangling_selectors (ccss_stylesheet_t *self);
 
+void
+ccss_stylesheet_build_index (ccss_stylesheet_t *self);
+
+ccss_arena_t *
+ccss_stylesheet_create_arena (ccss_stylesheet_t	*self,
+			      unsigned int	 descriptor);
+
 CCSS_END_DECLS
 
 #endif /* CCSS_STYLESHEET_PRIV_H */
@@ -21,6 +21,7 @@
 
 #include <string.h>
 #include <glib.h>
+#include "ccss-ancestor-filter-priv.h"
 #include "ccss-block-priv.h"
 #include "ccss-grammar-priv.h"
 #include "ccss-node-priv.h"
@@ -31,6 +32,17 @@
 #include "ccss-stylesheet-priv.h"
 #include "config.h"
 
+/* Generations are unique across all stylesheets, so caches keyed by
+ * stylesheet and generation never mistake a reallocated stylesheet for
+ * one that has been destroyed. */
+static int volatile _generation = 0;
+
+static unsigned int
+next_generation (void)
+{
+	return (unsigned int) g_atomic_int_exchange_and_add (&_generation, 1) + 1;
+}
+
 ccss_stylesheet_t *
 ccss_stylesheet_create (void)
 {
@@ -38,6 +50,7 @@ ccss_stylesheet_create (void)
 
 	self = g_new0 (ccss_stylesheet_t, 1);
 	self->reference_count = 1;
+	self->generation = next_generation ();
 	self->blocks = g_hash_table_new_full (g_direct_hash,
 					      g_direct_equal,
 					      NULL,
@@ -46,10 +59,35 @@ ccss_stylesheet_create (void)
 					      g_str_equal,
 					      NULL,
 					      (GDestroyNotify) ccss_selector_group_destroy);
+	self->arenas = g_hash_table_new_full (g_direct_hash,
+					      g_direct_equal,
+					      NULL,
+					      (GDestroyNotify) ccss_arena_destroy);
+	g_static_mutex_init (&self->lock);
 
 	return self;
 }
 
+/*
+ * Selectors and blocks parsed from a CSS file or buffer are allocated from
+ * an arena. The stylesheet holds one reference until the descriptor is
+ * unloaded, styles using the properties hold others.
+ */
+ccss_arena_t *
+ccss_stylesheet_create_arena (ccss_stylesheet_t	*self,
+			      unsigned int	 descriptor)
+{
+	ccss_arena_t *arena;
+
+	g_assert (self && descriptor);
+
+	arena = ccss_arena_create ();
+	g_hash_table_insert (self->arenas, GUINT_TO_POINTER (descriptor),
+			     arena);
+
+	return arena;
+}
+
 void
 ccss_stylesheet_fix_dangling_selectors (ccss_stylesheet_t *self)
 {
@@ -94,6 +132,21 @@ ccss_stylesheet_fix_dangling_selectors (ccss_stylesheet_t *self)
 	}
 }
 
+/*
+ * Bring the selector groups' indices up to date after loading or unloading.
+ */
+void
+ccss_stylesheet_build_index (ccss_stylesheet_t *self)
+{
+	GHashTableIter		 iter;
+	ccss_selector_group_t	*group;
+
+	g_hash_table_iter_init (&iter, self->groups);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &group)) {
+		ccss_selector_group_build_index (group);
+	}
+}
+
 /**
  * ccss_stylesheet_add_from_file:
  * @self:	a #ccss_stylesheet_t.
@@ -112,17 +165,21 @@ ccss_stylesheet_add_from_file (ccss_stylesheet_t		*self,
 			       ccss_stylesheet_precedence_t	 precedence,
 			       void				*user_data)
 {
-	enum CRStatus ret;
+	ccss_arena_t	*arena;
+	enum CRStatus	 ret;
 
 	g_return_val_if_fail (self, 0);
 	g_return_val_if_fail (css_file, 0);
 
 	self->current_descriptor++;
+	arena = ccss_stylesheet_create_arena (self, self->current_descriptor);
 	ret = ccss_grammar_parse_file (self->grammar, css_file, precedence,
-				       self->current_descriptor,
+				       self->current_descriptor, arena,
 				       user_data, self->groups, self->blocks);
 	if (CR_OK == ret) {
 		ccss_stylesheet_fix_dangling_selectors (self);
+		ccss_stylesheet_build_index (self);
+		self->generation = next_generation ();
 		return self->current_descriptor;
 	} else {
 		ccss_stylesheet_unload (self, self->current_descriptor);
@@ -150,19 +207,23 @@ ccss_stylesheet_add_from_buffer	(ccss_stylesheet_t		*self,
 				 ccss_stylesheet_precedence_t	 precedence,
 				 void				*user_data)
 {
-	enum CRStatus ret;
+	ccss_arena_t	*arena;
+	enum CRStatus	 ret;
 
 	g_return_val_if_fail (self, 0);
 	g_return_val_if_fail (buffer, 0);
 	g_return_val_if_fail (size, 0);
 
 	self->current_descriptor++;
+	arena = ccss_stylesheet_create_arena (self, self->current_descriptor);
 	ret = ccss_grammar_parse_buffer (self->grammar, buffer, size, precedence,
-					 self->current_descriptor,
+					 self->current_descriptor, arena,
 					 user_data,
 					 self->groups, self->blocks);
 	if (CR_OK == ret) {
 		ccss_stylesheet_fix_dangling_selectors (self);
+		ccss_stylesheet_build_index (self);
+		self->generation = next_generation ();
 		return self->current_descriptor;
 	} else {
 		ccss_stylesheet_unload (self, self->current_descriptor);
@@ -184,6 +245,8 @@ ccss_stylesheet_unload (ccss_stylesheet_t	*self,
 			unsigned int		 descriptor)
 {
 	ccss_selector_group_t	*group;
+	ccss_block_t		*block;
+	ccss_arena_t		*arena;
 	GHashTableIter		 iter;
 	bool			 ret;
 
@@ -195,6 +258,25 @@ ccss_stylesheet_unload (ccss_stylesheet_t	*self,
 		ret |= ccss_selector_group_unload (group, descriptor);
 	}
 
+	/* Release the arena, once styles using its properties are gone. */
+	arena = (ccss_arena_t *) g_hash_table_lookup (self->arenas,
+					GUINT_TO_POINTER (descriptor));
+	if (arena) {
+		g_hash_table_iter_init (&iter, self->blocks);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &block,
+					       NULL)) {
+			if (block->arena == arena)
+				g_hash_table_iter_remove (&iter);
+		}
+		g_hash_table_remove (self->arenas,
+				     GUINT_TO_POINTER (descriptor));
+	}
+
+	if (ret) {
+		ccss_stylesheet_build_index (self);
+		self->generation = next_generation ();
+	}
+
 	return ret;
 }
 
@@ -210,12 +292,28 @@ ccss_stylesheet_destroy (ccss_stylesheet_t *self)
 {
 	g_assert (self);
 
-	self->reference_count--;
-
-	if (0 == self->reference_count) {
+	if (g_atomic_int_dec_and_test (&self->reference_count)) {
+		if (self->inline_styles) {
+			g_hash_table_destroy (self->inline_styles);
+			self->inline_styles = NULL;
+			g_queue_init (&self->inline_lru);
+		}
+		if (self->style_cache) {
+			g_hash_table_destroy (self->style_cache);
+			self->style_cache = NULL;
+			g_hash_table_destroy (self->attribute_names);
+			self->attribute_names = NULL;
+		}
+		if (self->container_styles) {
+			g_hash_table_destroy (self->container_styles);
+			self->container_styles = NULL;
+		}
 		ccss_grammar_destroy (self->grammar), self->grammar = NULL;
 		g_hash_table_destroy (self->blocks), self->blocks = NULL;
 		g_hash_table_destroy (self->groups), self->groups = NULL;
+		/* Selectors are gone, the arenas may go too. */
+		g_hash_table_destroy (self->arenas), self->arenas = NULL;
+		g_static_mutex_free (&self->lock);
 		g_free (self);
 	}
 }
@@ -237,7 +335,7 @@ ccss_stylesheet_reference (ccss_stylesheet_t *self)
 {
 	g_return_val_if_fail (self, NULL);
 
-	self->reference_count++;
+	g_atomic_int_inc (&self->reference_count);
 
 	return self;
 }
@@ -254,7 +352,7 @@ ccss_stylesheet_get_reference_count (ccss_stylesheet_t const *self)
 {
 	g_return_val_if_fail (self, 0);
 
-	return self->reference_count;
+	return g_atomic_int_get ((int *) &self->reference_count);
 }
 
 /**
@@ -318,7 +416,8 @@ query_type_r (ccss_stylesheet_t const	*self,
 	      ccss_node_t 		*node,
 	      ccss_node_t 		*iter,
 	      bool			 as_base,
-	      ccss_selector_group_t	*result_group)
+	      ccss_ancestor_filter_t	**filter,
+	      ccss_selector_match_list_t	*matches)
 {
 	ccss_selector_group_t	*group;
 	char const		*type_name;
@@ -337,13 +436,15 @@ query_type_r (ccss_stylesheet_t const	*self,
 
 		group = g_hash_table_lookup (self->groups, type_name);
 		if (group) {
-			ret = ccss_selector_group_query (group, node, as_base, result_group);
+			ret = ccss_selector_group_query (group, node, as_base,
+							 filter, matches);
 		}
 
 		/* Try to match base types. */
 		base = ccss_node_get_base_style (iter);
 		if (base) {
-			ret |= query_type_r (self, node, base, true, result_group);
+			ret |= query_type_r (self, node, base, true, filter,
+					     matches);
 			ccss_node_release (base);
 		}
 	} else {
@@ -353,37 +454,220 @@ query_type_r (ccss_stylesheet_t const	*self,
 	return ret;
 }
 
+/* Maximum number of parsed inline styles kept per stylesheet. */
+#define INLINE_CACHE_SIZE 256
+
+/*
+ * Inline CSS parsed once and shared by all nodes using the same string.
+ * The instance selectors carry the instance of the node that was parsed
+ * first, they are only applied and never matched.
+ */
+typedef struct {
+	int volatile	 reference_count;
+	GSList		*selectors;
+	GSList		*blocks;
+	bool		 is_valid;
+	GList		 link;		/* In the LRU while cached. */
+	char const	*inline_css;	/* Key in the cache. */
+} inline_style_t;
+
+static void
+inline_style_release (inline_style_t *self)
+{
+	if (!g_atomic_int_dec_and_test (&self->reference_count))
+		return;
+
+	while (self->selectors) {
+		ccss_selector_destroy ((ccss_selector_t *) self->selectors->data);
+		self->selectors = g_slist_delete_link (self->selectors,
+						       self->selectors);
+	}
+	while (self->blocks) {
+		ccss_block_destroy ((ccss_block_t *) self->blocks->data);
+		self->blocks = g_slist_delete_link (self->blocks, self->blocks);
+	}
+	g_free (self);
+}
+
+static inline_style_t *
+parse_inline_style (ccss_stylesheet_t const	*self,
+		    char const			*inline_css,
+		    unsigned int		 descriptor,
+		    ptrdiff_t			 instance)
+{
+	inline_style_t	*inline_style;
+	GHashTable	*blocks;
+	GHashTableIter	 iter;
+	ccss_block_t	*block;
+	enum CRStatus	 status;
+
+	inline_style = g_new0 (inline_style_t, 1);
+	inline_style->reference_count = 1;
+	inline_style->link.data = inline_style;
+
+	/* FIXME: user_data inline styling. Maybe require
+	 * having the node's style registered explicitely? */
+	blocks = g_hash_table_new (g_direct_hash, g_direct_equal);
+	status = ccss_grammar_parse_inline (self->grammar, inline_css,
+					    CCSS_STYLESHEET_AUTHOR,
+					    descriptor, instance, NULL,
+					    &inline_style->selectors, blocks);
+	inline_style->is_valid = (status == CR_OK);
+
+	g_hash_table_iter_init (&iter, blocks);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &block)) {
+		inline_style->blocks = g_slist_prepend (inline_style->blocks,
+							block);
+	}
+	g_hash_table_destroy (blocks);
+
+	return inline_style;
+}
+
+/*
+ * Drop the least recently used inline style from the cache, styles may
+ * still hold on to it. Called with the lock held.
+ */
+static void
+evict_inline_style (ccss_stylesheet_t *self)
+{
+	inline_style_t *inline_style;
+
+	inline_style = (inline_style_t *) self->inline_lru.tail->data;
+	g_queue_unlink (&self->inline_lru, &inline_style->link);
+
+	/* Frees the key and releases the cache's reference. */
+	g_hash_table_remove (self->inline_styles, inline_style->inline_css);
+}
+
+/*
+ * Look up parsed inline CSS, parse and cache it on a miss.
+ * Nodes of long lists mostly share a few inline styles.
+ */
+static inline_style_t *
+get_inline_style (ccss_stylesheet_t	*self,
+		  char const		*inline_css,
+		  unsigned int		 descriptor,
+		  ptrdiff_t		 instance)
+{
+	inline_style_t *inline_style;
+	inline_style_t *parsed;
+
+	g_static_mutex_lock (&self->lock);
+	if (NULL == self->inline_styles) {
+		self->inline_styles = g_hash_table_new_full (g_str_hash,
+				g_str_equal, g_free,
+				(GDestroyNotify) inline_style_release);
+	}
+	inline_style = (inline_style_t *) g_hash_table_lookup (
+						self->inline_styles,
+						inline_css);
+	if (inline_style) {
+		g_atomic_int_inc (&inline_style->reference_count);
+		g_queue_unlink (&self->inline_lru, &inline_style->link);
+		g_queue_push_head_link (&self->inline_lru, &inline_style->link);
+	}
+	g_static_mutex_unlock (&self->lock);
+
+	if (inline_style)
+		return inline_style;
+
+	/* Parse unlocked, another thread may cache the same string
+	 * meanwhile, which is then used instead. */
+	parsed = parse_inline_style (self, inline_css, descriptor, instance);
+
+	g_static_mutex_lock (&self->lock);
+	inline_style = (inline_style_t *) g_hash_table_lookup (
+						self->inline_styles,
+						inline_css);
+	if (NULL == inline_style) {
+		if (g_hash_table_size (self->inline_styles) >=
+		    INLINE_CACHE_SIZE) {
+			evict_inline_style (self);
+		}
+		inline_style = parsed, parsed = NULL;
+		inline_style->inline_css = g_strdup (inline_css);
+		g_atomic_int_inc (&inline_style->reference_count);
+		g_hash_table_insert (self->inline_styles,
+				     (char *) inline_style->inline_css,
+				     inline_style);
+	} else {
+		g_atomic_int_inc (&inline_style->reference_count);
+		g_queue_unlink (&self->inline_lru, &inline_style->link);
+	}
+	g_queue_push_head_link (&self->inline_lru, &inline_style->link);
+	g_static_mutex_unlock (&self->lock);
+
+	if (parsed) {
+		inline_style_release (parsed);
+	}
+
+	return inline_style;
+}
+
+/*
+ * Selectors that matched for a previous style of the node, and the
+ * pseudo-classes that changed since, see ccss_stylesheet_restyle().
+ */
+typedef struct {
+	ccss_style_t const	*previous;
+	uint64_t		 changed_mask;
+} restyle_info_t;
+
 /*
  * Do not recurse containers.
+ * `ancestor_filter' may be NULL, then a filter is built if needed.
+ * `restyle' is NULL unless restyling.
  */
 static bool
-query_node (ccss_stylesheet_t 	*self,
-	    ccss_node_t 	*node,
-	    ccss_style_t	*style)
+query_node (ccss_stylesheet_t 		*self,
+	    ccss_node_t 		*node,
+	    ccss_ancestor_filter_t	*ancestor_filter,
+	    restyle_info_t const	*restyle,
+	    ccss_style_t		*style)
 {
 	ccss_selector_group_t const	*universal_group;
-	ccss_selector_group_t		*result_group;
+	ccss_ancestor_filter_t		*filter;
+	ccss_selector_match_list_t	 matches;
+	inline_style_t			*inline_style;
 	char const			*inline_css;
 	unsigned int			 prospective_descriptor;
-	enum CRStatus			 status;
 	bool				 ret;
 
 	g_return_val_if_fail (self && node && style, false);
 
-	result_group = ccss_selector_group_create ();
+	ccss_selector_match_list_init (&matches);
+	if (restyle) {
+		matches.previous = restyle->previous->matched;
+		matches.n_previous = restyle->previous->n_matched;
+		matches.changed_mask = restyle->changed_mask;
+	}
+	filter = ancestor_filter;
+	inline_style = NULL;
 	ret = false;
 
 	/* Match wildcard styles. */
 	universal_group = g_hash_table_lookup (self->groups, "*");
 	if (universal_group) {
 		ret |= ccss_selector_group_query (universal_group, node,
-						  false, result_group);
+						  false, &filter, &matches);
 	}
 
 	/* Match style by type information. */
-	ret |= query_type_r (self, node, node, false, result_group);
+	ret |= query_type_r (self, node, node, false, &filter, &matches);
+
+	if (filter != ancestor_filter) {
+		ccss_ancestor_filter_destroy (filter), filter = NULL;
+	}
+
+	/* Remember the stylesheet's matching selectors for restyling. */
+	style->matched = ccss_selector_match_list_dup_selectors (&matches,
+							&style->n_matched);
+	style->matched_generation = self->generation;
 
-	/* Handle inline styling. */
+	/* Handle inline styling. The parsed selectors and blocks are shared
+	 * through the inline style cache, not added to the stylesheet, so
+	 * concurrent queries don't interfere. */
 	prospective_descriptor = self->current_descriptor + 1;
 	inline_css = ccss_node_get_style (node, prospective_descriptor);
 	if (inline_css) {
@@ -392,29 +676,37 @@ query_node (ccss_stylesheet_t 	*self,
 		if (instance == 0) {
 			g_warning ("Inline CSS `%s' but instance == 0\n", inline_css);
 		} else {
-			/* FIXME: user_data inline styling. Maybe require
-			 * having the node's style registered explicitely? */
-			status = ccss_grammar_parse_inline (self->grammar,
-							    inline_css,
-							    CCSS_STYLESHEET_AUTHOR,
-							    prospective_descriptor,
-							    instance, NULL,
-							    result_group,
-							    self->blocks);
-			ret |= (status == CR_OK);
-			if (CR_OK == ret) {
-				self->current_descriptor = prospective_descriptor;
-			} else {
-				ccss_stylesheet_unload (self,
-							prospective_descriptor);
+			inline_style = get_inline_style (self, inline_css,
+							 prospective_descriptor,
+							 instance);
+			ret |= inline_style->is_valid;
+
+			/* The style keeps the properties alive. */
+			for (GSList const *iter = inline_style->blocks;
+			     iter != NULL;
+			     iter = iter->next) {
+				ccss_style_take_block (style,
+					ccss_block_reference ((ccss_block_t *) iter->data));
+			}
+
+			for (GSList const *iter = inline_style->selectors;
+			     iter != NULL;
+			     iter = iter->next) {
+				ccss_selector_match_list_append (&matches,
+					(ccss_selector_t const *) iter->data,
+					ccss_selector_get_specificity (
+						(ccss_selector_t const *) iter->data));
 			}
 		}
 	}
 
 	/* Apply collected style. */
-	ret |= ccss_selector_group_apply (result_group, node, style);
+	ret |= ccss_selector_match_list_apply (&matches, node, style);
 
-	ccss_selector_group_destroy (result_group), result_group = NULL;
+	ccss_selector_match_list_clear (&matches);
+	if (inline_style) {
+		inline_style_release (inline_style), inline_style = NULL;
+	}
 
 	return ret;
 }
@@ -429,15 +721,18 @@ inherit_container_style (ccss_style_t const	*container_style,
 	ccss_property_t const	*property;
 	GSList			*removals;
 
+	/* Properties may stem from the container's inline CSS, or CSS
+	 * that is unloaded meanwhile. */
+	ccss_style_share_blocks (style, container_style);
+
 	/* Check which properties from the `inherit' set can be resolved. */
 	removals = NULL;
 	g_hash_table_iter_init (&iter, inherit);
 	while (g_hash_table_iter_next (&iter, (gpointer *) &property_id, NULL)) {
 
 		/* Look up property in the container's style. */
-		property = (ccss_property_t const *)
-				g_hash_table_lookup (container_style->properties,
-						     (gpointer) property_id);
+		property = ccss_style_lookup_property (container_style,
+						       property_id);
 		if (property &&
 		    (CCSS_PROPERTY_STATE_NONE == property->state ||
 		     CCSS_PROPERTY_STATE_SET == property->state)) {
@@ -453,9 +748,8 @@ inherit_container_style (ccss_style_t const	*container_style,
 				is_resolved = property->vtable->inherit
 						(container_style, style);
 			} else {
-				g_hash_table_insert (style->properties,
-						     (gpointer) property_id,
-						     (gpointer) property);
+				ccss_style_insert_property (style, property_id,
+							    property);
 				is_resolved = true;
 #ifdef CCSS_DEBUG
 {
@@ -489,6 +783,123 @@ inherit_container_style (ccss_style_t const	*container_style,
 	}
 }
 
+static void
+free_container_style (ccss_style_t *style)
+{
+	/* NULL marks containers without styling. */
+	if (style) {
+		ccss_style_destroy (style);
+	}
+}
+
+/*
+ * Query a container's own style, without resolving its inherited properties.
+ * During a styling pass the result is remembered per node instance, so
+ * siblings share the container's style.
+ * Returns a new reference or NULL if nothing matched.
+ */
+static ccss_style_t *
+query_container_style (ccss_stylesheet_t	*self,
+		       ccss_node_t		*container)
+{
+	ccss_style_t	*container_style;
+	ptrdiff_t	 instance;
+	void		*value;
+	bool		 ret;
+
+	instance = ccss_node_get_instance (container);
+
+	g_static_mutex_lock (&self->lock);
+	if (self->container_styles) {
+		if (self->container_styles_generation != self->generation) {
+			g_hash_table_remove_all (self->container_styles);
+			self->container_styles_generation = self->generation;
+		}
+		if (instance &&
+		    g_hash_table_lookup_extended (self->container_styles,
+						  (gconstpointer) instance,
+						  NULL, &value)) {
+			container_style = (ccss_style_t *) value;
+			if (container_style) {
+				ccss_style_reference (container_style);
+			}
+			g_static_mutex_unlock (&self->lock);
+			return container_style;
+		}
+	}
+	g_static_mutex_unlock (&self->lock);
+
+	container_style = ccss_style_create ();
+	ret = query_node (self, container, NULL, NULL, container_style);
+	if (!ret) {
+		ccss_style_destroy (container_style), container_style = NULL;
+	}
+
+	/* Another thread may have resolved the same container meanwhile,
+	 * replacing its result is harmless. */
+	g_static_mutex_lock (&self->lock);
+	if (self->container_styles && instance) {
+		g_hash_table_replace (self->container_styles,
+				      (gpointer) instance,
+				      container_style ?
+					ccss_style_reference (container_style) :
+					NULL);
+	}
+	g_static_mutex_unlock (&self->lock);
+
+	return container_style;
+}
+
+/**
+ * ccss_stylesheet_begin_styling_pass:
+ * @self:	a #ccss_stylesheet_t.
+ *
+ * Start a styling pass, during which the document is assumed not to change.
+ * Styles of containers are then resolved only once per node instance
+ * (see #ccss_node_get_instance_f) when looking up inherited properties,
+ * instead of once for every node that inherits from them.
+ * Passes may nest, each call must be matched by
+ * ccss_stylesheet_end_styling_pass().
+ **/
+void
+ccss_stylesheet_begin_styling_pass (ccss_stylesheet_t *self)
+{
+	g_return_if_fail (self);
+
+	g_static_mutex_lock (&self->lock);
+	if (0 == self->n_styling_passes) {
+		self->container_styles = g_hash_table_new_full (g_direct_hash,
+					g_direct_equal, NULL,
+					(GDestroyNotify) free_container_style);
+		self->container_styles_generation = self->generation;
+	}
+
+	self->n_styling_passes++;
+	g_static_mutex_unlock (&self->lock);
+}
+
+/**
+ * ccss_stylesheet_end_styling_pass:
+ * @self:	a #ccss_stylesheet_t.
+ *
+ * End a styling pass started with ccss_stylesheet_begin_styling_pass().
+ **/
+void
+ccss_stylesheet_end_styling_pass (ccss_stylesheet_t *self)
+{
+	g_return_if_fail (self);
+
+	g_static_mutex_lock (&self->lock);
+	g_assert (self->n_styling_passes > 0);
+	self->n_styling_passes--;
+
+	if (0 == self->n_styling_passes) {
+		g_hash_table_destroy (self->container_styles);
+		self->container_styles = NULL;
+	}
+	g_static_mutex_unlock (&self->lock);
+}
+
 /**
  * query_container_r:
  * @self:	a #ccss_style_t.
@@ -519,12 +930,12 @@ query_container_r (ccss_stylesheet_t 	*self,
 		return false;
 
 	/* Have styling? */
-	container_style = ccss_style_create ();
-	ret = query_node (self, container, container_style);
+	container_style = query_container_style (self, container);
+	ret = (bool) container_style;
 	if (ret) {
 		inherit_container_style (container_style, inherit, style);
+		ccss_style_destroy (container_style), container_style = NULL;
 	}
-	ccss_style_destroy (container_style), container_style = NULL;
 
 	if (0 == g_hash_table_size (inherit)) {
 		/* Nothing more to inherit, good! */
@@ -534,26 +945,74 @@ query_container_r (ccss_stylesheet_t 	*self,
 		query_container_r (self, container, inherit, style);
 	}
 
-	ccss_node_release (container), container = NULL;
-
 	/* Return true if some styling has been found, not necessarily all
 	 * properties resolved. */
 	return ret;
 }
 
-/**
- * ccss_stylesheet_query:
- * @self:	a #ccss_stylesheet_t.
- * @node:	a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
- *
- * Query the stylesheet for styling information regarding a document node and apply the results to a #ccss_style_t object.
- *
- * Returns: a #ccss_style_t that the results of the query are applied to or
- *	    %NULL if the query didn't yield results.
- **/
-ccss_style_t *
-ccss_stylesheet_query (ccss_stylesheet_t 	*self,
-		       ccss_node_t		*node)
+/*
+ * State shared while styling a subtree top-down, see
+ * ccss_stylesheet_query_tree().
+ * `ancestor_styles' holds the resolved styles from the subtree's `root' down
+ * to the parent of the node being queried, entries may be NULL. `filter'
+ * holds the containers of that node.
+ */
+typedef struct {
+	ccss_node_t		*root;
+	ccss_ancestor_filter_t	*filter;
+	GPtrArray		*ancestor_styles;
+	ccss_stylesheet_child_f	 get_child;
+	ccss_stylesheet_style_f	 func;
+	void			*user_data;
+} query_tree_info_t;
+
+/*
+ * Like query_container_r(), but inherit from the containers' styles that have
+ * already been resolved while walking the tree. A container's resolved style
+ * holds its own properties and those it inherited, so the first container
+ * that has a property yields the same result as querying all of them.
+ */
+static bool
+inherit_from_tree (ccss_stylesheet_t		*self,
+		   query_tree_info_t const	*info,
+		   GHashTable			*inherit,
+		   ccss_style_t			*style)
+{
+	ccss_style_t const	*container_style;
+	bool			 ret;
+
+	ret = false;
+	for (unsigned int i = info->ancestor_styles->len; i > 0; i--) {
+
+		container_style = (ccss_style_t const *)
+				g_ptr_array_index (info->ancestor_styles, i - 1);
+		if (NULL == container_style)
+			continue;
+
+		ret = true;
+		inherit_container_style (container_style, inherit, style);
+		if (0 == g_hash_table_size (inherit)) {
+			/* Nothing more to inherit, good! */
+			return true;
+		}
+	}
+
+	/* Continue above the subtree. */
+	ret |= query_container_r (self, info->root, inherit, style);
+
+	return ret;
+}
+
+/*
+ * `tree' is NULL unless styling a subtree top-down, `restyle' unless
+ * restyling.
+ */
+static ccss_style_t *
+query (ccss_stylesheet_t	*self,
+       ccss_node_t		*node,
+       ccss_ancestor_filter_t	*filter,
+       query_tree_info_t const	*tree,
+       restyle_info_t const	*restyle)
 {
 	GHashTable		*inherit;
 	GHashTableIter		 iter;
@@ -562,23 +1021,22 @@ ccss_stylesheet_query (ccss_stylesheet_t 	*self,
 	ccss_style_t		*style;
 	bool			 ret;
 
-	g_return_val_if_fail (self, NULL);
-	g_return_val_if_fail (node, NULL);
-
 	style = ccss_style_create ();
 	style->stylesheet = ccss_stylesheet_reference (self);
 
 	/* Apply this node's styling. */
-	ret = query_node (self, node, style);
+	ret = query_node (self, node, filter, restyle, style);
 
 	/* Handle inherited styling. */
 	inherit = g_hash_table_new ((GHashFunc) g_direct_hash,
 				    (GEqualFunc) g_direct_equal);
 
-	g_hash_table_iter_init (&iter, style->properties);
-	while (g_hash_table_iter_next (&iter, (gpointer *) &property_id, (gpointer *) &property)) {
+	for (unsigned int i = 1; i < style->n_slots; i++) {
 
-		if (CCSS_PROPERTY_STATE_INHERIT == property->state) {
+		property_id = style->properties[i].id;
+		property = style->properties[i].property;
+		if (property &&
+		    CCSS_PROPERTY_STATE_INHERIT == property->state) {
 
 			g_hash_table_insert (inherit,
 					     (gpointer) property_id,
@@ -589,6 +1047,8 @@ ccss_stylesheet_query (ccss_stylesheet_t 	*self,
 	if (0 == g_hash_table_size (inherit)) {
 		/* Nothing to inherit, good! */
 		ret |= true;
+	} else if (tree && tree->ancestor_styles->len) {
+		ret |= inherit_from_tree (self, tree, inherit, style);
 	} else {
 		ret |= query_container_r (self, node, inherit, style);
 	}
@@ -597,7 +1057,7 @@ ccss_stylesheet_query (ccss_stylesheet_t 	*self,
 	g_hash_table_iter_init (&iter, inherit);
 	while (g_hash_table_iter_next (&iter, (gpointer *) &property_id, (gpointer *) &property)) {
 
-		g_hash_table_remove (style->properties, (gpointer) property_id);
+		ccss_style_remove_property (style, property_id);
 	}
 	g_hash_table_destroy (inherit), inherit = NULL;
 
@@ -610,6 +1070,570 @@ ccss_stylesheet_query (ccss_stylesheet_t 	*self,
 	return style;
 }
 
+static void
+append_node_facts (ccss_stylesheet_t const	*self,
+		   ccss_node_t			*node,
+		   GString			*signature)
+{
+	GHashTableIter	  iter;
+	ccss_node_t	 *base;
+	ccss_node_t	 *next;
+	char const	 *name;
+	char const	**names;
+	char		 *value;
+
+	name = ccss_node_get_type (node);
+	if (name) {
+		g_string_append_printf (signature, "%s\x1f", name);
+	}
+
+	/* Base styles, see query_type_r(). */
+	base = ccss_node_get_base_style (node);
+	while (base) {
+		name = ccss_node_get_type (base);
+		if (name) {
+			g_string_append_printf (signature, "<%s\x1f", name);
+		}
+		next = ccss_node_get_base_style (base);
+		ccss_node_release (base);
+		base = next;
+	}
+
+	name = ccss_node_get_id (node);
+	if (name) {
+		g_string_append_printf (signature, "#%s\x1f", name);
+	}
+
+	for (names = ccss_node_get_classes (node); names && *names; names++) {
+		g_string_append_printf (signature, ".%s\x1f", *names);
+	}
+
+	for (names = ccss_node_get_pseudo_classes (node);
+	     names && *names;
+	     names++) {
+		g_string_append_printf (signature, ":%s\x1f", *names);
+	}
+
+	g_hash_table_iter_init (&iter, self->attribute_names);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &name, NULL)) {
+		value = ccss_node_get_attribute (node, name);
+		if (value) {
+			g_string_append_printf (signature, "[%s=%s\x1f",
+						name, value);
+			g_free (value), value = NULL;
+		}
+	}
+
+	name = ccss_node_get_style (node, self->current_descriptor + 1);
+	if (name) {
+		g_string_append_printf (signature, "{%s\x1f", name);
+	}
+}
+
+/*
+ * Serialize everything the selection engine may ask the node and its
+ * containers about. Nodes with equal signatures yield equal styles.
+ */
+static char *
+node_signature (ccss_stylesheet_t const	*self,
+		ccss_node_t		*node)
+{
+	GString		*signature;
+	ccss_node_t	*container;
+	double		 x, y, width, height;
+	bool		 ret;
+
+	signature = g_string_new (NULL);
+
+	append_node_facts (self, node, signature);
+
+	/* The viewport is stored in the style. */
+	ret = ccss_node_get_viewport (node, &x, &y, &width, &height);
+	if (ret) {
+		g_string_append_printf (signature, "@%g,%g,%g,%g\x1f",
+					x, y, width, height);
+	}
+
+	/* Containers take part in matching and inheritance. */
+	container = ccss_node_get_container (node);
+	while (container) {
+		g_string_append_c (signature, '\x1e');
+		append_node_facts (self, container, signature);
+		container = ccss_node_get_container (container);
+	}
+
+	return g_string_free (signature, false);
+}
+
+/*
+ * Drop the cached styles if CSS has been loaded or unloaded since they have
+ * been computed. Called with the lock held.
+ */
+static void
+validate_style_cache (ccss_stylesheet_t *self)
+{
+	GHashTableIter		 iter;
+	ccss_selector_group_t	*group;
+
+	if (self->style_cache_generation == self->generation)
+		return;
+
+	g_hash_table_remove_all (self->style_cache);
+	g_hash_table_remove_all (self->attribute_names);
+
+	g_hash_table_iter_init (&iter, self->groups);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &group)) {
+		ccss_selector_group_collect_attribute_names (group,
+						self->attribute_names);
+	}
+
+	self->style_cache_generation = self->generation;
+}
+
+/**
+ * ccss_stylesheet_set_style_cache_size:
+ * @self:	a #ccss_stylesheet_t.
+ * @n_styles:	maximum number of styles to cache, 0 disables caching.
+ *
+ * Enable caching of the styles returned by ccss_stylesheet_query(). Nodes
+ * that look the same to the selection engine, including their containers,
+ * then share a single #ccss_style_t instance. Cached styles must therefore
+ * not be modified.
+ *
+ * The cache is flushed when CSS is loaded or unloaded, and when it grows
+ * beyond @n_styles entries.
+ **/
+void
+ccss_stylesheet_set_style_cache_size (ccss_stylesheet_t	*self,
+				      unsigned int	 n_styles)
+{
+	g_return_if_fail (self);
+
+	g_static_mutex_lock (&self->lock);
+
+	self->style_cache_size = n_styles;
+
+	if (0 == n_styles) {
+		if (self->style_cache) {
+			g_hash_table_destroy (self->style_cache);
+			self->style_cache = NULL;
+			g_hash_table_destroy (self->attribute_names);
+			self->attribute_names = NULL;
+		}
+		g_static_mutex_unlock (&self->lock);
+		return;
+	}
+
+	if (NULL == self->style_cache) {
+		self->style_cache = g_hash_table_new_full (g_str_hash,
+				g_str_equal, g_free,
+				(GDestroyNotify) ccss_style_cache_release);
+		self->attribute_names = g_hash_table_new_full (g_str_hash,
+				g_str_equal, g_free, NULL);
+		/* Force collection of attribute names. */
+		self->style_cache_generation = self->generation - 1;
+	} else if (g_hash_table_size (self->style_cache) > n_styles) {
+		g_hash_table_remove_all (self->style_cache);
+	}
+
+	g_static_mutex_unlock (&self->lock);
+}
+
+/*
+ * Look up the style cache, if enabled, before querying.
+ */
+static ccss_style_t *
+cached_query (ccss_stylesheet_t		*self,
+	      ccss_node_t		*node,
+	      ccss_ancestor_filter_t	*filter,
+	      query_tree_info_t const	*tree,
+	      restyle_info_t const	*restyle)
+{
+	ccss_style_t	*style;
+	char		*signature;
+
+	if (NULL == self->style_cache) {
+		return query (self, node, filter, tree, restyle);
+	}
+
+	g_static_mutex_lock (&self->lock);
+	validate_style_cache (self);
+	g_static_mutex_unlock (&self->lock);
+
+	/* The attribute names only change when loading CSS, no need to lock
+	 * while asking the node. */
+	signature = node_signature (self, node);
+
+	g_static_mutex_lock (&self->lock);
+	style = (ccss_style_t *) g_hash_table_lookup (self->style_cache,
+						      signature);
+	if (style) {
+		ccss_style_reference (style);
+	}
+	g_static_mutex_unlock (&self->lock);
+
+	if (style) {
+		g_free (signature), signature = NULL;
+		return style;
+	}
+
+	/* Query unlocked, another thread may cache an equal style meanwhile,
+	 * which is then replaced. */
+	style = query (self, node, filter, tree, restyle);
+	if (style) {
+		g_static_mutex_lock (&self->lock);
+		if (g_hash_table_size (self->style_cache) >=
+		    self->style_cache_size) {
+			g_hash_table_remove_all (self->style_cache);
+		}
+		/* Hash takes ownership of the signature. */
+		ccss_style_cache_hold (style);
+		g_hash_table_insert (self->style_cache, signature, style);
+		g_static_mutex_unlock (&self->lock);
+	} else {
+		g_free (signature), signature = NULL;
+	}
+
+	return style;
+}
+
+/**
+ * ccss_stylesheet_query:
+ * @self:	a #ccss_stylesheet_t.
+ * @node:	a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
+ *
+ * Query the stylesheet for styling information regarding a document node and apply the results to a #ccss_style_t object.
+ *
+ * See ccss_stylesheet_set_style_cache_size() about sharing styles.
+ *
+ * Queries may run concurrently from multiple threads, once the GLib thread
+ * system has been initialized. Loading or unloading CSS and configuring
+ * the style cache must not overlap with queries though.
+ *
+ * Returns: a #ccss_style_t that the results of the query are applied to or
+ *	    %NULL if the query didn't yield results.
+ **/
+ccss_style_t *
+ccss_stylesheet_query (ccss_stylesheet_t 	*self,
+		       ccss_node_t		*node)
+{
+	return ccss_stylesheet_query_with_ancestor_filter (self, node, NULL);
+}
+
+/**
+ * ccss_stylesheet_query_with_ancestor_filter:
+ * @self:	a #ccss_stylesheet_t.
+ * @node:	a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
+ * @filter:	a #ccss_ancestor_filter_t holding exactly the containers of @node, or %NULL.
+ *
+ * Like ccss_stylesheet_query(), but rules with child or descendant
+ * selectors are rejected through @filter where possible, instead of walking
+ * the containers of @node. When styling a subtree top-down, a single filter
+ * can be kept up to date with ccss_ancestor_filter_push() and
+ * ccss_ancestor_filter_pop(). If @filter is %NULL a filter is built from
+ * @node's containers as needed.
+ *
+ * Returns: a #ccss_style_t that the results of the query are applied to or
+ *	    %NULL if the query didn't yield results.
+ **/
+ccss_style_t *
+ccss_stylesheet_query_with_ancestor_filter (ccss_stylesheet_t		*self,
+					    ccss_node_t			*node,
+					    ccss_ancestor_filter_t	*filter)
+{
+	ccss_style_t *style;
+
+	g_return_val_if_fail (self, NULL);
+	g_return_val_if_fail (node, NULL);
+
+	style = cached_query (self, node, filter, NULL, NULL);
+	ccss_node_clear_facts (node);
+
+	return style;
+}
+
+/*
+ * Query `node' again, rematching only the selectors that may refer to
+ * `pseudo_classes'.
+ */
+static ccss_style_t *
+restyle (ccss_stylesheet_t	 *self,
+	 ccss_style_t const	 *previous,
+	 ccss_node_t		 *node,
+	 char const		**pseudo_classes)
+{
+	restyle_info_t	 info;
+	ccss_style_t	*style;
+	ccss_atom_t	 atom;
+
+	if (NULL == previous ||
+	    previous->stylesheet != self ||
+	    previous->matched_generation != self->generation) {
+		style = cached_query (self, node, NULL, NULL, NULL);
+		ccss_node_clear_facts (node);
+		return style;
+	}
+
+	info.previous = previous;
+	info.changed_mask = 0;
+	for (; pseudo_classes && *pseudo_classes; pseudo_classes++) {
+		/* Names that have never been interned can't be referred to by
+		 * any selector. */
+		atom = g_quark_try_string (*pseudo_classes);
+		if (atom) {
+			info.changed_mask |=
+				ccss_selector_pseudo_class_mask (atom);
+		}
+	}
+
+	style = cached_query (self, node, NULL, NULL, &info);
+	ccss_node_clear_facts (node);
+
+	return style;
+}
+
+/**
+ * ccss_stylesheet_restyle:
+ * @self:		a #ccss_stylesheet_t.
+ * @previous:		the style previously queried for @node, or %NULL.
+ * @node:		a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
+ * @pseudo_classes:	%NULL-terminated names of the pseudo-classes @node or
+ *			its containers gained or lost since @previous has been
+ *			queried.
+ *
+ * Query the style of @node after its state changed, e.g. when the pointer
+ * entered it. Only rules referring to one of @pseudo_classes are matched
+ * again, the others are known to match or not from @previous.
+ *
+ * The result is the same as from ccss_stylesheet_query(), provided that
+ * @previous has been queried for @node and @pseudo_classes lists all changes
+ * since. If @previous is %NULL, stems from another stylesheet, or CSS has
+ * been loaded or unloaded meanwhile, @node is queried from scratch.
+ *
+ * Returns: a #ccss_style_t that the results of the query are applied to or
+ *	    %NULL if the query didn't yield results.
+ **/
+ccss_style_t *
+ccss_stylesheet_restyle (ccss_stylesheet_t	 *self,
+			 ccss_style_t const	 *previous,
+			 ccss_node_t		 *node,
+			 char const		**pseudo_classes)
+{
+	g_return_val_if_fail (self, NULL);
+	g_return_val_if_fail (node, NULL);
+
+	/* The node may have cached its old state. */
+	ccss_node_clear_pseudo_classes (node);
+
+	return restyle (self, previous, node, pseudo_classes);
+}
+
+/**
+ * ccss_stylesheet_query_states:
+ * @self:		a #ccss_stylesheet_t.
+ * @node:		a #ccss_node_t implementation that is used by libccss to retrieve information about the underlying document.
+ * @pseudo_classes:	array of @n_states pseudo-class names, %NULL stands
+ *			for none.
+ * @n_states:		number of states to query.
+ * @styles:		array of @n_states to store the styles in.
+ *
+ * Query the styles of @node in several states, e.g. to fill per-state
+ * theme colors. For each state @node is queried as if the respective entry
+ * of @pseudo_classes was its only pseudo-class. Rules that refer to none of
+ * @pseudo_classes are matched only once for all states.
+ *
+ * The results are the same as from ccss_stylesheet_query(), entries of
+ * @styles are %NULL where the query didn't yield results.
+ *
+ * Returns: %TRUE if any of the states yielded results.
+ **/
+bool
+ccss_stylesheet_query_states (ccss_stylesheet_t		 *self,
+			      ccss_node_t		 *node,
+			      char const		**pseudo_classes,
+			      unsigned int		  n_states,
+			      ccss_style_t		**styles)
+{
+	ccss_style_t const	*previous;
+	char const		*state[2];
+	char const		*changed[3];
+	unsigned int		 n_changed;
+	bool			 ret;
+
+	g_return_val_if_fail (self && node && styles, false);
+	g_return_val_if_fail (pseudo_classes || 0 == n_states, false);
+
+	ret = false;
+	previous = NULL;
+	for (unsigned int i = 0; i < n_states; i++) {
+
+		state[0] = pseudo_classes[i];
+		state[1] = NULL;
+		ccss_node_set_pseudo_classes (node, state);
+
+		/* Going from the previous state to this one. */
+		n_changed = 0;
+		if (i > 0 && pseudo_classes[i - 1]) {
+			changed[n_changed++] = pseudo_classes[i - 1];
+		}
+		if (pseudo_classes[i]) {
+			changed[n_changed++] = pseudo_classes[i];
+		}
+		changed[n_changed] = NULL;
+
+		styles[i] = restyle (self, previous, node, changed);
+		ret |= (bool) styles[i];
+
+		/* A state without results starts over. */
+		previous = styles[i];
+	}
+
+	ccss_node_clear_pseudo_classes (node);
+
+	return ret;
+}
+
+/**
+ * ccss_stylesheet_get_pseudo_classes:
+ * @self:	a #ccss_stylesheet_t.
+ * @type_name:	name of a node type.
+ *
+ * Find the pseudo-classes that rules for @type_name or universal rules refer
+ * to, including pseudo-classes of containers. A node of type @type_name
+ * doesn't need to be restyled when any other pseudo-class changes. Rules for
+ * base types are not considered, ask for each of them.
+ *
+ * Returns: a newly allocated, %NULL-terminated array of pseudo-class names,
+ *	    in no particular order, or %NULL if there are none. Free the array
+ *	    with g_free(), the names are owned by libccss.
+ **/
+char const **
+ccss_stylesheet_get_pseudo_classes (ccss_stylesheet_t const	*self,
+				    char const			*type_name)
+{
+	ccss_selector_group_t const	 *group;
+	GHashTable			 *atoms;
+	GHashTableIter			  iter;
+	gpointer			  atom;
+	char const			**pseudo_classes;
+	unsigned int			  i;
+
+	g_return_val_if_fail (self && type_name, NULL);
+
+	atoms = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	group = g_hash_table_lookup (self->groups, "*");
+	if (group) {
+		ccss_selector_group_collect_pseudo_classes (group, atoms);
+	}
+
+	group = g_hash_table_lookup (self->groups, type_name);
+	if (group) {
+		ccss_selector_group_collect_pseudo_classes (group, atoms);
+	}
+
+	pseudo_classes = NULL;
+	if (g_hash_table_size (atoms)) {
+		pseudo_classes = g_new (char const *,
+					g_hash_table_size (atoms) + 1);
+		i = 0;
+		g_hash_table_iter_init (&iter, atoms);
+		while (g_hash_table_iter_next (&iter, &atom, NULL)) {
+			pseudo_classes[i++] = g_quark_to_string (
+						GPOINTER_TO_UINT (atom));
+		}
+		pseudo_classes[i] = NULL;
+	}
+
+	g_hash_table_destroy (atoms);
+
+	return pseudo_classes;
+}
+
+/*
+ * Recursively style `node' and its children, see
+ * ccss_stylesheet_query_tree().
+ */
+static void
+query_tree_r (ccss_stylesheet_t		*self,
+	      ccss_node_t		*node,
+	      query_tree_info_t		*info)
+{
+	ccss_style_t	*style;
+	ccss_node_t	*child;
+
+	style = cached_query (self, node, info->filter, info, NULL);
+
+	/* Hold on to the style for the children to inherit from, the
+	 * callback takes ownership of the returned reference. */
+	g_ptr_array_add (info->ancestor_styles,
+			 style ? ccss_style_reference (style) : NULL);
+	info->func (self, node, style, info->user_data);
+
+	ccss_ancestor_filter_push (info->filter, node);
+	for (unsigned int i = 0;
+	     NULL != (child = info->get_child (node, i, info->user_data));
+	     i++) {
+		query_tree_r (self, child, info);
+		ccss_node_release (child), child = NULL;
+	}
+	ccss_ancestor_filter_pop (info->filter);
+	ccss_node_clear_facts (node);
+
+	style = (ccss_style_t *) g_ptr_array_index (info->ancestor_styles,
+					info->ancestor_styles->len - 1);
+	g_ptr_array_set_size (info->ancestor_styles,
+			      info->ancestor_styles->len - 1);
+	if (style) {
+		ccss_style_destroy (style), style = NULL;
+	}
+}
+
+/**
+ * ccss_stylesheet_query_tree:
+ * @self:	a #ccss_stylesheet_t.
+ * @root:	a #ccss_node_t, the root of the subtree to style.
+ * @get_child:	a #ccss_stylesheet_child_f to enumerate the children of a node.
+ * @func:	a #ccss_stylesheet_style_f that receives the nodes' styles.
+ * @user_data:	user data to pass to @get_child and @func.
+ *
+ * Style @root and all its descendants in a single top-down pass. Nodes are
+ * passed to @func in document order, before their children. Inherited
+ * properties are resolved from the styles already computed for the
+ * containers rather than querying them again, and the containers' types,
+ * IDs and classes are shared through one #ccss_ancestor_filter_t.
+ *
+ * The results are the same as querying each node with
+ * ccss_stylesheet_query(). The call makes up a styling pass, see
+ * ccss_stylesheet_begin_styling_pass().
+ **/
+void
+ccss_stylesheet_query_tree (ccss_stylesheet_t		*self,
+			    ccss_node_t			*root,
+			    ccss_stylesheet_child_f	 get_child,
+			    ccss_stylesheet_style_f	 func,
+			    void			*user_data)
+{
+	query_tree_info_t info;
+
+	g_return_if_fail (self && root && get_child && func);
+
+	info.root = root;
+	info.filter = ccss_ancestor_filter_create_for_node (root);
+	info.ancestor_styles = g_ptr_array_new ();
+	info.get_child = get_child;
+	info.func = func;
+	info.user_data = user_data;
+
+	ccss_stylesheet_begin_styling_pass (self);
+	query_tree_r (self, root, &info);
+	ccss_stylesheet_end_styling_pass (self);
+
+	g_assert (0 == info.ancestor_styles->len);
+	g_ptr_array_free (info.ancestor_styles, true);
+	ccss_ancestor_filter_destroy (info.filter);
+}
+
 /**
  * ccss_stylesheet_foreach:
  * @self:	a #ccss_stylesheet_t.
@@ -23,6 +23,7 @@
 #define CCSS_STYLESHEET_H
 
 #include <stdbool.h>
+#include <ccss/ccss-ancestor-filter.h>
 #include <ccss/ccss-node.h>
 #include <ccss/ccss-macros.h>
 #include <ccss/ccss-style.h>
@@ -83,6 +84,78 @@ ccss_style_t *
 ccss_stylesheet_query		(ccss_stylesheet_t 		*self,
 				 ccss_node_t			*node);
 
+ccss_style_t *
+ccss_stylesheet_query_with_ancestor_filter
+				(ccss_stylesheet_t		*self,
+				 ccss_node_t			*node,
+				 ccss_ancestor_filter_t		*filter);
+
+ccss_style_t *
+ccss_stylesheet_restyle		(ccss_stylesheet_t		 *self,
+				 ccss_style_t const		 *previous,
+				 ccss_node_t			 *node,
+				 char const			**pseudo_classes);
+
+bool
+ccss_stylesheet_query_states	(ccss_stylesheet_t		 *self,
+				 ccss_node_t			 *node,
+				 char const			**pseudo_classes,
+				 unsigned int			  n_states,
+				 ccss_style_t			**styles);
+
+char const **
+ccss_stylesheet_get_pseudo_classes
+				(ccss_stylesheet_t const	*self,
+				 char const			*type_name);
+
+/**
+ * ccss_stylesheet_child_f:
+ * @container:	a #ccss_node_t.
+ * @n:		index of the child to return.
+ * @user_data:	user data passed to ccss_stylesheet_query_tree().
+ *
+ * Specifies the type of the function passed to ccss_stylesheet_query_tree()
+ * to enumerate the children of a node. The returned node is released with
+ * the #ccss_node_release_f hook after its subtree has been styled.
+ *
+ * Returns: the @n-th child of @container or %NULL if there are no more.
+ **/
+typedef ccss_node_t * (*ccss_stylesheet_child_f) (ccss_node_t	*container,
+						  unsigned int	 n,
+						  void		*user_data);
+
+/**
+ * ccss_stylesheet_style_f:
+ * @self:	a #ccss_stylesheet_t.
+ * @node:	the #ccss_node_t that has been styled.
+ * @style:	@node's #ccss_style_t, or %NULL if the query didn't yield results.
+ * @user_data:	user data passed to ccss_stylesheet_query_tree().
+ *
+ * Specifies the type of the function passed to ccss_stylesheet_query_tree()
+ * to receive the nodes' styles. The function takes ownership of @style.
+ **/
+typedef void (*ccss_stylesheet_style_f) (ccss_stylesheet_t	*self,
+					 ccss_node_t		*node,
+					 ccss_style_t		*style,
+					 void			*user_data);
+
+void
+ccss_stylesheet_query_tree	(ccss_stylesheet_t		*self,
+				 ccss_node_t			*root,
+				 ccss_stylesheet_child_f	 get_child,
+				 ccss_stylesheet_style_f	 func,
+				 void				*user_data);
+
+void
+ccss_stylesheet_begin_styling_pass	(ccss_stylesheet_t	*self);
+
+void
+ccss_stylesheet_end_styling_pass	(ccss_stylesheet_t	*self);
+
+void
+ccss_stylesheet_set_style_cache_size (ccss_stylesheet_t		*self,
+				      unsigned int		 n_styles);
+
 /**
  * ccss_stylesheet_iterator_f:
  * @self:	a #ccss_stylesheet_t.
@@ -28,6 +28,7 @@
   #define CCSS_DEPRECATED(sym) sym
 #endif
 
+#include <ccss/ccss-ancestor-filter.h>
 #include <ccss/ccss-background.h>
 #include <ccss/ccss-block.h>
 #include <ccss/ccss-border.h>